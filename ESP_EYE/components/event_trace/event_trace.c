@@ -0,0 +1,190 @@
+/**
+ * @file event_trace.c
+ * @author xholanp00
+ * @brief Per-core ring buffers of begin/end events for Chrome/Perfetto traces
+ *
+ * Writers claim a slot with an atomic increment of their core's head, fill it
+ * and publish it by storing the slot sequence number last. A task migrating
+ * between cores mid-record still gets a slot of its own, so no lock is taken.
+ * Readers copy a slot and keep it only if its sequence number is the expected
+ * one before and after the copy.
+ *
+ * Each event also stores how long recording it took, so the tracer's own
+ * cost can be read back from a running node instead of estimated.
+ */
+
+#include "event_trace.h"
+
+#include <string.h>
+
+#if CONFIG_EVENT_TRACE_ENABLE
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#endif
+
+static const char *TAG = "event_trace"; // Tag for logging
+
+#define RING_EVENTS CONFIG_EVENT_TRACE_RING_EVENTS
+#define RING_MASK (RING_EVENTS - 1)
+#define TRACE_CORES 2
+
+_Static_assert((RING_EVENTS & RING_MASK) == 0, "EVENT_TRACE_RING_EVENTS must be a power of two");
+
+typedef struct {
+    uint32_t head;                    // next sequence number to hand out
+    event_trace_event_t *events;
+} trace_ring_t;
+
+static trace_ring_t s_rings[TRACE_CORES];
+
+/* CPU cycle counter on the chip, nanoseconds in the host build */
+static inline uint32_t trace_ticks(void){
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#else
+    return esp_cpu_get_cycle_count();
+#endif
+}
+
+static uint32_t ticks_per_us(void){
+#if CONFIG_IDF_TARGET_LINUX
+    return 1000;
+#else
+    uint32_t t = esp_rom_get_cpu_ticks_per_us();
+    return t ? t : 1;
+#endif
+}
+
+/**
+ * @brief Allocate the rings
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t event_trace_init(void){
+#if CONFIG_EVENT_TRACE_RING_IN_PSRAM
+    const uint32_t caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+#else
+    const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+#endif
+    for (int core = 0; core < TRACE_CORES; core++) {
+        if (s_rings[core].events) continue;
+        event_trace_event_t *events = heap_caps_calloc(RING_EVENTS, sizeof(event_trace_event_t), caps);
+        if (!events) {
+            ESP_LOGE(TAG, "Failed to allocate trace ring for core %d", core);
+            return ESP_ERR_NO_MEM;
+        }
+        __atomic_store_n(&s_rings[core].events, events, __ATOMIC_RELEASE);
+    }
+    ESP_LOGI(TAG, "Tracing %d events per core", RING_EVENTS);
+    return ESP_OK;
+}
+
+void event_trace_record(const char *name, char phase){
+    uint32_t start = trace_ticks();
+    trace_ring_t *r = &s_rings[xPortGetCoreID() % TRACE_CORES];
+    event_trace_event_t *events = __atomic_load_n(&r->events, __ATOMIC_ACQUIRE);
+    if (!events) return;
+
+    uint32_t seq = __atomic_fetch_add(&r->head, 1, __ATOMIC_RELAXED);
+    event_trace_event_t *e = &events[seq & RING_MASK];
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->ts_us = esp_timer_get_time();
+    e->name = name;
+    e->phase = phase;
+    strlcpy(e->task, pcTaskGetName(NULL), sizeof(e->task));
+    uint32_t cost = trace_ticks() - start;
+    e->cost = cost > UINT16_MAX ? UINT16_MAX : cost;
+    __atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Copy completed events of one core
+ *
+ * @param core Core number
+ * @param cursor In: first sequence number wanted (0 = oldest kept); out: where to continue
+ * @param out Destination
+ * @param max Capacity of `out`
+ * @return size_t Number of events copied (0 when caught up)
+ */
+size_t event_trace_read(int core, uint32_t *cursor, event_trace_event_t *out, size_t max){
+    if (core < 0 || core >= TRACE_CORES || !cursor || !out) return 0;
+    trace_ring_t *r = &s_rings[core];
+    event_trace_event_t *events = __atomic_load_n(&r->events, __ATOMIC_ACQUIRE);
+    if (!events) return 0;
+
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint32_t oldest = head > RING_EVENTS ? head - RING_EVENTS : 0;
+    uint32_t seq = *cursor < oldest ? oldest : *cursor;
+    size_t n = 0;
+    for (; seq < head && n < max; seq++) {
+        const event_trace_event_t *e = &events[seq & RING_MASK];
+        if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != seq + 1) continue;   // in progress or overwritten
+        out[n] = *e;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq + 1) continue;
+        out[n].task[sizeof(out[n].task) - 1] = '\0';
+        n++;
+    }
+    *cursor = seq;
+    return n;
+}
+
+void event_trace_get_stats(event_trace_stats_t *out){
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    out->enabled = s_rings[0].events != NULL;
+    out->ring_events = RING_EVENTS;
+    /* Average over what the ring still holds; ticks are converted at the
+       current CPU clock, which is the one the events ran at unless DFS moved it */
+    uint32_t tpu = ticks_per_us();
+    event_trace_event_t batch[16];
+    for (int core = 0; core < TRACE_CORES; core++) {
+        out->recorded[core] = __atomic_load_n(&s_rings[core].head, __ATOMIC_RELAXED);
+        uint64_t total = 0;
+        uint32_t count = 0, max = 0, cursor = 0;
+        size_t n;
+        while ((n = event_trace_read(core, &cursor, batch, sizeof(batch) / sizeof(batch[0]))) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                total += batch[i].cost;
+                if (batch[i].cost > max) max = batch[i].cost;
+            }
+            count += n;
+        }
+        out->cost_ns_avg[core] = count ? (uint32_t)(total * 1000 / count / tpu) : 0;
+        out->cost_ns_max[core] = max * 1000 / tpu;
+    }
+}
+
+#else
+
+esp_err_t event_trace_init(void){
+    return ESP_OK;
+}
+
+void event_trace_record(const char *name, char phase){
+    (void)name;
+    (void)phase;
+}
+
+size_t event_trace_read(int core, uint32_t *cursor, event_trace_event_t *out, size_t max){
+    (void)core; (void)cursor; (void)out; (void)max;
+    return 0;
+}
+
+void event_trace_get_stats(event_trace_stats_t *out){
+    if (out) memset(out, 0, sizeof(*out));
+}
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+/* Phase letters match the Chrome trace event format */
+#define EVENT_TRACE_BEGIN 'B'
+#define EVENT_TRACE_END 'E'
+#define EVENT_TRACE_INSTANT 'i'
+
+/* Task names are truncated to this many characters (incl. terminator) */
+#define EVENT_TRACE_TASK_NAME_MAX 12
+
+typedef struct {
+    int64_t ts_us;                          // esp_timer time
+    const char *name;                       // string literal naming the span
+    uint32_t seq;                           // ring index + 1 once complete, 0 while written
+    char phase;
+    uint16_t cost;                          // CPU ticks spent recording this event (saturates)
+    char task[EVENT_TRACE_TASK_NAME_MAX];   // recording task
+} event_trace_event_t;
+
+typedef struct {
+    bool enabled;
+    uint32_t ring_events;     // per core
+    uint32_t recorded[2];     // events ever recorded per core
+    uint32_t cost_ns_avg[2];  // time spent in event_trace_record, over the events still in the ring
+    uint32_t cost_ns_max[2];
+} event_trace_stats_t;
+
+#if CONFIG_EVENT_TRACE_ENABLE
+
+/* `name` must be a string literal (only the pointer is stored) */
+#define TRACE_BEGIN(name) event_trace_record((name), EVENT_TRACE_BEGIN)
+#define TRACE_END(name) event_trace_record((name), EVENT_TRACE_END)
+#define TRACE_INSTANT(name) event_trace_record((name), EVENT_TRACE_INSTANT)
+
+#else
+
+#define TRACE_BEGIN(name) do { } while (0)
+#define TRACE_END(name) do { } while (0)
+#define TRACE_INSTANT(name) do { } while (0)
+
+#endif
+
+// Allocate the per-core rings. Does nothing when tracing is compiled out.
+esp_err_t event_trace_init(void);
+
+// Append one event to the calling core's ring. Safe from any task; not from ISRs.
+void event_trace_record(const char *name, char phase);
+
+// Copy completed events of `core` starting at *cursor (0 = oldest kept). Advances *cursor.
+size_t event_trace_read(int core, uint32_t *cursor, event_trace_event_t *out, size_t max);
+
+// Snapshot of tracer state
+void event_trace_get_stats(event_trace_stats_t *out);
@@ -18,25 +18,34 @@
 #include "freertos/task.h"
 #include "recorder.h"
 #include "esp_camera.h"
+#include "photo_cache.h"
+#include "photo_scaler.h"
+#include "task_plan.h"
+#include "event_trace.h"
+#include "mem_tags.h"
+#include "log_ring.h"
+#include "settings.h"
+#include "mjpeg_tcp_server.h"
+#include "resp_writer.h"
+#include "power_ctl.h"
+#include "node_profile.h"
 
 #define FILE_PATH_MAX 1024
-#define SCRATCH_BUFSIZE 16384   // 16KB chunk for faster downloads; PSRAM available
 
 struct file_server_data {
     char static_base[128];
     char media_base[128];
-    char scratch[SCRATCH_BUFSIZE];
+    char *scratch;          // download chunk buffer (MEM_TAG_HTTP_SCRATCH)
+    size_t scratch_len;
 };
 
 /* Time offset (ms) to translate external epoch time to device relative time.
    current_time_ms() = esp_timer_get_time()/1000 + g_time_offset_ms */
 static int64_t g_time_offset_ms = 0;
 
-/* Accept capture commands only if requested capture time is within this window
-    (milliseconds) of the device's synced time. Prevents accepting stale/late
-    triggers from remote PIR device. */
-#ifndef CAPTURE_ACCEPT_WINDOW_MS
-#define CAPTURE_ACCEPT_WINDOW_MS 5000
+/* HTTP port; the host build moves it off the privileged range */
+#ifndef FILE_SERVER_PORT
+#define FILE_SERVER_PORT 80
 #endif
 
 static const char *TAG = "file_server";
@@ -74,14 +83,14 @@ static esp_err_t time_post_handler(httpd_req_t *req)
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing body");
         return ESP_FAIL;
     }
-    char *buf = malloc(content_len + 1);
+    char *buf = mem_tags_alloc(MEM_TAG_HTTP_BODY, content_len + 1);
     if (!buf) {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OOM");
         return ESP_FAIL;
     }
     int r = httpd_req_recv(req, buf, content_len);
     if (r <= 0) {
-        free(buf);
+        mem_tags_free(buf);
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad body");
         return ESP_FAIL;
     }
@@ -92,7 +101,7 @@ static esp_err_t time_post_handler(httpd_req_t *req)
         char *digit = buf;
         while (*digit && !isdigit((unsigned char)*digit)) digit++;
         if (!*digit) {
-            free(buf);
+            mem_tags_free(buf);
             httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing time field");
             return ESP_FAIL;
         }
@@ -101,7 +110,7 @@ static esp_err_t time_post_handler(httpd_req_t *req)
         char *p = strstr(buf, "time:");
         if (!p) p = strstr(buf, "timestamp:");
         if (!p) {
-            free(buf);
+            mem_tags_free(buf);
             httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing time field");
             return ESP_FAIL;
         }
@@ -121,7 +130,7 @@ static esp_err_t time_post_handler(httpd_req_t *req)
     } else {
         ESP_LOGW(TAG, "settimeofday failed");
     }
-    free(buf);
+    mem_tags_free(buf);
     httpd_resp_set_type(req, "application/json");
     char resp[128];
     snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"offset_ms\":%lld}", (long long)g_time_offset_ms);
@@ -173,13 +182,17 @@ static void list_files_in_directory(const char *path)
     ESP_LOGI(TAG, "=== Total: %d items ===", file_count);
 }
 
+#if NODE_HAS_STUBS && NODE_HAS_WEB_UI
 static esp_err_t favicon_get_handler(httpd_req_t *req)
 {
     httpd_resp_set_status(req, "204 No Content");
     httpd_resp_send(req, NULL, 0);
     return ESP_OK;
 }
+#endif
 
+/* Capture, gallery and histogram handlers; compiled out of stream-only builds */
+#if NODE_HAS_CAPTURE
 static esp_err_t picture_post_handler(httpd_req_t *req)
 {
     struct file_server_data *server_data = (struct file_server_data *)req->user_ctx;
@@ -206,7 +219,7 @@ static esp_err_t picture_post_handler(httpd_req_t *req)
         return ESP_OK;
     }
 
-    char *body = malloc(content_len + 1);
+    char *body = mem_tags_alloc(MEM_TAG_HTTP_BODY, content_len + 1);
     if (!body) {
         ESP_LOGE(TAG, "OOM reading request body");
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OOM");
@@ -214,7 +227,7 @@ static esp_err_t picture_post_handler(httpd_req_t *req)
     }
     int r = httpd_req_recv(req, body, content_len);
     if (r <= 0) {
-        free(body);
+        mem_tags_free(body);
         ESP_LOGE(TAG, "Failed to read request body");
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad request body");
         return ESP_FAIL;
@@ -226,7 +239,7 @@ static esp_err_t picture_post_handler(httpd_req_t *req)
 
     char *p = strstr(body, "capture:");
     if (!p) {
-        free(body);
+        mem_tags_free(body);
         httpd_resp_set_status(req, "400 Bad Request");
         httpd_resp_set_type(req, "application/json");
         httpd_resp_send(req, "{\"status\":\"rejected\",\"reason\":\"missing_capture_time\"}", HTTPD_RESP_USE_STRLEN);
@@ -236,13 +249,28 @@ static esp_err_t picture_post_handler(httpd_req_t *req)
     p += strlen("capture:");
     unsigned long long capture_time = strtoull(p, NULL, 10);
 
+    /* Optional `source:<name>` names the trigger (e.g. pir, ui) for the photo metadata */
+    char trigger[RECORDER_TRIGGER_MAX] = "remote";
+    char *src = strstr(body, "source:");
+    if (src) {
+        src += strlen("source:");
+        size_t n = 0;
+        while (n < sizeof(trigger) - 1 && (isalnum((unsigned char)src[n]) || src[n] == '_' || src[n] == '-')) {
+            trigger[n] = src[n];
+            n++;
+        }
+        trigger[n] = '\0';
+        if (n == 0) strlcpy(trigger, "remote", sizeof(trigger));
+    }
+
     uint64_t now_ms_rel = (uint64_t)(esp_timer_get_time() / 1000);
     uint64_t ts_now = now_ms_rel + (uint64_t)g_time_offset_ms;
     int64_t diff = (int64_t)capture_time - (int64_t)ts_now;
-    if (llabs(diff) > (int64_t)CAPTURE_ACCEPT_WINDOW_MS) {
-        ESP_LOGW(TAG, "Rejected capture; requested %llu now %llu diff %lld ms > window %d ms",
-                 (unsigned long long)capture_time, (unsigned long long)ts_now, (long long)diff, CAPTURE_ACCEPT_WINDOW_MS);
-        free(body);
+    int32_t window_ms = settings_get(SETTING_CAPTURE_WINDOW_MS);
+    if (llabs(diff) > (int64_t)window_ms) {
+        ESP_LOGW(TAG, "Rejected capture; requested %llu now %llu diff %lld ms > window %ld ms",
+                 (unsigned long long)capture_time, (unsigned long long)ts_now, (long long)diff, (long)window_ms);
+        mem_tags_free(body);
         httpd_resp_set_status(req, "403 Forbidden");
         httpd_resp_set_type(req, "application/json");
         char resp[128];
@@ -253,10 +281,10 @@ static esp_err_t picture_post_handler(httpd_req_t *req)
 
     /* Within window — enqueue an async capture where filename uses the
        requested capture_time to make it deterministic for the caller.
-       Use local calendar date/time (YYYY-MM-DD_HH:MM:SS) as requested. */
+       The name is in UTC, as capture_timeline_parse_name() reads it back. */
     time_t sec = (time_t)(capture_time / 1000ULL);
     struct tm tm;
-    localtime_r(&sec, &tm);
+    gmtime_r(&sec, &tm);
     /* filename: YYYY-MM-DDxHH_MM_SS.jpg (x and _ used to avoid ':' on FAT) */
     snprintf(filepath, sizeof(filepath), "%s/%04d-%02d-%02dx%02d_%02d_%02d.jpg",
              pictures_dir,
@@ -267,18 +295,19 @@ static esp_err_t picture_post_handler(httpd_req_t *req)
              tm.tm_min,
              tm.tm_sec);
 
-    free(body);
-    char *task_filepath = strdup(filepath);
-    if (!task_filepath) {
-        ESP_LOGE(TAG, "Failed to allocate memory for filepath task");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server OOM");
-        return ESP_FAIL;
+    mem_tags_free(body);
+    ESP_LOGI(TAG, "Accepted capture within window, enqueuing: %s (%s)", filepath, trigger);
+    esp_err_t qerr = recorder_enqueue_capture(filepath, capture_time, trigger);
+    if (qerr == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "Capture queue full, rejecting %s", filepath);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_send(req, "{\"status\":\"rejected\",\"reason\":\"busy\"}", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
     }
-    ESP_LOGI(TAG, "Accepted capture within window, enqueuing: %s", task_filepath);
-    extern esp_err_t recorder_enqueue_capture(char *filepath);
-    if (recorder_enqueue_capture(task_filepath) != ESP_OK) {
-        free(task_filepath);
-        ESP_LOGE(TAG, "Failed to enqueue capture");
+    if (qerr != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enqueue capture: %s", esp_err_to_name(qerr));
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start capture");
         return ESP_FAIL;
     }
@@ -289,68 +318,182 @@ static esp_err_t picture_post_handler(httpd_req_t *req)
     size_t name_len = strlen(nameptr);
     /* allocate exact buffer to avoid compile-time truncation warnings */
     size_t buf_len = 32 + name_len + 8;
-    char *okresp = malloc(buf_len);
+    char *okresp = mem_tags_alloc(MEM_TAG_HTTP_BODY, buf_len);
     if (!okresp) {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OOM");
         return ESP_FAIL;
     }
     snprintf(okresp, buf_len, "{\"status\":\"accepted\",\"path\":\"/photos/%s\"}", nameptr);
     httpd_resp_send(req, okresp, strlen(okresp));
-    free(okresp);
+    mem_tags_free(okresp);
     return ESP_OK;
 }
 
 
+/* Largest page served by /photos?limit= */
+#define PHOTOS_PAGE_MAX 200
+
+/* Regular file check. Entries being skipped pass st = NULL and are judged by
+   d_type when readdir reports one, so paging deep into a large directory does
+   not stat every file before the page. */
+static bool is_regular_entry(const char *dirpath, const struct dirent *entry, struct stat *st)
+{
+    if (!st && entry->d_type != DT_UNKNOWN) {
+        return entry->d_type == DT_REG;
+    }
+    struct stat tmp;
+    if (!st) {
+        st = &tmp;
+    }
+    char filepath[FILE_PATH_MAX * 2];
+    snprintf(filepath, sizeof(filepath), "%s/%s", dirpath, entry->d_name);
+    // FATFS doesn't reliably set d_type; use stat to decide
+    return stat(filepath, st) == 0 && S_ISREG(st->st_mode);
+}
+
+/* True if the capture time in a photo file name falls in [from, to) */
+static bool name_in_range(const char *name, int64_t from, int64_t to)
+{
+    int64_t t;
+    return capture_timeline_parse_name(name, &t) && t >= from && t < to;
+}
+
+/* GET /photos[?offset=N&limit=M] - files of a media directory in directory order,
+   as JSON or, for Accept: application/cbor, as CBOR.
+   With a limit only that page is sent, and "next" is the offset that continues
+   after it (null at the end), so a client can page through thousands of photos.
+   since=N&after=NAME is a sync cursor: the client had N files ending with NAME.
+   If entry N-1 is no longer NAME (files were deleted or the card swapped) the
+   listing restarts from 0 with "reset":true.
+   from=S&to=S (epoch seconds) keeps only photos whose file name time is in
+   [from, to); offsets and cursors then count within that range. */
 static esp_err_t list_directory_handler(httpd_req_t *req, const char *subdir)
 {
     struct file_server_data *server_data = (struct file_server_data *)req->user_ctx;
     char dirpath[FILE_PATH_MAX];
     snprintf(dirpath, sizeof(dirpath), "%s/%s", server_data->media_base, subdir);
 
+    long offset = 0;
+    long limit = -1;
+    bool cursor = false;
+    bool ranged = false;
+    int64_t from = 0;
+    int64_t to = INT64_MAX;
+    char after[PHOTO_CACHE_ID_MAX] = "";
+    char query[192];
+    char param[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "offset", param, sizeof(param)) == ESP_OK) {
+            offset = strtol(param, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "since", param, sizeof(param)) == ESP_OK) {
+            offset = strtol(param, NULL, 10);
+            cursor = true;
+            httpd_query_key_value(query, "after", after, sizeof(after));
+        }
+        if (httpd_query_key_value(query, "limit", param, sizeof(param)) == ESP_OK) {
+            limit = strtol(param, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "from", param, sizeof(param)) == ESP_OK) {
+            from = strtoll(param, NULL, 10);
+            ranged = true;
+        }
+        if (httpd_query_key_value(query, "to", param, sizeof(param)) == ESP_OK) {
+            to = strtoll(param, NULL, 10);
+            ranged = true;
+        }
+        if (offset < 0 || limit == 0 || limit > PHOTOS_PAGE_MAX) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "offset must be >= 0 and limit 1..200");
+            return ESP_OK;
+        }
+    }
+
+    bool paged = limit > 0 || cursor;
+    resp_writer_t w;
+    resp_writer_begin(&w, req, resp_writer_negotiate(req));
+    resp_writer_map(&w);
+    resp_writer_key(&w, "files");
+    resp_writer_array(&w);
 
     DIR *dir = opendir(dirpath);
     if (!dir) {
         ESP_LOGW(TAG, "Directory not found: %s", dirpath);
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, "{\"files\":[]}", strlen("{\"files\":[]}"));
+        resp_writer_end(&w);
+        if (paged) {
+            resp_writer_key(&w, "next");
+            resp_writer_null(&w);
+            resp_writer_kv_bool(&w, "reset", false);
+        }
+        resp_writer_end(&w);
+        resp_writer_finish(&w);
         return ESP_OK;
     }
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr_chunk(req, "{\"files\":[");
-
     struct dirent *entry;
-    int first = 1;
-    int sent = 0;
-    while ((entry = readdir(dir)) != NULL) {
-        struct stat file_stat;
-        char filepath[FILE_PATH_MAX * 2];
-        snprintf(filepath, sizeof(filepath), "%s/%s", dirpath, entry->d_name);
-
-        // FATFS doesn't reliably set d_type; use stat to decide
-        if (stat(filepath, &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
-            if (!first) {
-                httpd_resp_sendstr_chunk(req, ",");
+    struct stat file_stat;
+    long index = 0;
+    bool reset = false;
+    if (cursor && offset > 0) {
+        /* Walk to the client's last entry and check it is still the same file */
+        bool found = false;
+        while ((entry = readdir(dir)) != NULL) {
+            if ((ranged && !name_in_range(entry->d_name, from, to)) || !is_regular_entry(dirpath, entry, NULL)) {
+                continue;
             }
-            char file_json[512];
-            snprintf(file_json, sizeof(file_json),
-                     "{\"name\":\"%s\",\"size\":%ld}",
-                     entry->d_name, file_stat.st_size);
-            httpd_resp_sendstr_chunk(req, file_json);
-            first = 0;
-            sent++;
-            if (sent <= 4) {
-                ESP_LOGI(TAG, "%s file: %s (%ld bytes)", subdir, entry->d_name, file_stat.st_size);
+            if (++index == offset) {
+                found = after[0] == '\0' || strcmp(entry->d_name, after) == 0;
+                break;
             }
         }
+        if (!found) {
+            rewinddir(dir);
+            index = 0;
+            offset = 0;
+            reset = true;
+        }
+    }
+
+    int sent = 0;
+    bool more = false;
+    while ((entry = readdir(dir)) != NULL) {
+        bool skipping = index < offset || (limit > 0 && sent >= limit);
+        if (ranged && !name_in_range(entry->d_name, from, to)) {
+            continue;
+        }
+        if (!is_regular_entry(dirpath, entry, skipping ? NULL : &file_stat)) {
+            continue;
+        }
+        if (index++ < offset) {
+            continue;
+        }
+        if (limit > 0 && sent >= limit) {
+            more = true;
+            break;
+        }
+        resp_writer_map(&w);
+        resp_writer_kv_str(&w, "name", entry->d_name);
+        resp_writer_kv_uint(&w, "size", file_stat.st_size);
+        resp_writer_end(&w);
+        sent++;
+        if (sent <= 4) {
+            ESP_LOGI(TAG, "%s file: %s (%ld bytes)", subdir, entry->d_name, file_stat.st_size);
+        }
     }
     closedir(dir);
-    
-    httpd_resp_sendstr_chunk(req, "]}");
-    ESP_LOGI(TAG, "%s response count=%d", subdir, sent);
 
-    /* Terminate chunked response */
-    httpd_resp_sendstr_chunk(req, NULL);
+    resp_writer_end(&w);
+    if (paged) {
+        resp_writer_key(&w, "next");
+        if (more) {
+            resp_writer_int(&w, offset + sent);
+        } else {
+            resp_writer_null(&w);
+        }
+        resp_writer_kv_bool(&w, "reset", reset);
+    }
+    resp_writer_end(&w);
+    ESP_LOGI(TAG, "%s response count=%d offset=%ld", subdir, sent, offset);
+    resp_writer_finish(&w);
     return ESP_OK;
 }
 
@@ -367,9 +510,87 @@ static esp_err_t photo_get_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
+    /* The wildcard match leaves the query string in the URI; cut it off */
+    char id_buf[PHOTO_CACHE_ID_MAX];
+    size_t id_len = strcspn(id, "?");
+    if (id_len == 0 || id_len >= sizeof(id_buf)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad photo id");
+        return ESP_FAIL;
+    }
+    memcpy(id_buf, id, id_len);
+    id_buf[id_len] = '\0';
+    id = id_buf;
+    if (strchr(id, '/')) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad photo id");
+        return ESP_FAIL;
+    }
+
+    /* A trigger answered with this name may have been dropped as a duplicate;
+       send the client to the photo it duplicates, keeping ?scale= */
+    char kept[PHOTO_CACHE_ID_MAX];
+    if (recorder_duplicate_of(id, kept, sizeof(kept))) {
+        char location[FILE_PATH_MAX];
+        snprintf(location, sizeof(location), "/photo/%s%s", kept, uri + strlen(prefix) + id_len);
+        httpd_resp_set_status(req, "303 See Other");
+        httpd_resp_set_hdr(req, "Location", location);
+        httpd_resp_set_hdr(req, "X-Duplicate-Of", kept);
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+
     char filepath[FILE_PATH_MAX];
     snprintf(filepath, sizeof(filepath), "%s/pictures/%s", server_data->media_base, id);
 
+    /* Optional ?scale=2|4|8 selects a downscaled variant. Builds without the
+       scaler ignore it and send the original; the browser scales it. */
+#if NODE_HAS_SCALER
+    int scale = 1;
+    char query[32];
+    char param[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "scale", param, sizeof(param)) == ESP_OK) {
+        scale = atoi(param);
+        if (scale != 1 && !photo_scaler_scale_supported(scale)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "scale must be 1, 2, 4 or 8");
+            return ESP_FAIL;
+        }
+    }
+
+    if (scale > 1 && photo_scaler_serve_cached(req, id, scale) != ESP_ERR_NOT_FOUND) {
+        return ESP_OK;
+    }
+    /* Scaling decodes a whole RGB frame; while memory is short the original
+       is sent instead and the browser scales it */
+    if (scale > 1 && mem_pressure_level() >= MEM_PRESSURE_CACHE_SHRUNK) {
+        mem_pressure_note(MEM_PRESSURE_CACHE_SHRUNK);
+        scale = 1;
+    }
+    if (scale > 1) {
+        esp_err_t err = photo_scaler_submit(req, filepath, id, scale);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Scaler busy for %s: %s", id, esp_err_to_name(err));
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            httpd_resp_set_hdr(req, "Retry-After", "1");
+            httpd_resp_sendstr(req, "Scaler busy");
+        }
+        return ESP_OK;
+    }
+#endif
+
+    /* Recently captured photos are kept in PSRAM by the recorder */
+    photo_cache_entry_t *cached = photo_cache_get(id, 1);
+    if (cached) {
+        httpd_resp_set_type(req, "image/jpeg");
+        httpd_resp_set_hdr(req, "Content-Disposition", "attachment");
+        httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=3600");
+        esp_err_t err = httpd_resp_send(req, (const char *)photo_cache_entry_data(cached), photo_cache_entry_len(cached));
+        photo_cache_release(cached);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Photo send failed");
+        }
+        return err;
+    }
+
     struct stat file_stat;
     if (stat(filepath, &file_stat) == -1) {
         ESP_LOGE(TAG, "Photo file not found: %s", filepath);
@@ -392,7 +613,7 @@ static esp_err_t photo_get_handler(httpd_req_t *req)
     char *chunk = server_data->scratch;
     size_t chunksize;
     do {
-        chunksize = fread(chunk, 1, SCRATCH_BUFSIZE, fd);
+        chunksize = fread(chunk, 1, server_data->scratch_len, fd);
         if (chunksize > 0) {
             if (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK) {
                 fclose(fd);
@@ -414,15 +635,779 @@ static esp_err_t photos_get_handler(httpd_req_t *req)
     return list_directory_handler(req, "pictures");
 }
 
+/* Most buckets in one /photos/histogram response (a week of hours) */
+#define HISTOGRAM_BUCKETS_MAX 168
+
+/* Widest bucket: the whole timeline ring */
+#define HISTOGRAM_BUCKET_MAX_S ((int64_t)CAPTURE_TIMELINE_SLOTS * CAPTURE_TIMELINE_SLOT_S)
+
+/* Latest accepted time (year 36812); keeps from + range far from int64 overflow */
+#define HISTOGRAM_EPOCH_MAX_S ((int64_t)1 << 40)
+
+/* GET /photos/histogram[?from=S&to=S&bucket=S] - photos per time bucket, read
+   from the recorder's capture timeline rather than the directory. Times are
+   epoch seconds; the default is the last 24 h in 1 h buckets. `from` is
+   rounded down to a timeline slot and `bucket` up to whole slots.
+   "covered_from" is where the timeline starts; earlier buckets read as 0.
+   Buckets wider than the ring or more than 168 of them get 400. */
+static esp_err_t histogram_get_handler(httpd_req_t *req)
+{
+    int64_t to = (int64_t)time(NULL);
+    int64_t from = to - 24 * 3600;
+    int64_t bucket = 3600;
+    char query[96];
+    char param[24];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "from", param, sizeof(param)) == ESP_OK) {
+            from = strtoll(param, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "to", param, sizeof(param)) == ESP_OK) {
+            to = strtoll(param, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "bucket", param, sizeof(param)) == ESP_OK) {
+            bucket = strtoll(param, NULL, 10);
+        }
+    }
+    if (from < 0 || to <= from || to > HISTOGRAM_EPOCH_MAX_S) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Need 0 <= from < to <= 2^40");
+        return ESP_OK;
+    }
+    if (bucket <= 0 || bucket > HISTOGRAM_BUCKET_MAX_S) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Need 0 < bucket <= 604800");
+        return ESP_OK;
+    }
+    if (to - from > HISTOGRAM_BUCKETS_MAX * bucket) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Too many buckets (max 168)");
+        return ESP_OK;
+    }
+    bucket = (bucket + CAPTURE_TIMELINE_SLOT_S - 1) / CAPTURE_TIMELINE_SLOT_S * CAPTURE_TIMELINE_SLOT_S;
+    from -= from % CAPTURE_TIMELINE_SLOT_S;
+    int64_t nbuckets = (to - from + bucket - 1) / bucket;
+    if (nbuckets > HISTOGRAM_BUCKETS_MAX) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Too many buckets (max 168)");
+        return ESP_OK;
+    }
+
+    uint32_t *counts = mem_tags_alloc(MEM_TAG_HTTP_BODY, nbuckets * sizeof(uint32_t));
+    if (!counts) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OOM");
+        return ESP_FAIL;
+    }
+    capture_timeline_query(from, (uint32_t)bucket, counts, (size_t)nbuckets);
+    capture_timeline_stats_t tl;
+    capture_timeline_get_stats(&tl);
+
+    resp_writer_t w;
+    resp_writer_begin(&w, req, resp_writer_negotiate(req));
+    resp_writer_map(&w);
+    resp_writer_kv_int(&w, "from", from);
+    resp_writer_kv_int(&w, "to", from + nbuckets * bucket);
+    resp_writer_kv_int(&w, "bucket", bucket);
+    resp_writer_key(&w, "covered_from");
+    if (tl.covered_from_s < 0) {
+        resp_writer_null(&w);
+    } else {
+        resp_writer_int(&w, tl.covered_from_s);
+    }
+    resp_writer_key(&w, "counts");
+    resp_writer_array(&w);
+    for (int64_t i = 0; i < nbuckets; i++) {
+        resp_writer_uint(&w, counts[i]);
+    }
+    resp_writer_end(&w);
+    resp_writer_end(&w);
+    mem_tags_free(counts);
+    resp_writer_finish(&w);
+    return ESP_OK;
+}
+#endif /* NODE_HAS_CAPTURE */
+
+/* Average of a latency total over a count, 0 when nothing was counted */
+#define METRIC_AVG(total, count) ((unsigned long)((count) ? (total) / (count) : 0))
+
+/* GET /metrics - runtime counters of the capture and serving paths as JSON,
+   or CBOR for Accept: application/cbor. Streamed in small chunks. */
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    resp_writer_t w;
+    resp_writer_begin(&w, req, resp_writer_negotiate(req));
+    resp_writer_map(&w);
+
+    /* Firmware profile and where the boot time went */
+    node_profile_stats_t node;
+    node_profile_get_stats(&node);
+    resp_writer_key(&w, "node");
+    resp_writer_map(&w);
+    resp_writer_kv_str(&w, "profile", node.profile);
+    resp_writer_key(&w, "features");
+    resp_writer_array(&w);
+    for (uint32_t i = 0; i < node.nfeatures; i++) {
+        resp_writer_str(&w, node.features[i]);
+    }
+    resp_writer_end(&w);
+    resp_writer_kv_uint(&w, "boot_ms", node.ready_us / 1000);
+    resp_writer_key(&w, "boot_stages");
+    resp_writer_map(&w);
+    for (uint32_t i = 0, prev = 0; i < node.nmilestones; i++) {
+        resp_writer_kv_uint(&w, node.milestones[i].name, (node.milestones[i].at_us - prev) / 1000);
+        prev = node.milestones[i].at_us;
+    }
+    resp_writer_end(&w);
+    resp_writer_end(&w);
+
+#if NODE_HAS_CAPTURE
+    photo_cache_stats_t cache;
+    photo_cache_get_stats(&cache);
+    resp_writer_key(&w, "photo_cache");
+    resp_writer_map(&w);
+    resp_writer_kv_uint(&w, "entries", cache.entries);
+    resp_writer_kv_uint(&w, "bytes", cache.bytes);
+    resp_writer_kv_uint(&w, "capacity", cache.capacity);
+    resp_writer_kv_uint(&w, "hits", cache.hits);
+    resp_writer_kv_uint(&w, "misses", cache.misses);
+    resp_writer_kv_uint(&w, "insertions", cache.insertions);
+    resp_writer_kv_uint(&w, "evictions", cache.evictions);
+    resp_writer_end(&w);
+#endif
+
+#if NODE_HAS_SCALER
+    photo_scaler_stats_t scaler;
+    photo_scaler_get_stats(&scaler);
+    resp_writer_key(&w, "photo_scaler");
+    resp_writer_map(&w);
+    resp_writer_kv_uint(&w, "hits", scaler.hits);
+    resp_writer_kv_uint(&w, "misses", scaler.misses);
+    resp_writer_kv_uint(&w, "failures", scaler.failures);
+    resp_writer_kv_uint(&w, "hit_us_avg", METRIC_AVG(scaler.hit_us_total, scaler.hits));
+    resp_writer_kv_uint(&w, "hit_us_max", scaler.hit_us_max);
+    resp_writer_kv_uint(&w, "miss_us_avg", METRIC_AVG(scaler.miss_us_total, scaler.misses));
+    resp_writer_kv_uint(&w, "miss_us_max", scaler.miss_us_max);
+    resp_writer_end(&w);
+#endif
+
+#if NODE_HAS_CAPTURE
+    recorder_dedup_stats_t dedup;
+    recorder_get_dedup_stats(&dedup);
+    resp_writer_key(&w, "dedup");
+    resp_writer_map(&w);
+    resp_writer_kv_uint(&w, "hashed", dedup.hashed);
+    resp_writer_kv_uint(&w, "hash_failures", dedup.hash_failures);
+    resp_writer_kv_uint(&w, "unique", dedup.unique);
+    resp_writer_kv_uint(&w, "dropped", dedup.dropped);
+    resp_writer_kv_uint(&w, "marked", dedup.marked);
+    resp_writer_kv_uint(&w, "hash_us_avg", METRIC_AVG(dedup.hash_us_total, dedup.hashed));
+    resp_writer_kv_uint(&w, "hash_us_max", dedup.hash_us_max);
+    resp_writer_end(&w);
+#endif
+
+    light_control_stats_t light;
+    light_control_get_stats(&light);
+    resp_writer_key(&w, "light");
+    resp_writer_map(&w);
+    resp_writer_kv_bool(&w, "night", light.night);
+    resp_writer_kv_uint(&w, "exposure_value", light.exposure_value);
+    resp_writer_kv_uint(&w, "led_duty", light.led_duty);
+    resp_writer_kv_uint(&w, "mode_switches", light.mode_switches);
+    resp_writer_kv_uint(&w, "led_flashes", light.led_flashes);
+    resp_writer_kv_uint(&w, "led_on_us_avg", METRIC_AVG(light.led_on_us_total, light.led_flashes));
+    resp_writer_kv_uint(&w, "led_on_us_max", light.led_on_us_max);
+    resp_writer_end(&w);
+
+    camera_guard_stats_t cam;
+    camera_guard_get_stats(&cam);
+    resp_writer_key(&w, "camera");
+    resp_writer_map(&w);
+    resp_writer_kv_bool(&w, "recovering", cam.recovering);
+    resp_writer_kv_uint(&w, "frames", cam.frames);
+    resp_writer_kv_uint(&w, "grab_failures", cam.grab_failures);
+    resp_writer_kv_uint(&w, "stalls", cam.stalls);
+    resp_writer_kv_uint(&w, "recoveries", cam.recoveries);
+    resp_writer_kv_uint(&w, "recovery_failures", cam.recovery_failures);
+    resp_writer_kv_uint(&w, "gate_timeouts", cam.gate_timeouts);
+    resp_writer_kv_uint(&w, "recovery_us_last", cam.last_recovery_us);
+    resp_writer_kv_uint(&w, "recovery_us_max", cam.max_recovery_us);
+    resp_writer_kv_str(&w, "last_reason", cam.last_reason);
+    resp_writer_end(&w);
+
+    camera_init_stats_t init;
+    camera_profile_get_stats(&init);
+    resp_writer_key(&w, "camera_init");
+    resp_writer_map(&w);
+    resp_writer_kv_str(&w, "profile", init.active);
+    resp_writer_kv_str(&w, "remembered", init.remembered);
+    resp_writer_kv_uint(&w, "remembered_misses", init.remembered_misses);
+    resp_writer_kv_uint(&w, "boot_us", init.boot_init_us);
+    resp_writer_kv_uint(&w, "boot_attempts", init.boot_attempts);
+    resp_writer_kv_uint(&w, "last_start_us", init.last_start_us);
+    resp_writer_key(&w, "profiles");
+    resp_writer_array(&w);
+    for (int i = 0; i < CAMERA_PROFILE_COUNT; i++) {
+        resp_writer_map(&w);
+        resp_writer_kv_str(&w, "name", init.profiles[i].name);
+        resp_writer_kv_uint(&w, "inits", init.profiles[i].inits);
+        resp_writer_kv_uint(&w, "failures", init.profiles[i].failures);
+        resp_writer_kv_uint(&w, "last_init_us", init.profiles[i].last_init_us);
+        resp_writer_end(&w);
+    }
+    resp_writer_end(&w);
+    resp_writer_end(&w);
+
+#if NODE_HAS_STREAM
+    mjpeg_stream_stats_t stream;
+    mjpeg_tcp_server_get_stats(&stream);
+    resp_writer_key(&w, "stream");
+    resp_writer_map(&w);
+    resp_writer_kv_bool(&w, "streaming", stream.streaming);
+    resp_writer_kv_uint(&w, "connects", stream.connects);
+    resp_writer_kv_uint(&w, "reconnects", stream.reconnects);
+    resp_writer_kv_uint(&w, "reconnects_last_min", stream.reconnects_last_min);
+    resp_writer_kv_uint(&w, "frames", stream.frames);
+    resp_writer_kv_uint(&w, "bytes", stream.bytes);
+    resp_writer_kv_uint(&w, "last_session_ms", stream.last_session_ms);
+    resp_writer_kv_uint(&w, "backoffs", stream.backoffs);
+    resp_writer_kv_uint(&w, "backoff_ms", stream.backoff_ms);
+    resp_writer_end(&w);
+
+    mjpeg_viewer_stats_t viewer;
+    mjpeg_tcp_server_get_viewer_stats(&viewer);
+    resp_writer_key(&w, "viewer");
+    resp_writer_map(&w);
+    resp_writer_kv_uint(&w, "reports", viewer.reports);
+    resp_writer_kv_uint(&w, "last_report_ms", viewer.last_report_ms);
+    resp_writer_key(&w, "fps");
+    resp_writer_tenths(&w, viewer.last.fps_x10);
+    resp_writer_kv_uint(&w, "kbps", viewer.last.kbps);
+    resp_writer_kv_uint(&w, "age_ms", viewer.last.age_ms);
+    resp_writer_kv_uint(&w, "age_ms_max", viewer.age_ms_max);
+    resp_writer_kv_uint(&w, "frames", viewer.frames);
+    resp_writer_kv_uint(&w, "dropped", viewer.dropped);
+    resp_writer_end(&w);
+#endif
+
+#if NODE_HAS_CAPTURE
+    capture_queue_stats_t queue;
+    capture_queue_get_stats(&queue);
+    resp_writer_key(&w, "capture_queue");
+    resp_writer_map(&w);
+    resp_writer_kv_uint(&w, "pushed", queue.pushed);
+    resp_writer_kv_uint(&w, "rejected", queue.rejected);
+    resp_writer_kv_uint(&w, "completed", queue.completed);
+    resp_writer_kv_uint(&w, "failed", queue.failed);
+    resp_writer_kv_uint(&w, "duplicates", queue.duplicates);
+    resp_writer_kv_uint(&w, "pending", queue.pending);
+    resp_writer_kv_uint(&w, "active", queue.active);
+    resp_writer_kv_uint(&w, "high_water", queue.high_water);
+    resp_writer_kv_uint(&w, "wait_us_avg", METRIC_AVG(queue.wait_us_total, queue.completed + queue.failed + queue.duplicates + queue.active));
+    resp_writer_kv_uint(&w, "wait_us_max", queue.wait_us_max);
+    resp_writer_key(&w, "requests");
+    resp_writer_array(&w);
+    capture_request_t pending[CAPTURE_QUEUE_LEN];
+    size_t npending = capture_queue_snapshot(pending, CAPTURE_QUEUE_LEN);
+    for (size_t i = 0; i < npending; i++) {
+        resp_writer_map(&w);
+        resp_writer_kv_uint(&w, "seq", pending[i].seq);
+        resp_writer_kv_str(&w, "state", pending[i].state == CAPTURE_SLOT_ACTIVE ? "active" : "pending");
+        resp_writer_kv_str(&w, "source", pending[i].trigger);
+        resp_writer_kv_uint(&w, "requested_ms", pending[i].requested_ms);
+        resp_writer_kv_str(&w, "path", pending[i].path);
+        resp_writer_end(&w);
+    }
+    resp_writer_end(&w);
+    resp_writer_end(&w);
+
+    /* Trigger queued to frame in hand; with light sleep this includes the wake-up */
+    recorder_latency_stats_t latency;
+    recorder_get_latency_stats(&latency);
+    resp_writer_key(&w, "capture_latency");
+    resp_writer_map(&w);
+    resp_writer_kv_uint(&w, "captures", latency.captures);
+    resp_writer_kv_uint(&w, "stale_frames", latency.stale_frames);
+    resp_writer_kv_uint(&w, "trigger_us_avg", METRIC_AVG(latency.trigger_us_total, latency.captures));
+    resp_writer_kv_uint(&w, "trigger_us_max", latency.trigger_us_max);
+    resp_writer_kv_uint(&w, "trigger_us_last", latency.trigger_us_last);
+    resp_writer_end(&w);
+#endif
+
+    power_ctl_stats_t power;
+    power_ctl_get_stats(&power);
+    resp_writer_key(&w, "power");
+    resp_writer_map(&w);
+    resp_writer_kv_bool(&w, "dfs", power.dfs);
+    resp_writer_kv_bool(&w, "light_sleep", power.light_sleep);
+    resp_writer_kv_uint(&w, "max_mhz", power.max_mhz);
+    resp_writer_kv_uint(&w, "min_mhz", power.min_mhz);
+    resp_writer_kv_uint(&w, "wakes", power.wakes);
+    resp_writer_kv_uint(&w, "light_sleeps", power.light_sleeps);
+    resp_writer_kv_uint(&w, "active_ms", power.active_us / 1000);
+    resp_writer_kv_uint(&w, "uptime_ms", power.uptime_us / 1000);
+    resp_writer_key(&w, "locks");
+    resp_writer_map(&w);
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        resp_writer_key(&w, power_ctl_lock_name(i));
+        resp_writer_map(&w);
+        resp_writer_kv_uint(&w, "taken", power.locks[i].taken);
+        resp_writer_kv_uint(&w, "held", power.locks[i].held);
+        resp_writer_kv_uint(&w, "held_ms", power.locks[i].held_us / 1000);
+        resp_writer_kv_uint(&w, "held_ms_max", power.locks[i].held_us_max / 1000);
+        resp_writer_end(&w);
+    }
+    resp_writer_end(&w);
+    resp_writer_end(&w);
+
+    /* Degradation level, what each stage did and the latest transitions */
+    mem_pressure_stats_t pressure;
+    mem_pressure_level();   // re-evaluate, the node may have been idle
+    mem_pressure_get_stats(&pressure);
+    resp_writer_key(&w, "mem_pressure");
+    resp_writer_map(&w);
+    resp_writer_kv_str(&w, "level", mem_pressure_level_name(pressure.level));
+    resp_writer_kv_uint(&w, "raised", pressure.raised);
+    resp_writer_kv_uint(&w, "eased", pressure.eased);
+    resp_writer_kv_uint(&w, "evaluations", pressure.evaluations);
+    resp_writer_key(&w, "stages");
+    resp_writer_map(&w);
+    for (int i = 0; i < MEM_PRESSURE_LEVEL_COUNT; i++) {
+        resp_writer_key(&w, mem_pressure_level_name(i));
+        resp_writer_map(&w);
+        resp_writer_kv_uint(&w, "entered", pressure.entered[i]);
+        resp_writer_kv_uint(&w, "applied", pressure.applied[i]);
+        resp_writer_kv_uint(&w, "ms", pressure.level_ms[i]);
+        resp_writer_end(&w);
+    }
+    resp_writer_end(&w);
+    resp_writer_key(&w, "transitions");
+    resp_writer_array(&w);
+    for (uint32_t i = 0; i < pressure.nevents; i++) {
+        const mem_pressure_event_t *ev = &pressure.events[i];
+        resp_writer_map(&w);
+        resp_writer_kv_uint(&w, "at_ms", ev->at_ms);
+        resp_writer_kv_str(&w, "from", mem_pressure_level_name(ev->from));
+        resp_writer_kv_str(&w, "to", mem_pressure_level_name(ev->to));
+        resp_writer_kv_str(&w, "cause", ev->cause);
+        resp_writer_kv_uint(&w, "internal_free", ev->internal_free);
+        resp_writer_kv_uint(&w, "psram_largest", ev->psram_largest);
+        resp_writer_end(&w);
+    }
+    resp_writer_end(&w);
+    resp_writer_end(&w);
+
+#if NODE_HAS_CAPTURE
+    capture_timeline_stats_t timeline;
+    capture_timeline_get_stats(&timeline);
+    resp_writer_key(&w, "timeline");
+    resp_writer_map(&w);
+    resp_writer_kv_int(&w, "covered_from", timeline.covered_from_s);
+    resp_writer_kv_int(&w, "covered_to", timeline.covered_to_s);
+    resp_writer_kv_uint(&w, "added", timeline.added);
+    resp_writer_kv_uint(&w, "too_old", timeline.too_old);
+    resp_writer_kv_uint(&w, "unsynced", timeline.unsynced);
+    resp_writer_kv_uint(&w, "seeded", timeline.seeded);
+    resp_writer_kv_uint(&w, "seed_us", timeline.seed_us);
+    resp_writer_end(&w);
+#endif
+
+#if CONFIG_EVENT_TRACE_ENABLE
+    /* What the tracer itself costs: time per event and the share of each core it took since boot */
+    event_trace_stats_t trace;
+    event_trace_get_stats(&trace);
+    uint64_t uptime_us = (uint64_t)esp_timer_get_time();
+    resp_writer_key(&w, "trace");
+    resp_writer_map(&w);
+    resp_writer_kv_bool(&w, "enabled", trace.enabled);
+    resp_writer_key(&w, "cores");
+    resp_writer_array(&w);
+    for (int core = 0; core < 2; core++) {
+        resp_writer_map(&w);
+        resp_writer_kv_uint(&w, "recorded", trace.recorded[core]);
+        resp_writer_kv_uint(&w, "cost_ns_avg", trace.cost_ns_avg[core]);
+        resp_writer_kv_uint(&w, "cost_ns_max", trace.cost_ns_max[core]);
+        uint64_t spent_ns = (uint64_t)trace.recorded[core] * trace.cost_ns_avg[core];
+        resp_writer_kv_uint(&w, "overhead_ppm", uptime_us ? spent_ns * 1000 / uptime_us : 0);
+        resp_writer_end(&w);
+    }
+    resp_writer_end(&w);
+    resp_writer_end(&w);
+#endif
+
+    /* Bytes and build time per response format, to compare JSON and CBOR */
+    resp_writer_stats_t enc[RESP_FORMAT_COUNT];
+    resp_writer_get_stats(enc);
+    static const char *const enc_names[RESP_FORMAT_COUNT] = { "json", "cbor" };
+    resp_writer_key(&w, "encoding");
+    resp_writer_map(&w);
+    for (int i = 0; i < RESP_FORMAT_COUNT; i++) {
+        resp_writer_key(&w, enc_names[i]);
+        resp_writer_map(&w);
+        resp_writer_kv_uint(&w, "responses", enc[i].responses);
+        resp_writer_kv_uint(&w, "bytes", enc[i].bytes);
+        resp_writer_kv_uint(&w, "build_us", enc[i].build_us);
+        resp_writer_end(&w);
+    }
+    resp_writer_end(&w);
+
+    log_ring_stats_t log;
+    log_ring_get_stats(&log);
+    resp_writer_key(&w, "log");
+    resp_writer_map(&w);
+    resp_writer_kv_bool(&w, "enabled", log.enabled);
+    resp_writer_kv_uint(&w, "lines", log.lines);
+    resp_writer_kv_uint(&w, "written", log.written);
+    resp_writer_kv_uint(&w, "drained", log.drained);
+    resp_writer_kv_uint(&w, "dropped", log.dropped);
+    resp_writer_end(&w);
+
+    resp_writer_end(&w);
+    resp_writer_finish(&w);
+    return ESP_OK;
+}
+
+/* GET /memory - heap free/low-water figures and per-tag byte counters as JSON */
+static esp_err_t memory_get_handler(httpd_req_t *req)
+{
+    char buf[320];
+    httpd_resp_set_type(req, "application/json");
+
+    mem_heap_stats_t heap;
+    mem_tags_get_heap(&heap);
+    snprintf(buf, sizeof(buf),
+             "{\"internal\":{\"free\":%u,\"min_free\":%u,\"largest\":%u,\"reserve\":%u,\"reserve_diverts\":%lu},"
+             "\"psram\":{\"free\":%u,\"min_free\":%u,\"largest\":%u},\"tags\":{",
+             (unsigned)heap.internal_free, (unsigned)heap.internal_min_free, (unsigned)heap.internal_largest,
+             (unsigned)MEM_TAGS_INTERNAL_RESERVE_BYTES, (unsigned long)heap.reserve_diverts,
+             (unsigned)heap.psram_free, (unsigned)heap.psram_min_free, (unsigned)heap.psram_largest);
+    httpd_resp_sendstr_chunk(req, buf);
+
+    mem_tag_stats_t tags[MEM_TAG_COUNT];
+    mem_tags_get_stats(tags);
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+        snprintf(buf, sizeof(buf),
+                 "%s\"%s\":{\"current\":%u,\"peak\":%u,\"internal\":%u,\"allocs\":%lu,\"failures\":%lu,"
+                 "\"fallbacks\":%lu}",
+                 i ? "," : "", tags[i].name, (unsigned)tags[i].current, (unsigned)tags[i].peak,
+                 (unsigned)tags[i].internal, (unsigned long)tags[i].allocs, (unsigned long)tags[i].failures,
+                 (unsigned long)tags[i].fallbacks);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+
+    httpd_resp_sendstr_chunk(req, "}}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
+/* GET /stacks - stack size and high-water mark per task (JSON or CBOR).
+   tools/stack_profile.py turns a profiling run's answer into task_plan_stacks.h */
+static esp_err_t stacks_get_handler(httpd_req_t *req)
+{
+    task_stack_usage_t *tasks = mem_tags_calloc(MEM_TAG_HTTP_BODY, TASK_PLAN_STACK_REPORT_MAX, sizeof(*tasks));
+    if (!tasks) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    size_t n = task_plan_stack_usage(tasks, TASK_PLAN_STACK_REPORT_MAX);
+
+    resp_writer_t w;
+    resp_writer_begin(&w, req, resp_writer_negotiate(req));
+    resp_writer_map(&w);
+    resp_writer_kv_str(&w, "source", task_plan_stack_source());
+    resp_writer_kv_uint(&w, "uptime_s", esp_timer_get_time() / 1000000);
+    resp_writer_key(&w, "tasks");
+    resp_writer_array(&w);
+    for (size_t i = 0; i < n; i++) {
+        const task_stack_usage_t *t = &tasks[i];
+        resp_writer_map(&w);
+        resp_writer_kv_str(&w, "name", t->name);
+        resp_writer_key(&w, "plan");
+        if (t->plan >= 0) resp_writer_str(&w, task_plan_id_name(t->plan)); else resp_writer_null(&w);
+        resp_writer_kv_bool(&w, "running", t->running);
+        resp_writer_kv_uint(&w, "stack", t->stack_size);
+        resp_writer_kv_uint(&w, "free_min", t->free_min);
+        resp_writer_end(&w);
+    }
+    resp_writer_end(&w);
+    resp_writer_end(&w);
+    mem_tags_free(tasks);
+    resp_writer_finish(&w);
+    return ESP_OK;
+}
+
+/* GET /settings - runtime knobs with value, range, default and apply mode */
+static esp_err_t settings_get_handler(httpd_req_t *req)
+{
+    char buf[192];
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{");
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        const setting_desc_t *d = settings_desc(i);
+        snprintf(buf, sizeof(buf),
+                 "%s\"%s\":{\"value\":%ld,\"pending\":%ld,\"min\":%ld,\"max\":%ld,\"default\":%ld,\"apply\":\"%s\"}",
+                 i ? "," : "", d->key, (long)settings_get(i), (long)settings_get_pending(i),
+                 (long)d->min, (long)settings_max(i), (long)d->def, d->live ? "live" : "restart");
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
+/* Largest PATCH /settings body accepted */
+#define SETTINGS_BODY_MAX 512
+
+/* PATCH /settings - {"key":value,...}; all values are validated before any is stored */
+static esp_err_t settings_patch_handler(httpd_req_t *req)
+{
+    int content_len = req->content_len;
+    if (content_len <= 0 || content_len > SETTINGS_BODY_MAX) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body must be a JSON object up to 512 bytes");
+        return ESP_FAIL;
+    }
+    char *body = mem_tags_alloc(MEM_TAG_HTTP_BODY, content_len + 1);
+    if (!body) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OOM");
+        return ESP_FAIL;
+    }
+    int received = 0;
+    while (received < content_len) {
+        int r = httpd_req_recv(req, body + received, content_len - received);
+        if (r <= 0) {
+            mem_tags_free(body);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad body");
+            return ESP_FAIL;
+        }
+        received += r;
+    }
+    body[received] = '\0';
+
+    char msg[96] = "";
+    bool restart = false;
+    esp_err_t err = settings_patch_json(body, msg, sizeof(msg), &restart);
+    mem_tags_free(body);
+
+    /* `msg` can quote the request body, so it goes through the encoder's escaping */
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_set_status(req, "400 Bad Request");
+    } else if (err != ESP_OK) {
+        httpd_resp_set_status(req, "500 Internal Server Error");
+    }
+    resp_writer_t w;
+    resp_writer_begin(&w, req, resp_writer_negotiate(req));
+    resp_writer_map(&w);
+    if (err == ESP_OK) {
+        resp_writer_kv_str(&w, "status", "ok");
+        resp_writer_kv_bool(&w, "restart_required", restart);
+    } else {
+        resp_writer_kv_str(&w, "status", err == ESP_ERR_INVALID_ARG ? "rejected" : "error");
+        resp_writer_kv_str(&w, "reason", msg);
+    }
+    resp_writer_end(&w);
+    resp_writer_finish(&w);
+    return ESP_OK;
+}
+
+#if NODE_HAS_STREAM
+/* Largest POST /telemetry body accepted */
+#define TELEMETRY_BODY_MAX 256
+
+/**
+ * @brief Read a non-negative number stored under `key` in a flat JSON object
+ *
+ * @param json Request body
+ * @param key Field name
+ * @param scale Multiplier applied before rounding (10 keeps one decimal)
+ * @return uint32_t The value, 0 when the field is missing or negative
+ */
+static uint32_t telemetry_field(const char *json, const char *key, double scale)
+{
+    char quoted[24];
+    snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+    const char *p = strstr(json, quoted);
+    if (!p) return 0;
+    p += strlen(quoted);
+    while (*p == ' ' || *p == ':') p++;
+    double v = strtod(p, NULL) * scale;
+    return v > 0 && v < UINT32_MAX ? (uint32_t)(v + 0.5) : 0;
+}
+
+/* POST /telemetry - {"fps":12.5,"kbps":900,"age_ms":140,"age_ms_max":310,"frames":120,"dropped":2}
+   from a live viewer; aggregated into the "viewer" section of /metrics */
+static esp_err_t telemetry_post_handler(httpd_req_t *req)
+{
+    int content_len = req->content_len;
+    if (content_len <= 0 || content_len > TELEMETRY_BODY_MAX) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body must be a JSON object up to 256 bytes");
+        return ESP_FAIL;
+    }
+    char body[TELEMETRY_BODY_MAX + 1];
+    int received = 0;
+    while (received < content_len) {
+        int r = httpd_req_recv(req, body + received, content_len - received);
+        if (r <= 0) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad body");
+            return ESP_FAIL;
+        }
+        received += r;
+    }
+    body[received] = '\0';
+
+    mjpeg_viewer_report_t report = {
+        .fps_x10 = telemetry_field(body, "fps", 10),
+        .kbps = telemetry_field(body, "kbps", 1),
+        .age_ms = telemetry_field(body, "age_ms", 1),
+        .age_ms_max = telemetry_field(body, "age_ms_max", 1),
+        .frames = telemetry_field(body, "frames", 1),
+        .dropped = telemetry_field(body, "dropped", 1),
+    };
+    mjpeg_tcp_server_report_viewer(&report);
+    httpd_resp_set_status(req, "204 No Content");
+    httpd_resp_send(req, NULL, 0);
+    return ESP_OK;
+}
+#endif
+
+/* Log lines copied per batch while serving GET /logs */
+#define LOG_DUMP_BATCH 8
+
+/* GET /logs[?since=N] - buffered log lines as plain text, oldest first.
+   X-Log-Next is the `since` value that continues after this response. */
+static esp_err_t logs_get_handler(httpd_req_t *req)
+{
+    log_ring_stats_t stats;
+    log_ring_get_stats(&stats);
+    if (!stats.enabled) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Log ring is disabled (CONFIG_LOG_RING_ENABLE)");
+        return ESP_OK;
+    }
+
+    uint32_t cursor = 0;
+    char query[32];
+    char param[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", param, sizeof(param)) == ESP_OK) {
+        cursor = strtoul(param, NULL, 10);
+    }
+
+    /* Serve what was written up to now so the reported cursor is exact */
+    uint32_t end = stats.written;
+    char next[12];
+    char dropped[12];
+    snprintf(next, sizeof(next), "%lu", (unsigned long)end);
+    snprintf(dropped, sizeof(dropped), "%lu", (unsigned long)stats.dropped);
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "X-Log-Next", next);
+    httpd_resp_set_hdr(req, "X-Log-Dropped", dropped);
+
+    log_ring_line_t lines[LOG_DUMP_BATCH];
+    while (cursor < end) {
+        size_t n = log_ring_read(&cursor, lines, LOG_DUMP_BATCH);
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i++) {
+            if (lines[i].seq > end) break;
+            if (httpd_resp_send_chunk(req, lines[i].text, lines[i].len) != ESP_OK) return ESP_FAIL;
+        }
+    }
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
+/* Trace events copied per batch while dumping */
+#define TRACE_DUMP_BATCH 16
+/* Distinct task names given their own track in a dump */
+#define TRACE_DUMP_TASKS 24
+
+static int trace_tid(char names[][EVENT_TRACE_TASK_NAME_MAX], int *count, const char *task){
+    for (int i = 0; i < *count; i++) {
+        if (strcmp(names[i], task) == 0) return i + 1;
+    }
+    if (*count >= TRACE_DUMP_TASKS) return TRACE_DUMP_TASKS + 1;   // shared overflow track
+    strlcpy(names[*count], task, EVENT_TRACE_TASK_NAME_MAX);
+    return ++(*count);
+}
+
+/* GET /trace - recorded events in Chrome trace JSON (load in Perfetto or chrome://tracing).
+   Each core is a process, each task a thread. */
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    event_trace_stats_t stats;
+    event_trace_get_stats(&stats);
+    if (!stats.enabled) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Tracing is disabled (CONFIG_EVENT_TRACE_ENABLE)");
+        return ESP_OK;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"camera.trace.json\"");
+    httpd_resp_sendstr_chunk(req, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    char tasks[TRACE_DUMP_TASKS][EVENT_TRACE_TASK_NAME_MAX];
+    int ntasks = 0;
+    event_trace_event_t batch[TRACE_DUMP_BATCH];
+    char line[160];
+    bool first = true;
+    for (int core = 0; core < 2; core++) {
+        uint32_t cursor = 0;
+        size_t n;
+        while ((n = event_trace_read(core, &cursor, batch, TRACE_DUMP_BATCH)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                const event_trace_event_t *e = &batch[i];
+                int tid = trace_tid(tasks, &ntasks, e->task);
+                snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%d,\"tid\":%d%s}",
+                         first ? "" : ",\n", e->name, e->phase, (long long)e->ts_us, core, tid,
+                         e->phase == EVENT_TRACE_INSTANT ? ",\"s\":\"t\"" : "");
+                httpd_resp_sendstr_chunk(req, line);
+                first = false;
+            }
+        }
+    }
+    /* Name the tracks */
+    for (int core = 0; core < 2; core++) {
+        snprintf(line, sizeof(line), "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"core %d\"}}",
+                 first ? "" : ",\n", core, core);
+        httpd_resp_sendstr_chunk(req, line);
+        first = false;
+        for (int i = 0; i < ntasks; i++) {
+            snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                     core, i + 1, tasks[i]);
+            httpd_resp_sendstr_chunk(req, line);
+        }
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
+/* Handlers registered through TRACED() get a span named after the handler */
+#if CONFIG_EVENT_TRACE_ENABLE
+#define TRACE_HANDLER(fn) \
+    static esp_err_t fn##_traced(httpd_req_t *req) \
+    { \
+        TRACE_BEGIN(#fn); \
+        esp_err_t ret = fn(req); \
+        TRACE_END(#fn); \
+        return ret; \
+    }
+#define TRACED(fn) fn##_traced
+#else
+#define TRACE_HANDLER(fn)
+#define TRACED(fn) fn
+#endif
+
+#if NODE_HAS_CAPTURE
+TRACE_HANDLER(picture_post_handler)
+TRACE_HANDLER(photos_get_handler)
+TRACE_HANDLER(photo_get_handler)
+#endif
+TRACE_HANDLER(metrics_get_handler)
+
+#if NODE_HAS_STUBS && NODE_HAS_CAPTURE
 /* Simple informative handler for GET /photo (root) */
 static esp_err_t photo_root_get_handler(httpd_req_t *req)
 {
     httpd_resp_set_type(req, "application/json");
-    const char *msg = "{\"usage\":\"GET /photo/{id} to download, POST /photo to capture\"}";
+    const char *msg = "{\"usage\":\"GET /photo/{id}[?scale=2|4|8] to download, POST /photo to capture\"}";
     httpd_resp_send(req, msg, strlen(msg));
     return ESP_OK;
 }
+#endif
 
+#if NODE_HAS_STUBS && NODE_HAS_STREAM
 /* Stub handler for /video when HTTP streaming is not provided by httpd.
    We serve MJPEG via standalone TCP streamer on port 8081; inform clients. */
 static esp_err_t mjpeg_stream_handler(httpd_req_t *req)
@@ -433,9 +1418,10 @@ static esp_err_t mjpeg_stream_handler(httpd_req_t *req)
     httpd_resp_send(req, msg, strlen(msg));
     return ESP_OK;
 }
+#endif
 
 
-
+#if NODE_HAS_WEB_UI
 #define IS_FILE_EXT(filename, ext) \
     (strcasecmp(&filename[strlen(filename) - sizeof(ext) + 1], ext) == 0)
 
@@ -451,6 +1437,8 @@ static esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filena
         return httpd_resp_set_type(req, "image/jpeg");
     } else if (IS_FILE_EXT(filename, ".png")) {
         return httpd_resp_set_type(req, "image/png");
+    } else if (IS_FILE_EXT(filename, ".svg")) {
+        return httpd_resp_set_type(req, "image/svg+xml");
     } else if (IS_FILE_EXT(filename, ".ico")) {
         return httpd_resp_set_type(req, "image/x-icon");
     }
@@ -495,7 +1483,7 @@ static esp_err_t file_get_handler(httpd_req_t *req)
     char *chunk = server_data->scratch;
     size_t chunksize;
     do {
-        chunksize = fread(chunk, 1, SCRATCH_BUFSIZE, fd);
+        chunksize = fread(chunk, 1, server_data->scratch_len, fd);
         if (chunksize > 0) {
             if (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK) {
                 fclose(fd);
@@ -512,6 +1500,208 @@ static esp_err_t file_get_handler(httpd_req_t *req)
     httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
+#endif
+
+/* Handlers registered through POWERED() hold the CPU at full speed while they
+   run; between requests the node can drop to its idle frequency */
+#define POWER_HANDLER_CALLING(fn, call) \
+    static esp_err_t fn##_powered(httpd_req_t *req) \
+    { \
+        power_ctl_acquire(POWER_LOCK_HTTP); \
+        esp_err_t ret = call(req); \
+        power_ctl_release(POWER_LOCK_HTTP); \
+        return ret; \
+    }
+#define POWER_HANDLER(fn) POWER_HANDLER_CALLING(fn, fn)
+#define POWER_TRACED_HANDLER(fn) POWER_HANDLER_CALLING(fn, TRACED(fn))
+#define POWERED(fn) fn##_powered
+
+#if NODE_HAS_CAPTURE
+POWER_TRACED_HANDLER(picture_post_handler)
+POWER_HANDLER(histogram_get_handler)
+POWER_TRACED_HANDLER(photos_get_handler)
+POWER_TRACED_HANDLER(photo_get_handler)
+#endif
+POWER_HANDLER(time_post_handler)
+POWER_HANDLER(time_get_handler)
+POWER_TRACED_HANDLER(metrics_get_handler)
+POWER_HANDLER(memory_get_handler)
+POWER_HANDLER(stacks_get_handler)
+POWER_HANDLER(settings_get_handler)
+POWER_HANDLER(settings_patch_handler)
+POWER_HANDLER(logs_get_handler)
+POWER_HANDLER(trace_get_handler)
+#if NODE_HAS_STREAM
+POWER_HANDLER(telemetry_post_handler)
+#endif
+#if NODE_HAS_STUBS && NODE_HAS_WEB_UI
+POWER_HANDLER(favicon_get_handler)
+#endif
+#if NODE_HAS_STUBS && NODE_HAS_CAPTURE
+POWER_HANDLER(photo_root_get_handler)
+#endif
+#if NODE_HAS_STUBS && NODE_HAS_STREAM
+POWER_HANDLER(mjpeg_stream_handler)
+#endif
+#if NODE_HAS_WEB_UI
+POWER_HANDLER(file_get_handler)
+#endif
+
+/* Spare URI handler slots beyond the ones registered below */
+#ifndef FILE_SERVER_URI_HEADROOM
+#define FILE_SERVER_URI_HEADROOM 4
+#endif
+
+/* URI handlers of this build, registered in order (the wildcard file handler last).
+   max_uri_handlers is sized from this table, so a feature set can never outgrow it. */
+static const httpd_uri_t s_uris[] = {
+#if NODE_HAS_STUBS && NODE_HAS_WEB_UI
+    /* Favicon handler (no-op) - register before wildcard */
+    {
+        .uri = "/favicon.ico",
+        .method = HTTP_GET,
+        .handler = POWERED(favicon_get_handler),
+    },
+#endif
+
+#if NODE_HAS_CAPTURE
+    /* Picture capture handler (POST to /photo) */
+    {
+        .uri = "/photo",
+        .method = HTTP_POST,
+        .handler = POWERED(picture_post_handler),
+    },
+
+    /* Capture histogram (register before the wildcard file handler) */
+    {
+        .uri = "/photos/histogram",
+        .method = HTTP_GET,
+        .handler = POWERED(histogram_get_handler),
+    },
+
+    /* Photos list handler */
+    {
+        .uri = "/photos",
+        .method = HTTP_GET,
+        .handler = POWERED(photos_get_handler),
+    },
+
+    /* Photo download handler (GET /photo/{id}) */
+    {
+        .uri = "/photo/*",
+        .method = HTTP_GET,
+        .handler = POWERED(photo_get_handler),
+    },
+#endif
+
+#if NODE_HAS_STUBS && NODE_HAS_CAPTURE
+    /* Photo root handler (GET /photo) to guide clients */
+    {
+        .uri = "/photo",
+        .method = HTTP_GET,
+        .handler = POWERED(photo_root_get_handler),
+    },
+#endif
+
+    /* Time sync handler (POST /time) */
+    {
+        .uri = "/time",
+        .method = HTTP_POST,
+        .handler = POWERED(time_post_handler),
+    },
+
+    /* Time query handler (GET /time) - return device time for clients */
+    {
+        .uri = "/time",
+        .method = HTTP_GET,
+        .handler = POWERED(time_get_handler),
+    },
+
+    /* (encryption removed) */
+
+    /* Runtime metrics (GET /metrics) */
+    {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = POWERED(metrics_get_handler),
+    },
+
+    /* Heap placement and per-tag allocation counters (GET /memory) */
+    {
+        .uri = "/memory",
+        .method = HTTP_GET,
+        .handler = POWERED(memory_get_handler),
+    },
+
+    /* Task stack high-water marks (GET /stacks) */
+    {
+        .uri = "/stacks",
+        .method = HTTP_GET,
+        .handler = POWERED(stacks_get_handler),
+    },
+
+    /* Runtime settings (GET/PATCH /settings) */
+    {
+        .uri = "/settings",
+        .method = HTTP_GET,
+        .handler = POWERED(settings_get_handler),
+    },
+    {
+        .uri = "/settings",
+        .method = HTTP_PATCH,
+        .handler = POWERED(settings_patch_handler),
+    },
+
+    /* Buffered log lines (GET /logs) */
+    {
+        .uri = "/logs",
+        .method = HTTP_GET,
+        .handler = POWERED(logs_get_handler),
+    },
+
+    /* Event trace dump (GET /trace) */
+    {
+        .uri = "/trace",
+        .method = HTTP_GET,
+        .handler = POWERED(trace_get_handler),
+    },
+
+#if NODE_HAS_STREAM
+    /* Live viewer telemetry (POST /telemetry) */
+    {
+        .uri = "/telemetry",
+        .method = HTTP_POST,
+        .handler = POWERED(telemetry_post_handler),
+    },
+#endif
+
+#if NODE_HAS_STUBS && NODE_HAS_STREAM
+    /* MJPEG stream handler (real-time) */
+    {
+        .uri = "/video",
+        .method = HTTP_GET,
+        .handler = POWERED(mjpeg_stream_handler),
+    },
+#endif
+
+#if NODE_HAS_WEB_UI
+    /* Root handler */
+    {
+        .uri = "/",
+        .method = HTTP_GET,
+        .handler = POWERED(file_get_handler),
+    },
+
+    /* Wildcard handler for all files - MUST BE LAST */
+    {
+        .uri = "/*",
+        .method = HTTP_GET,
+        .handler = POWERED(file_get_handler),
+    },
+#endif
+};
+
+#define FILE_SERVER_URI_COUNT (sizeof(s_uris) / sizeof(s_uris[0]))
 
 esp_err_t example_start_file_server(const char *static_base_path, const char *photos_base_path)
 {
@@ -527,6 +1717,15 @@ esp_err_t example_start_file_server(const char *static_base_path, const char *ph
         ESP_LOGE(TAG, "Failed to allocate memory");
         return ESP_ERR_NO_MEM;
     }
+    /* Chunk size and socket timeouts are restart settings: read once here */
+    server_data->scratch_len = settings_get(SETTING_HTTP_SCRATCH_SIZE);
+    server_data->scratch = mem_tags_alloc(MEM_TAG_HTTP_SCRATCH, server_data->scratch_len);
+    if (!server_data->scratch) {
+        ESP_LOGE(TAG, "Failed to allocate download buffer");
+        free(server_data);
+        server_data = NULL;
+        return ESP_ERR_NO_MEM;
+    }
     strlcpy(server_data->static_base, static_base_path, sizeof(server_data->static_base));
 
     /* Use provided media base (photos_base_path) for storing pictures/videos */
@@ -537,131 +1736,73 @@ esp_err_t example_start_file_server(const char *static_base_path, const char *ph
         strlcpy(server_data->media_base, "/data", sizeof(server_data->media_base));
     }
 
-    ESP_LOGI(TAG, "Media base set to: %s", server_data->media_base);
+    /* Stream-only builds have no SD card and nothing to index */
+    if (NODE_HAS_CAPTURE) {
+        ESP_LOGI(TAG, "Media base set to: %s", server_data->media_base);
+
+        /* Ensure media directories exist */
+        ensure_subdir(server_data->media_base, "pictures");
 
-    /* Ensure media directories exist */
-    ensure_subdir(server_data->media_base, "pictures");
+        /* Fill the capture timeline with the photos taken before this boot */
+        char pictures_dir[FILE_PATH_MAX + 16];
+        snprintf(pictures_dir, sizeof(pictures_dir), "%s/pictures", server_data->media_base);
+        capture_timeline_seed(pictures_dir);
 
-    /* List all files in the media base path for debugging */
-    list_files_in_directory(server_data->media_base);
+        /* List all files in the media base path for debugging */
+        list_files_in_directory(server_data->media_base);
+    }
 
     httpd_handle_t server = NULL;
      httpd_config_t config = HTTPD_DEFAULT_CONFIG();
      config.uri_match_fn = httpd_uri_match_wildcard;
-     /* Increase stack for streaming and raise server task priority so MJPEG
-         streaming is less likely to block other handlers. */
-     config.stack_size = 16384;   // larger stack for MJPEG streaming
-     config.task_priority = 5;    // moderate priority
+     config.server_port = FILE_SERVER_PORT;
+     /* Stack, priority and core come from the task plan (large stack for MJPEG streaming) */
+     const task_plan_entry_t *plan = task_plan_get(TASK_PLAN_HTTPD);
+     config.stack_size = plan->stack_size;
+     config.task_priority = plan->priority;
+     config.core_id = plan->core;
      config.lru_purge_enable = true;
-     config.max_uri_handlers = 16;
-     config.recv_wait_timeout = 20;
-     config.send_wait_timeout = 20;
-     config.max_open_sockets = 5;
+     config.max_uri_handlers = FILE_SERVER_URI_COUNT + FILE_SERVER_URI_HEADROOM;
+     config.recv_wait_timeout = settings_get(SETTING_HTTP_RECV_TIMEOUT_S);
+     config.send_wait_timeout = settings_get(SETTING_HTTP_SEND_TIMEOUT_S);
+     config.max_open_sockets = CONFIG_NODE_HTTP_MAX_SOCKETS;
 
     ESP_LOGI(TAG, "Starting HTTP server on port %d", config.server_port);
     if (httpd_start(&server, &config) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start HTTP server");
+        mem_tags_free(server_data->scratch);
         free(server_data);
+        server_data = NULL;
         return ESP_FAIL;
     }
 
+    for (size_t i = 0; i < FILE_SERVER_URI_COUNT; i++) {
+        httpd_uri_t uri = s_uris[i];
+        uri.user_ctx = server_data;
+        esp_err_t err = httpd_register_uri_handler(server, &uri);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register %s: %s", uri.uri, esp_err_to_name(err));
+            httpd_stop(server);
+            mem_tags_free(server_data->scratch);
+            free(server_data);
+            server_data = NULL;
+            return err;
+        }
+    }
+
+#if NODE_HAS_SCALER
+    /* Scaled photo variants are produced by a worker, never on the httpd task */
+    if (photo_scaler_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Photo scaler unavailable; ?scale requests will be rejected");
+    }
+#endif
+
+#if NODE_HAS_STREAM
     /* Start standalone MJPEG TCP streamer (port 8081) so streaming cannot
        block the main HTTP server handlers. */
-    extern void mjpeg_tcp_server_start(void);
     mjpeg_tcp_server_start();
-
-    /* Favicon handler (no-op) - register before wildcard */
-    httpd_uri_t favicon = {
-        .uri = "/favicon.ico",
-        .method = HTTP_GET,
-        .handler = favicon_get_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &favicon);
-
-    /* Picture capture handler (POST to /photo) */
-    httpd_uri_t photo_post = {
-        .uri = "/photo",
-        .method = HTTP_POST,
-        .handler = picture_post_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &photo_post);
-
-    /* Photos list handler */
-    httpd_uri_t photos = {
-        .uri = "/photos",
-        .method = HTTP_GET,
-        .handler = photos_get_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &photos);
-
-    /* Time sync handler (POST /time) */
-    httpd_uri_t time_post = {
-        .uri = "/time",
-        .method = HTTP_POST,
-        .handler = time_post_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &time_post);
-
-    /* Time query handler (GET /time) - return device time for clients */
-    httpd_uri_t time_get = {
-        .uri = "/time",
-        .method = HTTP_GET,
-        .handler = time_get_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &time_get);
-
-    /* (encryption removed) */
-
-    /* Photo download handler (GET /photo/{id}) */
-    httpd_uri_t photo_get = {
-        .uri = "/photo/*",
-        .method = HTTP_GET,
-        .handler = photo_get_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &photo_get);
-
-    /* Photo root handler (GET /photo) to guide clients */
-    httpd_uri_t photo_root_get = {
-        .uri = "/photo",
-        .method = HTTP_GET,
-        .handler = photo_root_get_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &photo_root_get);
-
-    /* MJPEG stream handler (real-time) */
-    httpd_uri_t mjpeg = {
-        .uri = "/video",
-        .method = HTTP_GET,
-        .handler = mjpeg_stream_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &mjpeg);
-
-    /* Root handler */
-    httpd_uri_t root = {
-        .uri = "/",
-        .method = HTTP_GET,
-        .handler = file_get_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &root);
-
-    /* Wildcard handler for all files - MUST BE LAST */
-    httpd_uri_t file_handler = {
-        .uri = "/*",
-        .method = HTTP_GET,
-        .handler = file_get_handler,
-        .user_ctx = server_data
-    };
-    httpd_register_uri_handler(server, &file_handler);
+#endif
 
     ESP_LOGI(TAG, "File server started successfully");
     return ESP_OK;
-}
\ No newline at end of file
+}
@@ -5,6 +5,7 @@
  * 
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <sys/param.h>
 #include <sys/errno.h>
@@ -12,16 +13,244 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <sys/time.h>
+
+#include "mjpeg_tcp_server.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_camera.h"
+#include "task_plan.h"
+#include "event_trace.h"
+#include "settings.h"
+#include "camera_guard.h"
+#include "mem_tags.h"
+#include "power_ctl.h"
+#include "mem_pressure.h"
+#include "capture_queue.h"
+#include "camera_profile.h"
 
 static const char *TAG = "mjpeg_tcp";
 #define MJPEG_PORT 8081
 #define BACKLOG 1
-#define FRAME_DELAY_MS 100
+
+/* Wait for a camera re-init per attempt, and pause after a failed grab */
+#define MJPEG_CAMERA_WAIT_MS 1000
+#define MJPEG_RETRY_MS 100
+
+/* The frame copy grows in steps of this many bytes */
+#define MJPEG_FRAME_STEP (16 * 1024)
+
+/* Stream frame size while memory is short (MEM_PRESSURE_STREAM_SMALL) */
+#ifndef MJPEG_PRESSURE_FRAMESIZE
+#define MJPEG_PRESSURE_FRAMESIZE FRAMESIZE_QVGA
+#endif
+
+/* Retry-After of a viewer turned away while the stream is off */
+#define MJPEG_PRESSURE_RETRY_S 10
+
+static mjpeg_stream_stats_t s_stats = {0};
+static int64_t s_last_disconnect_us = 0;
+static int64_t s_minute = 0;                // minute index of s_minute_reconnects
+static uint32_t s_minute_reconnects = 0;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static mjpeg_viewer_stats_t s_viewer = {0};
+static int64_t s_viewer_report_us = 0;
+
+/* Frames are copied out of the camera buffer before sending, so a viewer that
+   stops reading blocks only this task and never holds a camera frame */
+static uint8_t *s_frame = NULL;
+static size_t s_frame_cap = 0;
+
+/* Stream frame size to go back to once memory pressure ends, FRAMESIZE_INVALID outside an episode */
+static framesize_t s_restore_size = FRAMESIZE_INVALID;
+
+/* Move the per-minute reconnect bucket forward to `minute` (stats lock held) */
+static void roll_minute(int64_t minute){
+    if (minute == s_minute) return;
+    s_stats.reconnects_last_min = (minute == s_minute + 1) ? s_minute_reconnects : 0;
+    s_minute_reconnects = 0;
+    s_minute = minute;
+}
+
+/**
+ * @brief Count a new client, and a reconnect if the previous one just left
+ *
+ * @param now_us Connect time
+ */
+static void stats_connect(int64_t now_us){
+    portENTER_CRITICAL(&s_stats_lock);
+    roll_minute(now_us / 60000000);
+    s_stats.connects++;
+    if (s_last_disconnect_us && now_us - s_last_disconnect_us <= (int64_t)MJPEG_RECONNECT_WINDOW_MS * 1000) {
+        s_stats.reconnects++;
+        s_minute_reconnects++;
+    }
+    s_stats.streaming = true;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void stats_disconnect(int64_t connected_us){
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.streaming = false;
+    s_stats.last_session_ms = (uint32_t)((now_us - connected_us) / 1000);
+    s_last_disconnect_us = now_us;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void stats_frame(size_t len){
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.frames++;
+    s_stats.bytes += len;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void stats_backoff(uint32_t waited_ms){
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.backoffs++;
+    s_stats.backoff_ms += waited_ms;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+void mjpeg_tcp_server_get_stats(mjpeg_stream_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_stats_lock);
+    roll_minute(esp_timer_get_time() / 60000000);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+void mjpeg_tcp_server_report_viewer(const mjpeg_viewer_report_t *report){
+    if (!report) return;
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_lock);
+    s_viewer.reports++;
+    s_viewer.last = *report;
+    s_viewer.age_ms_max = MAX(s_viewer.age_ms_max, report->age_ms_max);
+    s_viewer.frames += report->frames;
+    s_viewer.dropped += report->dropped;
+    s_viewer_report_us = now_us;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+void mjpeg_tcp_server_get_viewer_stats(mjpeg_viewer_stats_t *out){
+    if (!out) return;
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_viewer;
+    out->last_report_ms = s_viewer_report_us ? (uint32_t)((now_us - s_viewer_report_us) / 1000) : 0;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+/**
+ * @brief Wall-clock capture time of a frame in epoch ms
+ *
+ * The frame timestamp comes from esp_timer; it is shifted onto the system
+ * clock (set by POST /time) so a viewer can compute the frame's age.
+ *
+ * @param fb Frame
+ * @return uint64_t Capture time in ms since the epoch
+ */
+static uint64_t frame_epoch_ms(const camera_fb_t *fb){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t taken_us = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    int64_t age_us = esp_timer_get_time() - taken_us;
+    if (age_us < 0) age_us = 0;
+    return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000 - (uint64_t)(age_us / 1000);
+}
+
+/**
+ * @brief Copy a frame into the stream buffer, growing it when needed
+ *
+ * @param fb Frame to copy
+ * @return true if the frame is in s_frame
+ */
+static bool copy_frame(const camera_fb_t *fb){
+    if (fb->len > s_frame_cap) {
+        size_t cap = (fb->len + MJPEG_FRAME_STEP - 1) / MJPEG_FRAME_STEP * MJPEG_FRAME_STEP;
+        uint8_t *grown = mem_tags_alloc(MEM_TAG_STREAM, cap);
+        if (!grown) {
+            ESP_LOGW(TAG, "No memory for a %u byte frame", (unsigned)fb->len);
+            return false;
+        }
+        mem_tags_free(s_frame);
+        s_frame = grown;
+        s_frame_cap = cap;
+    }
+    memcpy(s_frame, fb->buf, fb->len);
+    return true;
+}
+
+/**
+ * @brief Send a whole buffer
+ *
+ * @param sock Client socket
+ * @param buf Data
+ * @param len Bytes to send
+ * @return true if everything was sent
+ */
+static bool send_all(int sock, const void *buf, size_t len){
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t s = send(sock, p, len, 0);
+        if (s < 0) {
+            ESP_LOGI(TAG, "client disconnected: errno=%d", errno);
+            return false;
+        }
+        p += s;
+        len -= s;
+    }
+    return true;
+}
+
+/**
+ * @brief Shrink the sensor frame size under memory pressure and restore it after
+ *
+ * A capture sets its own frame size; the stream only changes the size while
+ * no capture is queued, and shrinks it again after one. The check and the
+ * change happen under the sensor mutex the capture holds until its frame is
+ * grabbed; while a capture holds it the size is left for the next frame.
+ * Call between camera_guard_enter() and camera_guard_exit().
+ *
+ * @param small true while MEM_PRESSURE_STREAM_SMALL or above is in effect
+ */
+static void fit_frame_size(bool small){
+    if (!small && s_restore_size == FRAMESIZE_INVALID) return;
+    if (!camera_guard_sensor_take(0)) return;
+    sensor_t *s = esp_camera_sensor_get();
+    capture_queue_stats_t queue;
+    capture_queue_get_stats(&queue);
+    if (!s || queue.pending || queue.active) {
+        camera_guard_sensor_give();
+        return;
+    }
+    framesize_t cur = s->status.framesize;
+    if (small && cur > MJPEG_PRESSURE_FRAMESIZE) {
+        /* Once per episode, and the stream's own size: a capture may have left
+           the sensor at its capture size */
+        if (s_restore_size == FRAMESIZE_INVALID) {
+            framesize_t own = camera_profile_frame_size();
+            s_restore_size = own != FRAMESIZE_INVALID ? own : cur;
+        }
+        s->set_framesize(s, MJPEG_PRESSURE_FRAMESIZE);
+        mem_pressure_note(MEM_PRESSURE_STREAM_SMALL);
+        /* Let the copy buffer regrow at the smaller size */
+        mem_tags_free(s_frame);
+        s_frame = NULL;
+        s_frame_cap = 0;
+    } else if (!small && s_restore_size != FRAMESIZE_INVALID) {
+        if (cur != s_restore_size) {
+            s->set_framesize(s, s_restore_size);
+        }
+        s_restore_size = FRAMESIZE_INVALID;
+    }
+    camera_guard_sensor_give();
+}
 
 /**
  * @brief Handle a connected MJPEG client
@@ -33,6 +262,7 @@ static void mjpeg_client_handler(int client_sock){
                       "Server: esp32-mjpeg\r\n"
                       "Cache-Control: no-cache\r\n"
                       "Pragma: no-cache\r\n"
+                      "Access-Control-Allow-Origin: *\r\n"
                       "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n\r\n";
 
     if (send(client_sock, hdr, strlen(hdr), 0) < 0) {
@@ -41,52 +271,75 @@ static void mjpeg_client_handler(int client_sock){
         return;
     }
 
-    while (true) {
-        camera_fb_t *fb = esp_camera_fb_get();
-        if (!fb) {
-            vTaskDelay(pdMS_TO_TICKS(10));
-            continue;
-        }
+    /* A viewer that stops reading (paused) closes its TCP window and the send
+       below blocks; after MJPEG_PAUSE_MAX_MS of that the client is dropped */
+    struct timeval send_timeout = {
+        .tv_sec = MJPEG_PAUSE_MAX_MS / 1000,
+        .tv_usec = (MJPEG_PAUSE_MAX_MS % 1000) * 1000,
+    };
+    setsockopt(client_sock, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
 
-        char part_hdr[128];
-        int hlen = snprintf(part_hdr, sizeof(part_hdr),
-                            "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
-                            (unsigned)fb->len);
-
-        if (send(client_sock, part_hdr, hlen, 0) < 0) {
-            ESP_LOGI(TAG, "client disconnected (header)");
-            esp_camera_fb_return(fb);
+    while (true) {
+        /* The stream is the first thing given up when memory runs short */
+        mem_pressure_level_t pressure = mem_pressure_level();
+        if (pressure >= MEM_PRESSURE_STREAM_OFF) {
+            ESP_LOGW(TAG, "Memory pressure (%s), dropping viewer", mem_pressure_level_name(pressure));
+            mem_pressure_note(MEM_PRESSURE_STREAM_OFF);
             break;
         }
 
-        ssize_t sent = 0;
-        const char *buf = (const char *)fb->buf;
-        size_t to_send = fb->len;
-        while (to_send > 0) {
-            ssize_t s = send(client_sock, buf + sent, to_send, 0);
-            if (s < 0) {
-                ESP_LOGI(TAG, "client disconnected (body): errno=%d", errno);
-                break;
-            }
-            sent += s;
-            to_send -= s;
+        /* Hold the camera only while a frame is copied out, so a re-init by the
+           watchdog is blocked neither by the pause between frames nor by a
+           slow or paused viewer */
+        if (!camera_guard_enter(pdMS_TO_TICKS(MJPEG_CAMERA_WAIT_MS))) {
+            continue;
         }
-
-        if (to_send > 0) {
-            esp_camera_fb_return(fb);
+        fit_frame_size(pressure >= MEM_PRESSURE_STREAM_SMALL);
+        TRACE_BEGIN("fb_get");
+        camera_fb_t *fb = camera_guard_fb_get();
+        TRACE_END("fb_get");
+        if (!fb) {
+            camera_guard_exit();
+            vTaskDelay(pdMS_TO_TICKS(MJPEG_RETRY_MS));
+            continue;
+        }
+        size_t len = fb->len;
+        uint64_t taken_ms = frame_epoch_ms(fb);
+        bool copied = copy_frame(fb);
+        esp_camera_fb_return(fb);
+        camera_guard_exit();
+        if (!copied) {
             break;
         }
 
-        if (send(client_sock, "\r\n", 2, 0) < 0) {
-            ESP_LOGI(TAG, "client disconnected (terminator)");
-            esp_camera_fb_return(fb);
+        TRACE_BEGIN("mjpeg_send");
+        int64_t send_start_us = esp_timer_get_time();
+        char part_hdr[128];
+        int hlen = snprintf(part_hdr, sizeof(part_hdr),
+                            "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n"
+                            "X-Timestamp: %llu\r\n\r\n",
+                            (unsigned)len, (unsigned long long)taken_ms);
+        bool sent = send_all(client_sock, part_hdr, hlen) && send_all(client_sock, s_frame, len) &&
+                    send_all(client_sock, "\r\n", 2);
+        TRACE_END("mjpeg_send");
+        if (!sent) {
             break;
         }
 
-        esp_camera_fb_return(fb);
-        vTaskDelay(pdMS_TO_TICKS(FRAME_DELAY_MS));
+        stats_frame(len);
+        /* No new frame is grabbed while the viewer was not reading; the next
+           one is taken once it drains, so it is fresh rather than queued */
+        uint32_t waited_ms = (uint32_t)((esp_timer_get_time() - send_start_us) / 1000);
+        if (waited_ms >= MJPEG_BACKOFF_MS) {
+            stats_backoff(waited_ms);
+        }
+        vTaskDelay(pdMS_TO_TICKS(settings_get(SETTING_STREAM_FRAME_DELAY_MS)));
     }
 
+    /* Keep the copy buffer only while someone is watching */
+    mem_tags_free(s_frame);
+    s_frame = NULL;
+    s_frame_cap = 0;
     close(client_sock);
 }
 
@@ -138,8 +391,26 @@ static void mjpeg_tcp_server_task(void *arg){
             continue;
         }
 
+        if (mem_pressure_level() >= MEM_PRESSURE_STREAM_OFF) {
+            char busy[160];
+            int n = snprintf(busy, sizeof(busy),
+                             "HTTP/1.0 503 Service Unavailable\r\nRetry-After: %d\r\n"
+                             "Access-Control-Allow-Origin: *\r\nContent-Length: 0\r\n\r\n",
+                             MJPEG_PRESSURE_RETRY_S);
+            send(client_sock, busy, n, 0);
+            close(client_sock);
+            mem_pressure_note(MEM_PRESSURE_STREAM_OFF);
+            continue;
+        }
+
         ESP_LOGI(TAG, "Client connected: %s:%d", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+        int64_t connected_us = esp_timer_get_time();
+        stats_connect(connected_us);
+        /* Waiting in accept() is idle time; a viewer keeps the CPU at full speed */
+        power_ctl_acquire(POWER_LOCK_STREAM);
         mjpeg_client_handler(client_sock);
+        power_ctl_release(POWER_LOCK_STREAM);
+        stats_disconnect(connected_us);
         ESP_LOGI(TAG, "Client handler finished");
     }
 
@@ -152,8 +423,8 @@ static void mjpeg_tcp_server_task(void *arg){
  * 
  */
 void mjpeg_tcp_server_start(void){
-    /* Create the TCP server task on its own stack and priority */
-    if (xTaskCreate(mjpeg_tcp_server_task, "mjpeg_tcp", 12 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL) != pdPASS) {
+    /* Core, stack and priority come from the task plan */
+    if (task_plan_create(TASK_PLAN_STREAMER, mjpeg_tcp_server_task, NULL, NULL) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create MJPEG TCP server task");
     }
 }
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A connect this soon after the previous client left counts as a reconnect
+   (a page re-creating its stream element rather than a new viewer) */
+#ifndef MJPEG_RECONNECT_WINDOW_MS
+#define MJPEG_RECONNECT_WINDOW_MS 5000
+#endif
+
+/* A frame whose send blocks this long means the viewer stopped reading
+   (paused); the stream then waits for it instead of grabbing new frames */
+#ifndef MJPEG_BACKOFF_MS
+#define MJPEG_BACKOFF_MS 1000
+#endif
+
+/* A viewer paused for longer than this is dropped; it reconnects on resume */
+#ifndef MJPEG_PAUSE_MAX_MS
+#define MJPEG_PAUSE_MAX_MS 120000
+#endif
+
+typedef struct {
+    bool streaming;                 // a client is connected now
+    uint32_t connects;
+    uint32_t reconnects;            // connects within MJPEG_RECONNECT_WINDOW_MS of a disconnect
+    uint32_t reconnects_last_min;   // reconnects during the previous full minute
+    uint32_t frames;
+    uint64_t bytes;
+    uint32_t last_session_ms;       // length of the latest finished connection
+    uint32_t backoffs;              // frames held back by a viewer that stopped reading
+    uint32_t backoff_ms;            // time spent waiting on such viewers
+} mjpeg_stream_stats_t;
+
+/* One telemetry report from a browser viewer (POST /telemetry) */
+typedef struct {
+    uint32_t fps_x10;               // frames drawn per second, in tenths
+    uint32_t kbps;
+    uint32_t age_ms;                // average capture-to-draw time
+    uint32_t age_ms_max;
+    uint32_t frames;                // frames drawn since the previous report
+    uint32_t dropped;               // frames skipped by the decoder since the previous report
+} mjpeg_viewer_report_t;
+
+typedef struct {
+    uint32_t reports;
+    uint32_t last_report_ms;        // time since the latest report, 0 if none yet
+    mjpeg_viewer_report_t last;
+    uint32_t age_ms_max;            // worst age reported since boot
+    uint32_t frames;                // totals over all reports
+    uint32_t dropped;
+} mjpeg_viewer_stats_t;
+
+// Start the MJPEG TCP server task (port 8081)
+void mjpeg_tcp_server_start(void);
+
+// Snapshot of stream counters
+void mjpeg_tcp_server_get_stats(mjpeg_stream_stats_t *out);
+
+// Fold a viewer's telemetry report into the viewer counters
+void mjpeg_tcp_server_report_viewer(const mjpeg_viewer_report_t *report);
+
+// Snapshot of viewer telemetry
+void mjpeg_tcp_server_get_viewer_stats(mjpeg_viewer_stats_t *out);
@@ -0,0 +1,302 @@
+/**
+ * @file photo_scaler.c
+ * @author xholanp00
+ * @brief Downscaled photo variants (1/2, 1/4, 1/8) produced off the httpd task
+ *
+ */
+
+#include "photo_scaler.h"
+#include "photo_cache.h"
+#include "task_plan.h"
+#include "event_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mem_tags.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "jpeg_decoder.h"
+#include "img_converters.h"
+
+static const char *TAG = "photo_scaler"; // Tag for logging
+
+#define SCALER_QUEUE_LEN 4
+#define SCALER_PATH_MAX 256
+
+/* One pending scale request; the httpd request is an async copy owned by the worker */
+typedef struct {
+    httpd_req_t *req;
+    char filepath[SCALER_PATH_MAX];
+    char id[PHOTO_CACHE_ID_MAX];
+    int scale;
+    int64_t start_us;
+} scale_job_t;
+
+static QueueHandle_t s_job_queue = NULL;
+static photo_scaler_stats_t s_stats = {0};
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void record_latency(bool hit, int64_t start_us){
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+    portENTER_CRITICAL(&s_stats_lock);
+    if (hit) {
+        s_stats.hits++;
+        s_stats.hit_us_total += us;
+        if (us > s_stats.hit_us_max) s_stats.hit_us_max = us;
+    } else {
+        s_stats.misses++;
+        s_stats.miss_us_total += us;
+        if (us > s_stats.miss_us_max) s_stats.miss_us_max = us;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static esp_err_t send_jpeg(httpd_req_t *req, const uint8_t *data, size_t len){
+    httpd_resp_set_type(req, "image/jpeg");
+    httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=3600");
+    return httpd_resp_send(req, (const char *)data, len);
+}
+
+/**
+ * @brief Read a JPEG file into a scaler (PSRAM) buffer
+ *
+ * @param filepath Path of the JPEG file
+ * @param out Receives the buffer (mem_tags_free to release)
+ * @param out_len Receives the file length
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+static esp_err_t read_file_psram(const char *filepath, uint8_t **out, size_t *out_len){
+    struct stat st;
+    if (stat(filepath, &st) != 0 || st.st_size <= 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint8_t *buf = mem_tags_alloc(MEM_TAG_SCALER, st.st_size);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    FILE *f = fopen(filepath, "rb");
+    if (!f) {
+        mem_tags_free(buf);
+        return ESP_FAIL;
+    }
+    size_t got = fread(buf, 1, st.st_size, f);
+    fclose(f);
+    if (got != (size_t)st.st_size) {
+        mem_tags_free(buf);
+        return ESP_FAIL;
+    }
+    *out = buf;
+    *out_len = got;
+    return ESP_OK;
+}
+
+static void release_source(photo_cache_entry_t *original, uint8_t *src){
+    if (original) {
+        photo_cache_release(original);
+    } else {
+        mem_tags_free(src);
+    }
+}
+
+/**
+ * @brief Decode a JPEG at reduced scale and re-encode it
+ *
+ * @param filepath Path of the original JPEG
+ * @param id Photo identifier, used to find a cached original
+ * @param scale Scale denominator (2, 4 or 8)
+ * @param out Receives the encoded JPEG (free to release)
+ * @param out_len Receives the encoded length
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+static esp_err_t scale_file(const char *filepath, const char *id, int scale, uint8_t **out, size_t *out_len){
+    uint8_t *src = NULL;
+    size_t src_len = 0;
+    esp_err_t err = ESP_OK;
+    /* Prefer the original the recorder left in the cache over an SD read */
+    photo_cache_entry_t *original = photo_cache_get(id, 1);
+    if (original) {
+        src = (uint8_t *)photo_cache_entry_data(original);
+        src_len = photo_cache_entry_len(original);
+    } else {
+        err = read_file_psram(filepath, &src, &src_len);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    esp_jpeg_image_cfg_t cfg = {
+        .indata = src,
+        .indata_size = src_len,
+        .out_format = JPEG_IMAGE_FORMAT_RGB565,
+        .out_scale = scale == 2 ? JPEG_IMAGE_SCALE_1_2 : scale == 4 ? JPEG_IMAGE_SCALE_1_4 : JPEG_IMAGE_SCALE_1_8,
+        /* img_converters expects big-endian RGB565 like the sensor produces */
+        .flags = { .swap_color_bytes = 1 },
+    };
+    esp_jpeg_image_output_t info = {0};
+    err = esp_jpeg_get_image_info(&cfg, &info);
+    if (err != ESP_OK || info.width == 0 || info.height == 0) {
+        release_source(original, src);
+        return err != ESP_OK ? err : ESP_FAIL;
+    }
+
+    /* Allocate for the rounded-up scaled size; the encoder uses the truncated one */
+    uint16_t w = info.width / scale;
+    uint16_t h = info.height / scale;
+    size_t rgb_len = (size_t)((info.width + scale - 1) / scale) * ((info.height + scale - 1) / scale) * 2;
+    uint8_t *rgb = mem_tags_alloc(MEM_TAG_SCALER, rgb_len);
+    if (!rgb) {
+        release_source(original, src);
+        return ESP_ERR_NO_MEM;
+    }
+    cfg.outbuf = rgb;
+    cfg.outbuf_size = rgb_len;
+
+    TRACE_BEGIN("scale_decode");
+    err = esp_jpeg_decode(&cfg, &info);
+    TRACE_END("scale_decode");
+    release_source(original, src);
+    if (err != ESP_OK) {
+        mem_tags_free(rgb);
+        return err;
+    }
+
+    TRACE_BEGIN("scale_encode");
+    bool ok = fmt2jpg(rgb, (size_t)w * h * 2, w, h, PIXFORMAT_RGB565, PHOTO_SCALE_JPEG_QUALITY, out, out_len);
+    TRACE_END("scale_encode");
+    mem_tags_free(rgb);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Process one job: scale, cache and reply, then release the async request
+ *
+ * @param job Job to process
+ */
+static void handle_job(scale_job_t *job){
+    uint8_t *jpg = NULL;
+    size_t jpg_len = 0;
+    esp_err_t err = scale_file(job->filepath, job->id, job->scale, &jpg, &jpg_len);
+    if (err == ESP_OK) {
+        photo_cache_put(job->id, job->scale, jpg, jpg_len);
+        send_jpeg(job->req, jpg, jpg_len);
+        free(jpg);
+        record_latency(false, job->start_us);
+    } else {
+        ESP_LOGW(TAG, "Scaling %s 1/%d failed: %s", job->id, job->scale, esp_err_to_name(err));
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.failures++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        if (err == ESP_ERR_NOT_FOUND) {
+            httpd_resp_send_err(job->req, HTTPD_404_NOT_FOUND, "Photo not found");
+        } else {
+            httpd_resp_send_err(job->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to scale photo");
+        }
+    }
+    httpd_req_async_handler_complete(job->req);
+}
+
+/**
+ * @brief Scaler worker task
+ *
+ * @param arg
+ */
+static void scaler_worker_task(void *arg){
+    (void)arg;
+    scale_job_t job;
+    for (;;) {
+        if (xQueueReceive(s_job_queue, &job, portMAX_DELAY) == pdTRUE) {
+            handle_job(&job);
+        }
+    }
+}
+
+/**
+ * @brief Start the scaler worker
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t photo_scaler_start(void){
+    if (s_job_queue) return ESP_OK;
+    s_job_queue = xQueueCreate(SCALER_QUEUE_LEN, sizeof(scale_job_t));
+    if (!s_job_queue) {
+        ESP_LOGE(TAG, "Failed to create scaler queue");
+        return ESP_ERR_NO_MEM;
+    }
+    if (task_plan_create(TASK_PLAN_SCALER, scaler_worker_task, NULL, NULL) != ESP_OK) {
+        vQueueDelete(s_job_queue);
+        s_job_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool photo_scaler_scale_supported(int scale){
+    return scale == 2 || scale == 4 || scale == 8;
+}
+
+/**
+ * @brief Serve a variant straight from the cache
+ *
+ * @param req HTTP request
+ * @param id Photo identifier (file name)
+ * @param scale Scale denominator
+ * @return esp_err_t ESP_OK when served, ESP_ERR_NOT_FOUND on a miss
+ */
+esp_err_t photo_scaler_serve_cached(httpd_req_t *req, const char *id, int scale){
+    int64_t start_us = esp_timer_get_time();
+    photo_cache_entry_t *e = photo_cache_get(id, scale);
+    if (!e) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t err = send_jpeg(req, photo_cache_entry_data(e), photo_cache_entry_len(e));
+    photo_cache_release(e);
+    record_latency(true, start_us);
+    return err;
+}
+
+/**
+ * @brief Queue a scale request; the worker completes the HTTP response
+ *
+ * @param req HTTP request (handler returns right after this call)
+ * @param filepath Path of the original JPEG
+ * @param id Photo identifier (file name) used as cache key
+ * @param scale Scale denominator
+ * @return esp_err_t ESP_OK when queued, error code otherwise (req is untouched)
+ */
+esp_err_t photo_scaler_submit(httpd_req_t *req, const char *filepath, const char *id, int scale){
+    if (!s_job_queue) return ESP_ERR_INVALID_STATE;
+    if (strlen(filepath) >= SCALER_PATH_MAX || strlen(id) >= PHOTO_CACHE_ID_MAX) return ESP_ERR_INVALID_SIZE;
+    /* httpd is the only producer, so a free slot seen here is still free below */
+    if (uxQueueSpacesAvailable(s_job_queue) == 0) return ESP_ERR_NO_MEM;
+
+    scale_job_t job = {
+        .scale = scale,
+        .start_us = esp_timer_get_time(),
+    };
+    strlcpy(job.filepath, filepath, sizeof(job.filepath));
+    strlcpy(job.id, id, sizeof(job.id));
+    esp_err_t err = httpd_req_async_handler_begin(req, &job.req);
+    if (err != ESP_OK) {
+        return err;
+    }
+    xQueueSend(s_job_queue, &job, portMAX_DELAY);
+    return ESP_OK;
+}
+
+/**
+ * @brief Copy the scaler counters
+ *
+ * @param out Destination
+ */
+void photo_scaler_get_stats(photo_scaler_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* JPEG quality used when re-encoding scaled variants (1-100, higher is better) */
+#ifndef PHOTO_SCALE_JPEG_QUALITY
+#define PHOTO_SCALE_JPEG_QUALITY 60
+#endif
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t failures;
+    uint64_t hit_us_total;
+    uint32_t hit_us_max;
+    uint64_t miss_us_total;
+    uint32_t miss_us_max;
+} photo_scaler_stats_t;
+
+// Start the scaler worker task. Safe to call more than once.
+esp_err_t photo_scaler_start(void);
+
+// True for the scale denominators the decoder supports (2, 4, 8)
+bool photo_scaler_scale_supported(int scale);
+
+// Serve a cached variant from the calling task. Returns ESP_ERR_NOT_FOUND on a cache miss.
+esp_err_t photo_scaler_serve_cached(httpd_req_t *req, const char *id, int scale);
+
+// Hand the request to the worker which scales `filepath`, caches and sends the result.
+esp_err_t photo_scaler_submit(httpd_req_t *req, const char *filepath, const char *id, int scale);
+
+// Snapshot of scaler latency counters
+void photo_scaler_get_stats(photo_scaler_stats_t *out);
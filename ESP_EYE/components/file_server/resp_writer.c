@@ -0,0 +1,293 @@
+/**
+ * @file resp_writer.c
+ * @author xholanp00
+ * @brief JSON/CBOR streaming encoder for list, histogram and metrics responses
+ *
+ * CBOR drops the quoting, separators and decimal digits of JSON: a file size
+ * is 5 bytes instead of up to 10 characters, and keys cost their length plus
+ * one byte. Containers use the indefinite-length form so a handler can stream
+ * a listing without knowing how many entries it has.
+ */
+
+#include "resp_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/* CBOR initial bytes */
+#define CBOR_UINT 0x00
+#define CBOR_NEGINT 0x20
+#define CBOR_TEXT 0x60
+#define CBOR_ARRAY_INDEF 0x9F
+#define CBOR_MAP_INDEF 0xBF
+#define CBOR_FALSE 0xF4
+#define CBOR_TRUE 0xF5
+#define CBOR_NULL 0xF6
+#define CBOR_FLOAT32 0xFA
+#define CBOR_BREAK 0xFF
+
+static resp_writer_stats_t s_stats[RESP_FORMAT_COUNT];
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void flush(resp_writer_t *w){
+    if (w->len == 0 || w->err != ESP_OK) {
+        w->len = 0;
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    w->err = httpd_resp_send_chunk(w->req, (const char *)w->buf, w->len);
+    w->send_us += esp_timer_get_time() - t0;
+    w->total += w->len;
+    w->len = 0;
+}
+
+static void put(resp_writer_t *w, const void *data, size_t n){
+    const uint8_t *p = data;
+    while (n > 0) {
+        if (w->len == sizeof(w->buf)) flush(w);
+        size_t k = sizeof(w->buf) - w->len;
+        if (k > n) k = n;
+        memcpy(w->buf + w->len, p, k);
+        w->len += k;
+        p += k;
+        n -= k;
+    }
+}
+
+static void put_byte(resp_writer_t *w, uint8_t b){
+    put(w, &b, 1);
+}
+
+/* CBOR head: major type and argument in the shortest form */
+static void cbor_head(resp_writer_t *w, uint8_t major, uint64_t v){
+    uint8_t b[9];
+    size_t n;
+    if (v < 24) {
+        b[0] = major | (uint8_t)v;
+        n = 1;
+    } else if (v <= UINT8_MAX) {
+        b[0] = major | 24;
+        b[1] = (uint8_t)v;
+        n = 2;
+    } else if (v <= UINT16_MAX) {
+        b[0] = major | 25;
+        b[1] = (uint8_t)(v >> 8);
+        b[2] = (uint8_t)v;
+        n = 3;
+    } else if (v <= UINT32_MAX) {
+        b[0] = major | 26;
+        for (int i = 0; i < 4; i++) b[1 + i] = (uint8_t)(v >> (24 - 8 * i));
+        n = 5;
+    } else {
+        b[0] = major | 27;
+        for (int i = 0; i < 8; i++) b[1 + i] = (uint8_t)(v >> (56 - 8 * i));
+        n = 9;
+    }
+    put(w, b, n);
+}
+
+/* JSON separator before an item: a comma unless it is the first at its level
+   or the value of a key that was just written */
+static void json_sep(resp_writer_t *w){
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth == 0) return;
+    if (w->empty[w->depth - 1]) {
+        w->empty[w->depth - 1] = 0;
+    } else {
+        put_byte(w, ',');
+    }
+}
+
+static void json_text(resp_writer_t *w, const char *s){
+    put_byte(w, '"');
+    for (const char *p = s; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            char esc[2] = { '\\', (char)c };
+            put(w, esc, 2);
+        } else if (c < 0x20) {
+            char esc[8];
+            int n = snprintf(esc, sizeof(esc), "\\u%04x", c);
+            put(w, esc, n);
+        } else {
+            put_byte(w, c);
+        }
+    }
+    put_byte(w, '"');
+}
+
+resp_format_t resp_writer_negotiate(httpd_req_t *req){
+    char accept[96];
+    if (httpd_req_get_hdr_value_str(req, "Accept", accept, sizeof(accept)) == ESP_OK &&
+        strstr(accept, "application/cbor")) {
+        return RESP_FORMAT_CBOR;
+    }
+    return RESP_FORMAT_JSON;
+}
+
+void resp_writer_begin(resp_writer_t *w, httpd_req_t *req, resp_format_t format){
+    memset(w, 0, sizeof(*w) - sizeof(w->buf));
+    w->req = req;
+    w->format = format;
+    w->err = ESP_OK;
+    w->start_us = esp_timer_get_time();
+    httpd_resp_set_type(req, format == RESP_FORMAT_CBOR ? "application/cbor" : "application/json");
+    /* The same URL answers in two formats; caches must key on Accept */
+    httpd_resp_set_hdr(req, "Vary", "Accept");
+}
+
+static void open_container(resp_writer_t *w, bool map){
+    if (w->format == RESP_FORMAT_CBOR) {
+        put_byte(w, map ? CBOR_MAP_INDEF : CBOR_ARRAY_INDEF);
+    } else {
+        json_sep(w);
+        put_byte(w, map ? '{' : '[');
+    }
+    if (w->depth < RESP_WRITER_DEPTH_MAX) {
+        w->is_map[w->depth] = map;
+        w->empty[w->depth] = 1;
+    }
+    w->depth++;
+}
+
+void resp_writer_map(resp_writer_t *w){
+    open_container(w, true);
+}
+
+void resp_writer_array(resp_writer_t *w){
+    open_container(w, false);
+}
+
+void resp_writer_end(resp_writer_t *w){
+    if (w->depth == 0) return;
+    w->depth--;
+    if (w->format == RESP_FORMAT_CBOR) {
+        put_byte(w, CBOR_BREAK);
+    } else {
+        put_byte(w, w->depth < RESP_WRITER_DEPTH_MAX && w->is_map[w->depth] ? '}' : ']');
+    }
+}
+
+void resp_writer_key(resp_writer_t *w, const char *key){
+    if (w->format == RESP_FORMAT_CBOR) {
+        size_t n = strlen(key);
+        cbor_head(w, CBOR_TEXT, n);
+        put(w, key, n);
+        return;
+    }
+    json_sep(w);
+    json_text(w, key);
+    put_byte(w, ':');
+    w->after_key = true;
+}
+
+void resp_writer_uint(resp_writer_t *w, uint64_t v){
+    if (w->format == RESP_FORMAT_CBOR) {
+        cbor_head(w, CBOR_UINT, v);
+        return;
+    }
+    char num[24];
+    json_sep(w);
+    put(w, num, snprintf(num, sizeof(num), "%llu", (unsigned long long)v));
+}
+
+void resp_writer_int(resp_writer_t *w, int64_t v){
+    if (w->format == RESP_FORMAT_CBOR) {
+        if (v < 0) cbor_head(w, CBOR_NEGINT, (uint64_t)(-1 - v));
+        else cbor_head(w, CBOR_UINT, (uint64_t)v);
+        return;
+    }
+    char num[24];
+    json_sep(w);
+    put(w, num, snprintf(num, sizeof(num), "%lld", (long long)v));
+}
+
+void resp_writer_bool(resp_writer_t *w, bool v){
+    if (w->format == RESP_FORMAT_CBOR) {
+        put_byte(w, v ? CBOR_TRUE : CBOR_FALSE);
+        return;
+    }
+    json_sep(w);
+    put(w, v ? "true" : "false", v ? 4 : 5);
+}
+
+void resp_writer_null(resp_writer_t *w){
+    if (w->format == RESP_FORMAT_CBOR) {
+        put_byte(w, CBOR_NULL);
+        return;
+    }
+    json_sep(w);
+    put(w, "null", 4);
+}
+
+void resp_writer_str(resp_writer_t *w, const char *s){
+    if (!s) s = "";
+    if (w->format == RESP_FORMAT_CBOR) {
+        size_t n = strlen(s);
+        cbor_head(w, CBOR_TEXT, n);
+        put(w, s, n);
+        return;
+    }
+    json_sep(w);
+    json_text(w, s);
+}
+
+void resp_writer_tenths(resp_writer_t *w, uint32_t tenths){
+    if (w->format == RESP_FORMAT_CBOR) {
+        float f = tenths / 10.0f;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        uint8_t b[5] = { CBOR_FLOAT32, (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits };
+        put(w, b, sizeof(b));
+        return;
+    }
+    char num[16];
+    json_sep(w);
+    put(w, num, snprintf(num, sizeof(num), "%lu.%lu", (unsigned long)(tenths / 10), (unsigned long)(tenths % 10)));
+}
+
+void resp_writer_kv_uint(resp_writer_t *w, const char *key, uint64_t v){
+    resp_writer_key(w, key);
+    resp_writer_uint(w, v);
+}
+
+void resp_writer_kv_int(resp_writer_t *w, const char *key, int64_t v){
+    resp_writer_key(w, key);
+    resp_writer_int(w, v);
+}
+
+void resp_writer_kv_bool(resp_writer_t *w, const char *key, bool v){
+    resp_writer_key(w, key);
+    resp_writer_bool(w, v);
+}
+
+void resp_writer_kv_str(resp_writer_t *w, const char *key, const char *s){
+    resp_writer_key(w, key);
+    resp_writer_str(w, s);
+}
+
+esp_err_t resp_writer_finish(resp_writer_t *w){
+    flush(w);
+    if (w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, NULL, 0);
+    }
+    uint64_t build_us = (uint64_t)(esp_timer_get_time() - w->start_us - w->send_us);
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats[w->format].responses++;
+    s_stats[w->format].bytes += w->total;
+    s_stats[w->format].build_us += build_us;
+    portEXIT_CRITICAL(&s_stats_lock);
+    return w->err;
+}
+
+void resp_writer_get_stats(resp_writer_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_stats_lock);
+    memcpy(out, s_stats, sizeof(s_stats));
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bytes gathered before a chunk is sent */
+#ifndef RESP_WRITER_BUF
+#define RESP_WRITER_BUF 256
+#endif
+
+/* Deepest nesting of maps and arrays */
+#define RESP_WRITER_DEPTH_MAX 8
+
+typedef enum {
+    RESP_FORMAT_JSON = 0,
+    RESP_FORMAT_CBOR,           // RFC 8949, containers of indefinite length
+    RESP_FORMAT_COUNT
+} resp_format_t;
+
+/**
+ * Streaming encoder for structured responses. Handlers describe the document
+ * once (maps, arrays, keys, values) and it is written as JSON or CBOR, as the
+ * client's Accept header asked, in chunks of RESP_WRITER_BUF bytes.
+ */
+typedef struct {
+    httpd_req_t *req;
+    resp_format_t format;
+    esp_err_t err;              // first send error; later calls do nothing
+    uint8_t depth;
+    uint8_t is_map[RESP_WRITER_DEPTH_MAX];
+    uint8_t empty[RESP_WRITER_DEPTH_MAX];   // no item written yet at this level
+    bool after_key;
+    size_t len;
+    size_t total;
+    int64_t start_us;
+    int64_t send_us;            // time spent in httpd sends
+    uint8_t buf[RESP_WRITER_BUF];   // last: resp_writer_begin() does not clear it
+} resp_writer_t;
+
+typedef struct {
+    uint32_t responses;
+    uint64_t bytes;
+    uint64_t build_us;          // handler time outside httpd sends
+} resp_writer_stats_t;
+
+// Format asked for by the request's Accept header (CBOR only when listed)
+resp_format_t resp_writer_negotiate(httpd_req_t *req);
+
+// Set the content type and start a chunked response
+void resp_writer_begin(resp_writer_t *w, httpd_req_t *req, resp_format_t format);
+
+// Open a map or array; close it with resp_writer_end()
+void resp_writer_map(resp_writer_t *w);
+void resp_writer_array(resp_writer_t *w);
+void resp_writer_end(resp_writer_t *w);
+
+// Key of the next map entry
+void resp_writer_key(resp_writer_t *w, const char *key);
+
+void resp_writer_uint(resp_writer_t *w, uint64_t v);
+void resp_writer_int(resp_writer_t *w, int64_t v);
+void resp_writer_bool(resp_writer_t *w, bool v);
+void resp_writer_null(resp_writer_t *w);
+void resp_writer_str(resp_writer_t *w, const char *s);
+
+// Number with one decimal, given in tenths (JSON 12.5, CBOR float32)
+void resp_writer_tenths(resp_writer_t *w, uint32_t tenths);
+
+// Key and value in one call
+void resp_writer_kv_uint(resp_writer_t *w, const char *key, uint64_t v);
+void resp_writer_kv_int(resp_writer_t *w, const char *key, int64_t v);
+void resp_writer_kv_bool(resp_writer_t *w, const char *key, bool v);
+void resp_writer_kv_str(resp_writer_t *w, const char *key, const char *s);
+
+// Send what is left, end the chunked response and count it in the stats
+esp_err_t resp_writer_finish(resp_writer_t *w);
+
+// Copy the per-format counters into `out` (RESP_FORMAT_COUNT entries)
+void resp_writer_get_stats(resp_writer_stats_t *out);
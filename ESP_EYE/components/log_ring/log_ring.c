@@ -0,0 +1,180 @@
+/**
+ * @file log_ring.c
+ * @author xholanp00
+ * @brief ESP_LOG backend that formats into a RAM ring drained to the console by a task
+ *
+ * Writers format on their own stack, claim a line with a compare-and-swap of
+ * the head (refused while the console has not drained that slot yet), fill
+ * it and publish it by storing the line sequence number last. The drain task
+ * is the only one moving the drained index. Readers of the history copy a
+ * line and keep it only if its sequence number is the expected one before
+ * and after the copy.
+ */
+
+#include "log_ring.h"
+
+#include <string.h>
+
+#if CONFIG_LOG_RING_ENABLE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mem_tags.h"
+#include "task_plan.h"
+
+static const char *TAG = "log_ring"; // Tag for logging
+
+#define RING_LINES CONFIG_LOG_RING_LINES
+#define RING_MASK (RING_LINES - 1)
+/* Drain task poll period while the ring is empty */
+#define DRAIN_IDLE_MS 20
+
+_Static_assert((RING_LINES & RING_MASK) == 0, "LOG_RING_LINES must be a power of two");
+
+static log_ring_line_t *s_lines = NULL;
+static uint32_t s_head = 0;       // next line number to hand out
+static uint32_t s_drained = 0;    // next line number for the console
+static uint32_t s_dropped = 0;
+static vprintf_like_t s_console = NULL;
+
+/**
+ * @brief vprintf replacement installed with esp_log_set_vprintf()
+ *
+ * @param fmt Format string
+ * @param args Arguments
+ * @return int Formatted length, as vprintf would return
+ */
+static int ring_vprintf(const char *fmt, va_list args){
+    char text[LOG_RING_LINE_MAX];
+    int len = vsnprintf(text, sizeof(text), fmt, args);
+    if (len <= 0) return len;
+    size_t n = (size_t)len < sizeof(text) ? (size_t)len : sizeof(text) - 1;
+    if ((size_t)len > n) text[n - 1] = '\n';   // cut lines still end the line
+
+    uint32_t seq = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    do {
+        if (seq - __atomic_load_n(&s_drained, __ATOMIC_ACQUIRE) >= RING_LINES) {
+            __atomic_fetch_add(&s_dropped, 1, __ATOMIC_RELAXED);
+            return len;
+        }
+    } while (!__atomic_compare_exchange_n(&s_head, &seq, seq + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    log_ring_line_t *l = &s_lines[seq & RING_MASK];
+    __atomic_store_n(&l->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(l->text, text, n);
+    l->text[n] = '\0';
+    l->len = n;
+    __atomic_store_n(&l->seq, seq + 1, __ATOMIC_RELEASE);
+    return len;
+}
+
+static void console_write(const char *fmt, ...){
+    va_list args;
+    va_start(args, fmt);
+    s_console(fmt, args);
+    va_end(args);
+}
+
+/**
+ * @brief Write published lines to the console in order
+ *
+ * @param arg Unused
+ */
+static void drain_task(void *arg){
+    (void)arg;
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&s_drained, __ATOMIC_RELAXED);
+        const log_ring_line_t *l = &s_lines[seq & RING_MASK];
+        if (seq == __atomic_load_n(&s_head, __ATOMIC_ACQUIRE) ||
+            __atomic_load_n(&l->seq, __ATOMIC_ACQUIRE) != seq + 1) {
+            /* Empty, or the next line is still being written */
+            fflush(stdout);
+            vTaskDelay(pdMS_TO_TICKS(DRAIN_IDLE_MS));
+            continue;
+        }
+        console_write("%.*s", (int)l->len, l->text);
+        __atomic_store_n(&s_drained, seq + 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Allocate the ring, start the drain task and install the log backend
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t log_ring_init(void){
+    if (s_lines) return ESP_OK;
+    s_lines = mem_tags_calloc(MEM_TAG_LOG_RING, RING_LINES, sizeof(log_ring_line_t));
+    if (!s_lines) {
+        ESP_LOGE(TAG, "Failed to allocate log ring");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = task_plan_create(TASK_PLAN_LOG_DRAIN, drain_task, NULL, NULL);
+    if (err != ESP_OK) {
+        mem_tags_free(s_lines);
+        s_lines = NULL;
+        return err;
+    }
+    s_console = esp_log_set_vprintf(ring_vprintf);
+    ESP_LOGI(TAG, "Logging through a %d line ring", RING_LINES);
+    return ESP_OK;
+}
+
+/**
+ * @brief Copy completed lines
+ *
+ * @param cursor In: first line number wanted (0 = oldest kept); out: where to continue
+ * @param out Destination
+ * @param max Capacity of `out`
+ * @return size_t Number of lines copied (0 when caught up)
+ */
+size_t log_ring_read(uint32_t *cursor, log_ring_line_t *out, size_t max){
+    if (!cursor || !out || !s_lines) return 0;
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    uint32_t oldest = head > RING_LINES ? head - RING_LINES : 0;
+    uint32_t seq = *cursor < oldest ? oldest : *cursor;
+    size_t n = 0;
+    for (; seq < head && n < max; seq++) {
+        const log_ring_line_t *l = &s_lines[seq & RING_MASK];
+        if (__atomic_load_n(&l->seq, __ATOMIC_ACQUIRE) != seq + 1) continue;   // in progress or reused
+        out[n] = *l;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&l->seq, __ATOMIC_RELAXED) != seq + 1) continue;
+        if (out[n].len >= LOG_RING_LINE_MAX) out[n].len = LOG_RING_LINE_MAX - 1;
+        out[n].text[out[n].len] = '\0';
+        n++;
+    }
+    *cursor = seq;
+    return n;
+}
+
+void log_ring_get_stats(log_ring_stats_t *out){
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    out->enabled = s_lines != NULL;
+    out->lines = RING_LINES;
+    out->written = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    out->drained = __atomic_load_n(&s_drained, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&s_dropped, __ATOMIC_RELAXED);
+}
+
+#else
+
+esp_err_t log_ring_init(void){
+    return ESP_OK;
+}
+
+size_t log_ring_read(uint32_t *cursor, log_ring_line_t *out, size_t max){
+    (void)cursor; (void)out; (void)max;
+    return 0;
+}
+
+void log_ring_get_stats(log_ring_stats_t *out){
+    if (out) memset(out, 0, sizeof(*out));
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+/* Bytes of text kept per line (incl. terminator); longer lines are cut */
+#define LOG_RING_LINE_MAX 120
+
+typedef struct {
+    uint32_t seq;                   // line number + 1 once complete, 0 while written
+    uint16_t len;
+    char text[LOG_RING_LINE_MAX];
+} log_ring_line_t;
+
+typedef struct {
+    bool enabled;
+    uint32_t lines;                 // ring capacity
+    uint32_t written;               // lines accepted into the ring
+    uint32_t drained;               // lines written to the console
+    uint32_t dropped;               // lines lost because the ring was full
+} log_ring_stats_t;
+
+// Allocate the ring, start the drain task and route ESP_LOG output through it.
+// Does nothing when CONFIG_LOG_RING_ENABLE is off.
+esp_err_t log_ring_init(void);
+
+// Copy completed lines starting at *cursor (0 = oldest kept). Advances *cursor.
+size_t log_ring_read(uint32_t *cursor, log_ring_line_t *out, size_t max);
+
+// Snapshot of ring counters
+void log_ring_get_stats(log_ring_stats_t *out);
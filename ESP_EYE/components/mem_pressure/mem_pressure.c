@@ -0,0 +1,226 @@
+/**
+ * @file mem_pressure.c
+ * @author xholanp00
+ * @brief Heap watermarks that switch the camera node into staged degradation
+ *
+ * Instead of letting allocations fail one by one, the node gives memory back
+ * in a fixed order as the heap fills up: smaller stream frames, then no
+ * stream, then a smaller photo cache, then lower-quality captures. Levels go
+ * up as soon as a watermark is crossed and come down one step at a time once
+ * memory has stayed comfortably above it.
+ *
+ * There is no timer: the level is re-evaluated by whoever asks for it (the
+ * streamer per frame, the recorder per capture, /metrics). An idle node
+ * allocates nothing, so nothing can change while nobody asks.
+ */
+
+#include "mem_pressure.h"
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#include "mem_tags.h"
+#include "photo_cache.h"
+#include "settings.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#endif
+
+static const char *TAG = "mem_pressure"; // Tag for logging
+
+#define WATERMARKS (MEM_PRESSURE_LEVEL_COUNT - 1)
+
+static const uint32_t s_internal_marks[WATERMARKS] = MEM_PRESSURE_INTERNAL_WATERMARKS;
+static const uint32_t s_psram_marks[WATERMARKS] = MEM_PRESSURE_PSRAM_WATERMARKS;
+
+static const char *const s_names[MEM_PRESSURE_LEVEL_COUNT] = {
+    [MEM_PRESSURE_NONE] = "none",
+    [MEM_PRESSURE_STREAM_SMALL] = "stream_small",
+    [MEM_PRESSURE_STREAM_OFF] = "stream_off",
+    [MEM_PRESSURE_CACHE_SHRUNK] = "cache_shrunk",
+    [MEM_PRESSURE_CAPTURE_LOW] = "capture_low",
+};
+
+static mem_pressure_level_t s_level = MEM_PRESSURE_NONE;
+static int64_t s_level_since_us = 0;
+static int64_t s_checked_us = 0;
+static int64_t s_calm_since_us = 0;        // memory above the hysteresis band since
+static bool s_busy = false;                // an evaluation is running
+static size_t s_cache_capacity = 0;        // photo cache budget before it was cut
+static mem_pressure_stats_t s_stats = {0};
+static mem_pressure_event_t s_events[MEM_PRESSURE_EVENTS];
+static uint32_t s_event_count = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Level a free-memory figure corresponds to
+ *
+ * @param marks Watermarks, decreasing
+ * @param value Free bytes
+ * @param pct Extra margin in percent (hysteresis)
+ * @return int Number of watermarks `value` is below
+ */
+static int level_for(const uint32_t *marks, size_t value, int pct){
+    int level = 0;
+    for (int i = 0; i < WATERMARKS; i++) {
+        if (value < (uint64_t)marks[i] * (100 + pct) / 100) level = i + 1;
+    }
+    return level;
+}
+
+static bool psram_present(void){
+#if CONFIG_IDF_TARGET_LINUX
+    return false;
+#else
+    return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+#endif
+}
+
+/**
+ * @brief Cut the photo cache on entering the cache stage, restore it on leaving
+ *
+ * @param from Previous level
+ * @param to New level
+ */
+static void apply_cache(mem_pressure_level_t from, mem_pressure_level_t to){
+    bool was = from >= MEM_PRESSURE_CACHE_SHRUNK;
+    bool is = to >= MEM_PRESSURE_CACHE_SHRUNK;
+    if (was == is) return;
+    if (is) {
+        photo_cache_stats_t cache;
+        photo_cache_get_stats(&cache);
+        s_cache_capacity = cache.capacity;
+        photo_cache_set_capacity(cache.capacity / MEM_PRESSURE_CACHE_DIVISOR);
+        mem_pressure_note(MEM_PRESSURE_CACHE_SHRUNK);
+    } else if (s_cache_capacity) {
+        photo_cache_set_capacity(s_cache_capacity);
+    }
+}
+
+/**
+ * @brief Read the heap and move the level. Only one caller runs this at a time.
+ *
+ * @param now esp_timer time
+ * @return mem_pressure_level_t Level after the evaluation
+ */
+static mem_pressure_level_t evaluate(int64_t now){
+    mem_heap_stats_t heap;
+    mem_tags_get_heap(&heap);
+
+    /* The host build reports no heap figures; only the floor setting applies */
+    int by_internal = 0, by_psram = 0, clear = 0;
+    if (heap.internal_free > 0) {
+        by_internal = level_for(s_internal_marks, heap.internal_free, 0);
+        clear = level_for(s_internal_marks, heap.internal_free, MEM_PRESSURE_HYSTERESIS_PCT);
+    }
+    if (psram_present()) {
+        by_psram = level_for(s_psram_marks, heap.psram_largest, 0);
+        clear = MAX(clear, level_for(s_psram_marks, heap.psram_largest, MEM_PRESSURE_HYSTERESIS_PCT));
+    }
+    int floor = settings_get(SETTING_MEM_PRESSURE_FLOOR);
+    int raw = MAX(MAX(by_internal, by_psram), floor);
+    clear = MAX(clear, floor);
+
+    mem_pressure_level_t from = s_level;
+    mem_pressure_level_t to = from;
+    const char *cause = NULL;
+    if (raw > (int)from) {
+        to = raw;
+        cause = raw == by_internal ? "internal" : raw == by_psram ? "psram" : "floor";
+        s_calm_since_us = 0;
+    } else if (clear < (int)from) {
+        if (!s_calm_since_us) {
+            s_calm_since_us = now;
+        } else if (now - s_calm_since_us >= (int64_t)MEM_PRESSURE_RECOVER_MS * 1000) {
+            to = from - 1;
+            cause = "eased";
+            s_calm_since_us = now;
+        }
+    } else {
+        s_calm_since_us = 0;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.evaluations++;
+    if (to != from) {
+        s_stats.level_ms[from] += (uint64_t)(now - s_level_since_us) / 1000;
+        s_level_since_us = now;
+        s_stats.entered[to]++;
+        if (to > from) s_stats.raised++; else s_stats.eased++;
+        s_events[s_event_count++ % MEM_PRESSURE_EVENTS] = (mem_pressure_event_t){
+            .at_ms = (uint32_t)(now / 1000),
+            .from = from,
+            .to = to,
+            .cause = cause,
+            .internal_free = heap.internal_free,
+            .psram_largest = heap.psram_largest,
+        };
+        s_level = to;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (to != from) {
+        apply_cache(from, to);
+        if (to > from) {
+            ESP_LOGW(TAG, "%s -> %s (%s; internal %u free, PSRAM block %u)", s_names[from], s_names[to], cause,
+                     (unsigned)heap.internal_free, (unsigned)heap.psram_largest);
+        } else {
+            ESP_LOGI(TAG, "%s -> %s (internal %u free, PSRAM block %u)", s_names[from], s_names[to],
+                     (unsigned)heap.internal_free, (unsigned)heap.psram_largest);
+        }
+    }
+    return to;
+}
+
+mem_pressure_level_t mem_pressure_level(void){
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    mem_pressure_level_t level = s_level;
+    bool due = !s_busy && (s_stats.evaluations == 0 || now - s_checked_us >= (int64_t)MEM_PRESSURE_POLL_MS * 1000);
+    if (due) {
+        s_busy = true;
+        s_checked_us = now;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!due) return level;
+
+    level = evaluate(now);
+    portENTER_CRITICAL(&s_lock);
+    s_busy = false;
+    portEXIT_CRITICAL(&s_lock);
+    return level;
+}
+
+void mem_pressure_note(mem_pressure_level_t stage){
+    if (stage >= MEM_PRESSURE_LEVEL_COUNT) return;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.applied[stage]++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+const char *mem_pressure_level_name(mem_pressure_level_t level){
+    return level < MEM_PRESSURE_LEVEL_COUNT ? s_names[level] : "unknown";
+}
+
+/**
+ * @brief Copy the level, counters and recent transitions
+ *
+ * @param out Destination
+ */
+void mem_pressure_get_stats(mem_pressure_stats_t *out){
+    if (!out) return;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    out->level = s_level;
+    out->level_ms[s_level] += (uint64_t)(now - s_level_since_us) / 1000;
+    uint32_t n = s_event_count < MEM_PRESSURE_EVENTS ? s_event_count : MEM_PRESSURE_EVENTS;
+    for (uint32_t i = 0; i < n; i++) {
+        out->events[i] = s_events[(s_event_count - n + i) % MEM_PRESSURE_EVENTS];
+    }
+    out->nevents = n;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Degradation stages, mildest first. Each level includes the ones below it. */
+typedef enum {
+    MEM_PRESSURE_NONE = 0,
+    MEM_PRESSURE_STREAM_SMALL,      // MJPEG frames at a smaller frame size
+    MEM_PRESSURE_STREAM_OFF,        // viewer dropped, new viewers refused
+    MEM_PRESSURE_CACHE_SHRUNK,      // photo cache cut to 1/MEM_PRESSURE_CACHE_DIVISOR
+    MEM_PRESSURE_CAPTURE_LOW,       // captures at a lower JPEG quality
+    MEM_PRESSURE_LEVEL_COUNT
+} mem_pressure_level_t;
+
+/* Watermarks per level (levels 1..4): internal RAM free bytes, and the largest
+   free PSRAM block, since a frame or cache entry needs one contiguous block */
+#ifndef MEM_PRESSURE_INTERNAL_WATERMARKS
+#define MEM_PRESSURE_INTERNAL_WATERMARKS { 72 * 1024, 60 * 1024, 48 * 1024, 36 * 1024 }
+#endif
+
+#ifndef MEM_PRESSURE_PSRAM_WATERMARKS
+#define MEM_PRESSURE_PSRAM_WATERMARKS { 1024 * 1024, 640 * 1024, 384 * 1024, 192 * 1024 }
+#endif
+
+/* A level is left only once memory is this many percent above its watermark... */
+#ifndef MEM_PRESSURE_HYSTERESIS_PCT
+#define MEM_PRESSURE_HYSTERESIS_PCT 25
+#endif
+
+/* ...and has stayed there this long; each step down waits again */
+#ifndef MEM_PRESSURE_RECOVER_MS
+#define MEM_PRESSURE_RECOVER_MS 10000
+#endif
+
+/* Heap figures are re-read at most this often */
+#ifndef MEM_PRESSURE_POLL_MS
+#define MEM_PRESSURE_POLL_MS 500
+#endif
+
+#ifndef MEM_PRESSURE_CACHE_DIVISOR
+#define MEM_PRESSURE_CACHE_DIVISOR 4
+#endif
+
+/* Transitions kept for /metrics */
+#define MEM_PRESSURE_EVENTS 8
+
+typedef struct {
+    uint32_t at_ms;                 // uptime of the transition
+    uint8_t from;
+    uint8_t to;
+    const char *cause;              // "internal", "psram", "floor" or "eased"
+    uint32_t internal_free;
+    uint32_t psram_largest;
+} mem_pressure_event_t;
+
+typedef struct {
+    mem_pressure_level_t level;
+    uint32_t raised;
+    uint32_t eased;
+    uint32_t entered[MEM_PRESSURE_LEVEL_COUNT];
+    uint32_t applied[MEM_PRESSURE_LEVEL_COUNT];   // degraded actions taken per stage
+    uint64_t level_ms[MEM_PRESSURE_LEVEL_COUNT];  // time spent at each level
+    uint32_t evaluations;
+    uint32_t nevents;               // valid entries in `events`, oldest first
+    mem_pressure_event_t events[MEM_PRESSURE_EVENTS];
+} mem_pressure_stats_t;
+
+// Current level. Re-evaluates the heap when the last look is older than MEM_PRESSURE_POLL_MS.
+mem_pressure_level_t mem_pressure_level(void);
+
+// Count one degraded action of a stage (e.g. a refused viewer)
+void mem_pressure_note(mem_pressure_level_t stage);
+
+// Name of a level as shown in /metrics and the log
+const char *mem_pressure_level_name(mem_pressure_level_t level);
+
+// Snapshot of the level, transition counters and recent transitions
+void mem_pressure_get_stats(mem_pressure_stats_t *out);
@@ -0,0 +1,188 @@
+/**
+ * @file mem_tags.c
+ * @author xholanp00
+ * @brief Tagged heap allocations with a fixed internal RAM / PSRAM placement per buffer class
+ *
+ * Every block carries a small header with its length, tag and region, so
+ * mem_tags_free() needs nothing but the pointer and the per-tag byte counters
+ * stay exact.
+ */
+
+#include "mem_tags.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "mem_tags"; // Tag for logging
+
+#define CAPS_PSRAM (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define CAPS_INTERNAL (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+#define MEM_HDR_MAGIC 0x7A6Du
+
+typedef struct {
+    uint32_t len;
+    uint8_t tag;
+    uint8_t internal;
+    uint16_t magic;
+} mem_hdr_t;
+
+typedef struct {
+    const char *name;
+    uint32_t caps;        // first choice
+    uint32_t fallback;    // second choice, 0 if the buffer must not move
+} mem_policy_t;
+
+/* Large or long-lived buffers go to PSRAM; only short request bodies may use
+   internal RAM, and only while the reserve stays intact. */
+static const mem_policy_t s_policy[MEM_TAG_COUNT] = {
+    [MEM_TAG_HTTP_SCRATCH] = { "http_scratch", CAPS_PSRAM, CAPS_INTERNAL },
+    [MEM_TAG_HTTP_BODY] = { "http_body", CAPS_INTERNAL, CAPS_PSRAM },
+    [MEM_TAG_PHOTO_CACHE] = { "photo_cache", CAPS_PSRAM, 0 },
+    [MEM_TAG_SCALER] = { "scaler", CAPS_PSRAM, 0 },
+    [MEM_TAG_PHASH] = { "phash", CAPS_PSRAM, CAPS_INTERNAL },
+    [MEM_TAG_LOG_RING] = { "log_ring", CAPS_PSRAM, CAPS_INTERNAL },
+    [MEM_TAG_STREAM] = { "stream", CAPS_PSRAM, 0 },
+};
+
+static mem_tag_stats_t s_stats[MEM_TAG_COUNT];
+static uint32_t s_reserve_diverts = 0;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Check that an internal allocation of `len` bytes leaves the reserve free
+ *
+ * @param len Requested length including the header
+ * @return true if the allocation may use internal RAM
+ */
+static bool internal_has_room(size_t len){
+#if CONFIG_IDF_TARGET_LINUX
+    (void)len;
+    return true;
+#else
+    return heap_caps_get_free_size(MALLOC_CAP_INTERNAL) >= len + MEM_TAGS_INTERNAL_RESERVE_BYTES;
+#endif
+}
+
+/**
+ * @brief Allocate from one region, honouring the internal RAM reserve
+ *
+ * @param caps Region capabilities
+ * @param len Length including the header
+ * @param diverted Set when internal RAM was skipped to keep the reserve
+ * @return mem_hdr_t* Block, or NULL
+ */
+static mem_hdr_t *alloc_in(uint32_t caps, size_t len, bool *diverted){
+    if ((caps & MALLOC_CAP_INTERNAL) && !internal_has_room(len)) {
+        *diverted = true;
+        return NULL;
+    }
+    return heap_caps_malloc(len, caps);
+}
+
+/**
+ * @brief Allocate a buffer placed according to its tag
+ *
+ * @param tag Buffer class
+ * @param len Requested length
+ * @return void* Buffer, or NULL when neither allowed region has room
+ */
+void *mem_tags_alloc(mem_tag_t tag, size_t len){
+    if (tag >= MEM_TAG_COUNT || len == 0 || len > UINT32_MAX - sizeof(mem_hdr_t)) return NULL;
+    const mem_policy_t *p = &s_policy[tag];
+    size_t total = sizeof(mem_hdr_t) + len;
+
+    bool diverted = false;
+    bool fallback = false;
+    uint32_t caps = p->caps;
+    mem_hdr_t *h = alloc_in(caps, total, &diverted);
+    if (!h && p->fallback) {
+        caps = p->fallback;
+        h = alloc_in(caps, total, &diverted);
+        fallback = h != NULL;
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    mem_tag_stats_t *st = &s_stats[tag];
+    if (diverted) s_reserve_diverts++;
+    if (h) {
+        bool internal = (caps & MALLOC_CAP_INTERNAL) != 0;
+        st->allocs++;
+        st->current += len;
+        if (internal) st->internal += len;
+        if (st->current > st->peak) st->peak = st->current;
+        if (fallback) st->fallbacks++;
+    } else {
+        st->failures++;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    if (!h) {
+        ESP_LOGW(TAG, "%s: no room for %u bytes", p->name, (unsigned)len);
+        return NULL;
+    }
+    h->len = len;
+    h->tag = tag;
+    h->internal = (caps & MALLOC_CAP_INTERNAL) != 0;
+    h->magic = MEM_HDR_MAGIC;
+    return h + 1;
+}
+
+void *mem_tags_calloc(mem_tag_t tag, size_t n, size_t size){
+    if (size && n > SIZE_MAX / size) return NULL;
+    void *ptr = mem_tags_alloc(tag, n * size);
+    if (ptr) memset(ptr, 0, n * size);
+    return ptr;
+}
+
+/**
+ * @brief Release a tagged buffer
+ *
+ * @param ptr Buffer from mem_tags_alloc()/mem_tags_calloc(), or NULL
+ */
+void mem_tags_free(void *ptr){
+    if (!ptr) return;
+    mem_hdr_t *h = (mem_hdr_t *)ptr - 1;
+    if (h->magic != MEM_HDR_MAGIC || h->tag >= MEM_TAG_COUNT) {
+        ESP_LOGE(TAG, "Freeing untagged or corrupted block %p", ptr);
+        abort();
+    }
+    portENTER_CRITICAL(&s_stats_lock);
+    mem_tag_stats_t *st = &s_stats[h->tag];
+    st->current -= h->len;
+    if (h->internal) st->internal -= h->len;
+    portEXIT_CRITICAL(&s_stats_lock);
+    h->magic = 0;
+    heap_caps_free(h);
+}
+
+void mem_tags_get_stats(mem_tag_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_stats_lock);
+    memcpy(out, s_stats, sizeof(s_stats));
+    portEXIT_CRITICAL(&s_stats_lock);
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+        out[i].name = s_policy[i].name;
+    }
+}
+
+void mem_tags_get_heap(mem_heap_stats_t *out){
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+#if !CONFIG_IDF_TARGET_LINUX
+    out->internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    out->internal_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    out->internal_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    out->psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    out->psram_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+    out->psram_largest = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+#endif
+    portENTER_CRITICAL(&s_stats_lock);
+    out->reserve_diverts = s_reserve_diverts;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Internal RAM kept free for Wi-Fi, lwIP and task stacks. Allocations that
+   prefer internal RAM go to their fallback region instead of dipping below it. */
+#ifndef MEM_TAGS_INTERNAL_RESERVE_BYTES
+#define MEM_TAGS_INTERNAL_RESERVE_BYTES (48 * 1024)
+#endif
+
+/* Buffer classes. Each has a fixed placement, see s_policy in mem_tags.c. */
+typedef enum {
+    MEM_TAG_HTTP_SCRATCH = 0,   // file download chunk buffer
+    MEM_TAG_HTTP_BODY,          // request bodies and small responses
+    MEM_TAG_PHOTO_CACHE,        // cached JPEG entries
+    MEM_TAG_SCALER,             // scaler source JPEG and RGB565 frame
+    MEM_TAG_PHASH,              // 1/8 scale decode for the perceptual hash
+    MEM_TAG_LOG_RING,           // buffered log lines
+    MEM_TAG_STREAM,             // copy of the frame being streamed
+    MEM_TAG_COUNT
+} mem_tag_t;
+
+typedef struct {
+    const char *name;
+    size_t current;             // bytes held now
+    size_t peak;                // highest `current` seen
+    size_t internal;            // part of `current` placed in internal RAM
+    uint32_t allocs;
+    uint32_t failures;
+    uint32_t fallbacks;         // served from the second-choice region
+} mem_tag_stats_t;
+
+typedef struct {
+    size_t internal_free;
+    size_t internal_min_free;   // low-water mark since boot
+    size_t internal_largest;    // largest free block
+    size_t psram_free;
+    size_t psram_min_free;
+    size_t psram_largest;
+    uint32_t reserve_diverts;   // internal placements skipped to keep the reserve
+} mem_heap_stats_t;
+
+// Allocate `len` bytes for a buffer class. Release with mem_tags_free().
+void *mem_tags_alloc(mem_tag_t tag, size_t len);
+
+// Zeroed allocation of `n` * `size` bytes for a buffer class
+void *mem_tags_calloc(mem_tag_t tag, size_t n, size_t size);
+
+// Release a buffer from mem_tags_alloc()/mem_tags_calloc(). NULL is ignored.
+void mem_tags_free(void *ptr);
+
+// Copy the counters of all tags into `out` (MEM_TAG_COUNT entries)
+void mem_tags_get_stats(mem_tag_stats_t *out);
+
+// Free/low-water/largest-block figures of internal RAM and PSRAM
+void mem_tags_get_heap(mem_heap_stats_t *out);
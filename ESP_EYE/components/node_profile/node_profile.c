@@ -0,0 +1,92 @@
+/**
+ * @file node_profile.c
+ * @author xholanp00
+ * @brief Firmware profile of the camera node and its boot timeline
+ *
+ * Some nodes only stream and others only take triggered photos. The profile
+ * chosen in menuconfig decides which subsystems are compiled in; this file
+ * reports that choice and how long the boot took, stage by stage, so
+ * profiles can be compared on the same board.
+ */
+
+#include "node_profile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "node_profile"; // Tag for logging
+
+#if CONFIG_NODE_PROFILE_STREAM_ONLY
+#define NODE_PROFILE_NAME "stream_only"
+#elif CONFIG_NODE_PROFILE_CAPTURE_ONLY
+#define NODE_PROFILE_NAME "capture_only"
+#elif CONFIG_NODE_PROFILE_CUSTOM
+#define NODE_PROFILE_NAME "custom"
+#else
+#define NODE_PROFILE_NAME "full"
+#endif
+
+static node_milestone_t s_milestones[NODE_PROFILE_MILESTONES];
+static uint32_t s_nmilestones = 0;
+static uint32_t s_ready_us = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void node_profile_mark(const char *stage){
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_nmilestones < NODE_PROFILE_MILESTONES) {
+        s_milestones[s_nmilestones++] = (node_milestone_t){ .name = stage, .at_us = now };
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Mark the node ready and log the boot time per stage
+ *
+ * Stage times are deltas from the previous milestone, so the log line reads
+ * as "where did the boot go" for the profile that is running.
+ */
+void node_profile_ready(void){
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    node_profile_mark("ready");
+    portENTER_CRITICAL(&s_lock);
+    s_ready_us = now;
+    portEXIT_CRITICAL(&s_lock);
+    node_profile_stats_t st;
+    node_profile_get_stats(&st);
+
+    char line[160];
+    size_t len = 0;
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i + 1 < st.nmilestones && len < sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, "%s%s %u", i ? ", " : "", st.milestones[i].name,
+                        (unsigned)((st.milestones[i].at_us - prev) / 1000));
+        prev = st.milestones[i].at_us;
+    }
+    if (len == 0) line[0] = '\0';
+    ESP_LOGI(TAG, "Profile %s ready in %u ms (%s)", st.profile, (unsigned)(st.ready_us / 1000), line);
+}
+
+/**
+ * @brief Copy the profile, compiled-in features and milestones
+ *
+ * @param out Destination
+ */
+void node_profile_get_stats(node_profile_stats_t *out){
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    out->profile = NODE_PROFILE_NAME;
+    if (NODE_HAS_CAPTURE) out->features[out->nfeatures++] = "capture";
+    if (NODE_HAS_SCALER) out->features[out->nfeatures++] = "scaler";
+    if (NODE_HAS_STREAM) out->features[out->nfeatures++] = "stream";
+    if (NODE_HAS_WEB_UI) out->features[out->nfeatures++] = "web_ui";
+    if (NODE_HAS_STUBS) out->features[out->nfeatures++] = "stubs";
+    portENTER_CRITICAL(&s_lock);
+    out->ready_us = s_ready_us;
+    out->nmilestones = s_nmilestones;
+    memcpy(out->milestones, s_milestones, s_nmilestones * sizeof(s_milestones[0]));
+    portEXIT_CRITICAL(&s_lock);
+}
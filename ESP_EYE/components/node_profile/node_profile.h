@@ -0,0 +1,66 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+/* Feature switches as 0/1, usable in plain `if` as well as `#if` */
+#ifdef CONFIG_NODE_FEATURE_CAPTURE
+#define NODE_HAS_CAPTURE 1
+#else
+#define NODE_HAS_CAPTURE 0
+#endif
+
+#ifdef CONFIG_NODE_FEATURE_SCALER
+#define NODE_HAS_SCALER 1
+#else
+#define NODE_HAS_SCALER 0
+#endif
+
+#ifdef CONFIG_NODE_FEATURE_STREAM
+#define NODE_HAS_STREAM 1
+#else
+#define NODE_HAS_STREAM 0
+#endif
+
+#ifdef CONFIG_NODE_FEATURE_WEB_UI
+#define NODE_HAS_WEB_UI 1
+#else
+#define NODE_HAS_WEB_UI 0
+#endif
+
+#ifdef CONFIG_NODE_FEATURE_STUB_HANDLERS
+#define NODE_HAS_STUBS 1
+#else
+#define NODE_HAS_STUBS 0
+#endif
+
+/* Boot milestones kept for /metrics */
+#define NODE_PROFILE_MILESTONES 10
+
+/* Compiled-in features listed in /metrics */
+#define NODE_PROFILE_FEATURES 5
+
+typedef struct {
+    const char *name;         // static string passed to node_profile_mark()
+    uint32_t at_us;           // esp_timer time
+} node_milestone_t;
+
+typedef struct {
+    const char *profile;      // "full", "stream_only", "capture_only" or "custom"
+    uint32_t nfeatures;
+    const char *features[NODE_PROFILE_FEATURES];
+    uint32_t ready_us;        // 0 until node_profile_ready()
+    uint32_t nmilestones;
+    node_milestone_t milestones[NODE_PROFILE_MILESTONES];
+} node_profile_stats_t;
+
+// Record that a boot stage finished. `stage` must outlive the program (a literal).
+void node_profile_mark(const char *stage);
+
+// Mark the node ready to serve and log the boot time with its stages
+void node_profile_ready(void);
+
+// Profile, features and boot milestones
+void node_profile_get_stats(node_profile_stats_t *out);
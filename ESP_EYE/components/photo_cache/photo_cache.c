@@ -0,0 +1,280 @@
+/**
+ * @file photo_cache.c
+ * @author xholanp00
+ * @brief Byte-bounded LRU cache of JPEG images kept in PSRAM
+ *
+ */
+
+#include "photo_cache.h"
+
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "mem_tags.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "photo_cache"; // Tag for logging
+
+struct photo_cache_entry {
+    struct photo_cache_entry *prev;
+    struct photo_cache_entry *next;
+    uint32_t refs;      // held by the list while linked, plus one per reader
+    bool linked;
+    int scale;
+    size_t len;
+    char id[PHOTO_CACHE_ID_MAX];
+    uint8_t data[];
+};
+
+// List head is the most recently used entry, tail the least recently used
+static photo_cache_entry_t *s_head = NULL;
+static photo_cache_entry_t *s_tail = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static photo_cache_stats_t s_stats = {0};
+
+static void unlink_entry(photo_cache_entry_t *e){
+    if (e->prev) e->prev->next = e->next; else s_head = e->next;
+    if (e->next) e->next->prev = e->prev; else s_tail = e->prev;
+    e->prev = e->next = NULL;
+    e->linked = false;
+    s_stats.entries--;
+    s_stats.bytes -= e->len;
+}
+
+static void push_front(photo_cache_entry_t *e){
+    e->prev = NULL;
+    e->next = s_head;
+    if (s_head) s_head->prev = e; else s_tail = e;
+    s_head = e;
+    e->linked = true;
+    s_stats.entries++;
+    s_stats.bytes += e->len;
+}
+
+/**
+ * @brief Drop one reference, freeing the entry once nobody holds it. Caller holds s_lock.
+ *
+ * @param e Entry
+ */
+static void unref_locked(photo_cache_entry_t *e){
+    if (--e->refs == 0) {
+        mem_tags_free(e);
+    }
+}
+
+/**
+ * @brief Unlink an entry from the LRU list and drop the list's reference. Caller holds s_lock.
+ *
+ * @param e Entry
+ */
+static void remove_locked(photo_cache_entry_t *e){
+    unlink_entry(e);
+    unref_locked(e);
+}
+
+static photo_cache_entry_t *find_locked(const char *id, int scale){
+    for (photo_cache_entry_t *e = s_head; e; e = e->next) {
+        if (e->scale == scale && strcmp(e->id, id) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Initialize the cache
+ *
+ * @param capacity_bytes Upper bound on cached image bytes
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t photo_cache_init(size_t capacity_bytes){
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        ESP_LOGE(TAG, "Failed to create cache lock");
+        return ESP_ERR_NO_MEM;
+    }
+    s_stats.capacity = capacity_bytes;
+    ESP_LOGI(TAG, "Photo cache ready (%u bytes)", (unsigned)capacity_bytes);
+    return ESP_OK;
+}
+
+/**
+ * @brief Change the byte budget
+ *
+ * Entries still held by readers stay alive until released; only the list's
+ * reference is dropped here.
+ *
+ * @param capacity_bytes New upper bound on cached image bytes
+ */
+void photo_cache_set_capacity(size_t capacity_bytes){
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.capacity = capacity_bytes;
+    while (s_tail && s_stats.bytes > s_stats.capacity) {
+        remove_locked(s_tail);
+        s_stats.evictions++;
+    }
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "Photo cache capacity %u bytes", (unsigned)capacity_bytes);
+}
+
+/**
+ * @brief Allocate an entry that the caller fills before committing it
+ *
+ * @param id Photo identifier (file name)
+ * @param scale Scale denominator (1 for the original image)
+ * @param len Image length
+ * @return photo_cache_entry_t* Reserved entry, or NULL if it cannot be cached
+ */
+photo_cache_entry_t *photo_cache_reserve(const char *id, int scale, size_t len){
+    if (!id || len == 0 || !s_lock) return NULL;
+    if (strlen(id) >= PHOTO_CACHE_ID_MAX || len > s_stats.capacity) return NULL;
+
+    photo_cache_entry_t *e = mem_tags_alloc(MEM_TAG_PHOTO_CACHE, sizeof(*e) + len);
+    if (!e) {
+        ESP_LOGW(TAG, "OOM caching %s (%u bytes)", id, (unsigned)len);
+        return NULL;
+    }
+    memset(e, 0, sizeof(*e));
+    strlcpy(e->id, id, sizeof(e->id));
+    e->scale = scale;
+    e->len = len;
+    e->refs = 1;
+    return e;
+}
+
+uint8_t *photo_cache_entry_buf(photo_cache_entry_t *entry){
+    return entry->data;
+}
+
+/**
+ * @brief Publish a reserved entry, replacing any entry with the same key
+ *
+ * @param entry Entry from photo_cache_reserve()
+ */
+void photo_cache_commit(photo_cache_entry_t *entry){
+    if (!entry) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    photo_cache_entry_t *old = find_locked(entry->id, entry->scale);
+    if (old) {
+        remove_locked(old);
+    }
+    while (s_tail && s_stats.bytes + entry->len > s_stats.capacity) {
+        remove_locked(s_tail);
+        s_stats.evictions++;
+    }
+    push_front(entry);
+    s_stats.insertions++;
+    xSemaphoreGive(s_lock);
+}
+
+void photo_cache_discard(photo_cache_entry_t *entry){
+    if (entry) {
+        mem_tags_free(entry);
+    }
+}
+
+/**
+ * @brief Insert a copy of an image into the cache
+ *
+ * @param id Photo identifier (file name)
+ * @param scale Scale denominator (1 for the original image)
+ * @param data Image bytes
+ * @param len Image length
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t photo_cache_put(const char *id, int scale, const uint8_t *data, size_t len){
+    if (!id || !data || len == 0) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+
+    /* Copy outside the lock so readers are not blocked behind a large memcpy */
+    photo_cache_entry_t *e = photo_cache_reserve(id, scale, len);
+    if (!e) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(e->data, data, len);
+    photo_cache_commit(e);
+    return ESP_OK;
+}
+
+/**
+ * @brief Look up a cached image and mark it most recently used
+ *
+ * @param id Photo identifier (file name)
+ * @param scale Scale denominator (1 for the original image)
+ * @return photo_cache_entry_t* Referenced entry, or NULL on miss
+ */
+photo_cache_entry_t *photo_cache_get(const char *id, int scale){
+    if (!id || !s_lock) return NULL;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    photo_cache_entry_t *e = find_locked(id, scale);
+    if (e) {
+        if (e != s_head) {
+            unlink_entry(e);
+            push_front(e);
+        }
+        e->refs++;
+        s_stats.hits++;
+    } else {
+        s_stats.misses++;
+    }
+    xSemaphoreGive(s_lock);
+    return e;
+}
+
+/**
+ * @brief Release a reference returned by photo_cache_get()
+ *
+ * @param entry Entry handle
+ */
+void photo_cache_release(photo_cache_entry_t *entry){
+    if (!entry || !s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    unref_locked(entry);
+    xSemaphoreGive(s_lock);
+}
+
+const uint8_t *photo_cache_entry_data(const photo_cache_entry_t *entry){
+    return entry->data;
+}
+
+size_t photo_cache_entry_len(const photo_cache_entry_t *entry){
+    return entry->len;
+}
+
+/**
+ * @brief Remove every cached scale of a photo
+ *
+ * @param id Photo identifier (file name)
+ */
+void photo_cache_invalidate(const char *id){
+    if (!id || !s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    photo_cache_entry_t *e = s_head;
+    while (e) {
+        photo_cache_entry_t *next = e->next;
+        if (strcmp(e->id, id) == 0) {
+            remove_locked(e);
+        }
+        e = next;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Copy the cache counters
+ *
+ * @param out Destination
+ */
+void photo_cache_get_stats(photo_cache_stats_t *out){
+    if (!out) return;
+    if (!s_lock) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Default byte budget for cached JPEGs (all entries, all scales) */
+#ifndef PHOTO_CACHE_CAPACITY_BYTES
+#define PHOTO_CACHE_CAPACITY_BYTES (1024 * 1024)
+#endif
+
+#define PHOTO_CACHE_ID_MAX 64
+
+// Opaque cache entry handle. Valid until released with photo_cache_release().
+typedef struct photo_cache_entry photo_cache_entry_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t insertions;
+    uint32_t evictions;
+    uint32_t entries;
+    size_t bytes;
+    size_t capacity;
+} photo_cache_stats_t;
+
+// Initialize the cache with a byte budget. Entries are stored in PSRAM.
+esp_err_t photo_cache_init(size_t capacity_bytes);
+
+// Change the byte budget, evicting least recently used entries down to it
+void photo_cache_set_capacity(size_t capacity_bytes);
+
+// Copy `len` bytes into the cache under (id, scale), evicting least recently used entries.
+esp_err_t photo_cache_put(const char *id, int scale, const uint8_t *data, size_t len);
+
+// Allocate an uncommitted entry of `len` bytes to be filled through photo_cache_entry_buf().
+photo_cache_entry_t *photo_cache_reserve(const char *id, int scale, size_t len);
+
+// Writable bytes of a reserved, not yet committed entry
+uint8_t *photo_cache_entry_buf(photo_cache_entry_t *entry);
+
+// Publish a reserved entry, evicting least recently used entries. Consumes the reservation.
+void photo_cache_commit(photo_cache_entry_t *entry);
+
+// Drop a reserved entry without publishing it
+void photo_cache_discard(photo_cache_entry_t *entry);
+
+// Look up (id, scale). Returns a referenced entry or NULL on miss.
+photo_cache_entry_t *photo_cache_get(const char *id, int scale);
+
+// Drop a reference obtained from photo_cache_get().
+void photo_cache_release(photo_cache_entry_t *entry);
+
+// Cached bytes of an entry
+const uint8_t *photo_cache_entry_data(const photo_cache_entry_t *entry);
+
+// Length of cached bytes of an entry
+size_t photo_cache_entry_len(const photo_cache_entry_t *entry);
+
+// Remove all scales of `id` from the cache
+void photo_cache_invalidate(const char *id);
+
+// Snapshot of cache counters
+void photo_cache_get_stats(photo_cache_stats_t *out);
@@ -0,0 +1,213 @@
+/**
+ * @file power_ctl.c
+ * @author xholanp00
+ * @brief Dynamic frequency scaling with per-activity CPU_FREQ_MAX locks
+ *
+ * The node spends most of its life waiting for a trigger or a viewer. While
+ * none of the locks below is held, esp_pm runs the CPU at the minimum
+ * frequency and the idle task may enter light sleep; taking any lock brings
+ * it back to the maximum. Each lock also tracks how long it was held, so
+ * /metrics shows how much of the uptime was spent at full speed. Light
+ * sleeps are counted from the esp_pm exit callback, so callers can tell an
+ * idle spell the node slept through from one it only spent at low clock.
+ */
+
+#include "power_ctl.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#if CONFIG_POWER_CTL_ENABLE
+#include "esp_attr.h"
+#include "esp_pm.h"
+#endif
+
+static const char *TAG = "power_ctl"; // Tag for logging
+
+#if CONFIG_POWER_CTL_LIGHT_SLEEP
+#define POWER_CTL_LIGHT_SLEEP 1
+#else
+#define POWER_CTL_LIGHT_SLEEP 0
+#endif
+
+static const char *const s_names[POWER_LOCK_COUNT] = {
+    [POWER_LOCK_CAPTURE] = "capture",
+    [POWER_LOCK_HTTP] = "http",
+    [POWER_LOCK_STREAM] = "stream",
+};
+
+#if CONFIG_POWER_CTL_ENABLE
+static esp_pm_lock_handle_t s_pm_locks[POWER_LOCK_COUNT];
+#endif
+static bool s_dfs = false;
+
+static power_lock_stats_t s_locks[POWER_LOCK_COUNT];
+static int64_t s_lock_since[POWER_LOCK_COUNT];
+static uint32_t s_holders = 0;            // over all locks
+static int64_t s_active_since = 0;
+static uint32_t s_wakes = 0;
+static volatile uint32_t s_sleeps = 0;    // written by the light sleep exit callback
+static uint32_t s_sleeps_at_idle = 0;     // s_sleeps when the last lock was released
+static bool s_slept = false;              // the node light-slept before the current active spell
+static uint64_t s_active_us = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_POWER_CTL_ENABLE && POWER_CTL_LIGHT_SLEEP
+/**
+ * @brief Count a light sleep; runs in the idle task on its way out of sleep
+ *
+ * @param sleep_time_us Time slept
+ * @param arg Unused
+ * @return esp_err_t ESP_OK
+ */
+static esp_err_t IRAM_ATTR sleep_exit_cb(int64_t sleep_time_us, void *arg){
+    (void)sleep_time_us;
+    (void)arg;
+    s_sleeps++;
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Configure esp_pm and create one CPU_FREQ_MAX lock per activity
+ *
+ * Without CONFIG_POWER_CTL_ENABLE (or on the host build) the CPU keeps its
+ * fixed frequency and the locks only count.
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t power_ctl_init(void){
+#if CONFIG_POWER_CTL_ENABLE
+    if (s_dfs) return ESP_OK;
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        esp_err_t err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, s_names[i], &s_pm_locks[i]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create %s lock: %s", s_names[i], esp_err_to_name(err));
+            return err;
+        }
+    }
+    esp_pm_config_t cfg = {
+        .max_freq_mhz = CONFIG_POWER_CTL_MAX_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_POWER_CTL_MIN_FREQ_MHZ,
+        .light_sleep_enable = POWER_CTL_LIGHT_SLEEP,
+    };
+    esp_err_t err = esp_pm_configure(&cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+        return err;
+    }
+#if POWER_CTL_LIGHT_SLEEP
+    esp_pm_sleep_cbs_register_config_t cbs = {
+        .exit_cb = sleep_exit_cb,
+    };
+    err = esp_pm_light_sleep_register_cbs(&cbs);
+    if (err != ESP_OK) {
+        /* Without the count every wake would look like one after a sleep */
+        ESP_LOGW(TAG, "Light sleep callback not registered: %s", esp_err_to_name(err));
+    }
+#endif
+    s_dfs = true;
+    ESP_LOGI(TAG, "CPU %d-%d MHz, light sleep %s", CONFIG_POWER_CTL_MIN_FREQ_MHZ,
+             CONFIG_POWER_CTL_MAX_FREQ_MHZ, POWER_CTL_LIGHT_SLEEP ? "on" : "off");
+#else
+    ESP_LOGI(TAG, "Frequency scaling disabled");
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief Hold the CPU at full speed for an activity
+ *
+ * @param id Activity
+ */
+void power_ctl_acquire(power_lock_id_t id){
+    if (id >= POWER_LOCK_COUNT) return;
+#if CONFIG_POWER_CTL_ENABLE
+    /* esp_pm locks count themselves; the switch to full speed happens here */
+    if (s_pm_locks[id]) esp_pm_lock_acquire(s_pm_locks[id]);
+#endif
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_locks[id].held++ == 0) {
+        s_locks[id].taken++;
+        s_lock_since[id] = now;
+    }
+    if (s_holders++ == 0) {
+        s_wakes++;
+        s_active_since = now;
+        s_slept = s_sleeps != s_sleeps_at_idle;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Give back a hold taken with power_ctl_acquire()
+ *
+ * @param id Activity
+ */
+void power_ctl_release(power_lock_id_t id){
+    if (id >= POWER_LOCK_COUNT) return;
+    int64_t now = esp_timer_get_time();
+    bool released = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_locks[id].held > 0) {
+        released = true;
+        if (--s_locks[id].held == 0) {
+            uint32_t span = (uint32_t)(now - s_lock_since[id]);
+            s_locks[id].held_us += span;
+            if (span > s_locks[id].held_us_max) s_locks[id].held_us_max = span;
+        }
+        if (--s_holders == 0) {
+            s_active_us += (uint64_t)(now - s_active_since);
+            s_sleeps_at_idle = s_sleeps;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+#if CONFIG_POWER_CTL_ENABLE
+    if (released && s_pm_locks[id]) esp_pm_lock_release(s_pm_locks[id]);
+#else
+    (void)released;
+#endif
+}
+
+int64_t power_ctl_wake_us(void){
+    if (!POWER_CTL_LIGHT_SLEEP || !s_dfs) return 0;
+    portENTER_CRITICAL(&s_lock);
+    int64_t since = s_slept ? s_active_since : 0;
+    portEXIT_CRITICAL(&s_lock);
+    return since;
+}
+
+const char *power_ctl_lock_name(power_lock_id_t id){
+    return id < POWER_LOCK_COUNT ? s_names[id] : "unknown";
+}
+
+/**
+ * @brief Copy the lock counters
+ *
+ * @param out Destination
+ */
+void power_ctl_get_stats(power_ctl_stats_t *out){
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    out->dfs = s_dfs;
+    out->light_sleep = s_dfs && POWER_CTL_LIGHT_SLEEP;
+#if CONFIG_POWER_CTL_ENABLE
+    out->max_mhz = CONFIG_POWER_CTL_MAX_FREQ_MHZ;
+    out->min_mhz = CONFIG_POWER_CTL_MIN_FREQ_MHZ;
+#endif
+    int64_t now = esp_timer_get_time();
+    out->uptime_us = (uint64_t)now;
+    portENTER_CRITICAL(&s_lock);
+    out->wakes = s_wakes;
+    out->light_sleeps = s_sleeps;
+    out->active_us = s_active_us;
+    if (s_holders > 0) out->active_us += (uint64_t)(now - s_active_since);
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        out->locks[i] = s_locks[i];
+        if (s_locks[i].held > 0) out->locks[i].held_us += (uint64_t)(now - s_lock_since[i]);
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
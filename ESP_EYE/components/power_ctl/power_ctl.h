@@ -0,0 +1,48 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Activities that keep the CPU at full speed while they run */
+typedef enum {
+    POWER_LOCK_CAPTURE = 0,   // trigger queued or being captured
+    POWER_LOCK_HTTP,          // HTTP handler running
+    POWER_LOCK_STREAM,        // MJPEG viewer connected
+    POWER_LOCK_COUNT
+} power_lock_id_t;
+
+typedef struct {
+    uint32_t taken;           // idle -> held transitions
+    uint32_t held;            // current holders
+    uint64_t held_us;         // total time held (finished spans)
+    uint32_t held_us_max;
+} power_lock_stats_t;
+
+typedef struct {
+    bool dfs;                 // esp_pm configured
+    bool light_sleep;
+    uint16_t max_mhz;
+    uint16_t min_mhz;
+    uint32_t wakes;           // idle -> active transitions
+    uint32_t light_sleeps;    // automatic light sleeps entered
+    uint64_t active_us;       // time with any lock held
+    uint64_t uptime_us;
+    power_lock_stats_t locks[POWER_LOCK_COUNT];
+} power_ctl_stats_t;
+
+// Configure frequency scaling and create the locks. Call before Wi-Fi starts.
+esp_err_t power_ctl_init(void);
+
+// Keep the CPU at full speed until the matching power_ctl_release(). Nests.
+void power_ctl_acquire(power_lock_id_t id);
+void power_ctl_release(power_lock_id_t id);
+
+// esp_timer time the node last left idle; 0 if it did not light-sleep during that idle spell
+int64_t power_ctl_wake_us(void);
+
+// Name of a lock as shown in /metrics
+const char *power_ctl_lock_name(power_lock_id_t id);
+
+// Snapshot of lock counters; held spans still open are counted up to now
+void power_ctl_get_stats(power_ctl_stats_t *out);
@@ -0,0 +1,217 @@
+/**
+ * @file camera_guard.c
+ * @author xholanp00
+ * @brief Camera watchdog: detects a wedged or stalled sensor and re-initialises it in place
+ *
+ * Users bracket their camera access with camera_guard_enter()/exit(). When
+ * grabs keep failing or frame timestamps stop advancing, the supervisor
+ * closes the gate, waits for current users to give back their frames,
+ * deinitialises the driver and brings it up again. Users arriving meanwhile
+ * wait for the gate to reopen instead of hammering the dead driver.
+ *
+ * The gate lets several users grab frames at once, so changes to the sensor
+ * settings are serialised separately by the sensor mutex.
+ */
+
+#include "camera_guard.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "task_plan.h"
+#include "event_trace.h"
+
+static const char *TAG = "camera_guard"; // Tag for logging
+
+/* Poll period while waiting for the gate or for users to leave */
+#define GUARD_POLL_MS 20
+
+static camera_guard_start_fn s_start = NULL;
+static TaskHandle_t s_supervisor = NULL;
+static uint32_t s_users = 0;
+static uint32_t s_consecutive_failures = 0;
+static uint32_t s_consecutive_stalls = 0;
+static int64_t s_last_frame_us = 0;       // timestamp of the newest frame seen
+static int64_t s_detected_us = 0;         // when the pending problem was detected
+static bool s_pending = false;            // supervisor notified, recovery not done yet
+static camera_guard_stats_t s_stats = {0};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_sensor = NULL;  // held while a user depends on the sensor settings
+
+bool camera_guard_enter(TickType_t wait){
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        portENTER_CRITICAL(&s_lock);
+        bool open = !s_stats.recovering;
+        if (open) s_users++;
+        portEXIT_CRITICAL(&s_lock);
+        if (open) return true;
+        if (xTaskGetTickCount() - start >= wait) {
+            portENTER_CRITICAL(&s_lock);
+            s_stats.gate_timeouts++;
+            portEXIT_CRITICAL(&s_lock);
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(GUARD_POLL_MS));
+    }
+}
+
+void camera_guard_exit(void){
+    portENTER_CRITICAL(&s_lock);
+    if (s_users) s_users--;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Take the sensor mutex
+ *
+ * A capture holds it from setting its frame size until its frame is grabbed;
+ * the stream holds it while it checks the capture queue and resizes.
+ *
+ * @param wait Ticks to wait for the current holder
+ * @return true if taken, false on timeout or before camera_guard_init()
+ */
+bool camera_guard_sensor_take(TickType_t wait){
+    return s_sensor && xSemaphoreTake(s_sensor, wait) == pdTRUE;
+}
+
+void camera_guard_sensor_give(void){
+    if (s_sensor) xSemaphoreGive(s_sensor);
+}
+
+/**
+ * @brief Grab a frame and account for failures and stalled timestamps
+ *
+ * @return camera_fb_t* Frame, or NULL if the driver returned none
+ */
+camera_fb_t *camera_guard_fb_get(void){
+    camera_fb_t *fb = esp_camera_fb_get();
+    const char *reason = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    if (!fb) {
+        s_stats.grab_failures++;
+        if (++s_consecutive_failures >= CAMERA_GUARD_FAIL_LIMIT) reason = "grab_failures";
+    } else {
+        s_stats.frames++;
+        s_consecutive_failures = 0;
+        /* The driver stamps frames with esp_timer time, so they only move forward */
+        int64_t ts = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+        if (ts <= s_last_frame_us) {
+            s_stats.stalls++;
+            if (++s_consecutive_stalls >= CAMERA_GUARD_STALL_LIMIT) reason = "stalled";
+        } else {
+            s_consecutive_stalls = 0;
+            s_last_frame_us = ts;
+        }
+    }
+    bool notify = reason && !s_pending && s_supervisor;
+    if (notify) {
+        s_pending = true;
+        s_detected_us = esp_timer_get_time();
+        s_stats.last_reason = reason;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (notify) {
+        ESP_LOGW(TAG, "Camera %s, scheduling re-init", reason);
+        xTaskNotifyGive(s_supervisor);
+    }
+    return fb;
+}
+
+/**
+ * @brief Close the gate, wait for users to leave and re-initialise the camera
+ *
+ * @return esp_err_t ESP_OK once the camera is back, error code to retry later
+ */
+static esp_err_t recover(void){
+    portENTER_CRITICAL(&s_lock);
+    s_stats.recovering = true;
+    portEXIT_CRITICAL(&s_lock);
+
+    TRACE_BEGIN("camera_recover");
+    int64_t deadline = esp_timer_get_time() + (int64_t)CAMERA_GUARD_QUIESCE_MS * 1000;
+    for (;;) {
+        portENTER_CRITICAL(&s_lock);
+        uint32_t users = s_users;
+        portEXIT_CRITICAL(&s_lock);
+        if (users == 0) break;
+        if (esp_timer_get_time() > deadline) {
+            TRACE_END("camera_recover");
+            ESP_LOGW(TAG, "%lu camera users still active, retrying", (unsigned long)users);
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(GUARD_POLL_MS));
+    }
+
+    esp_err_t err = esp_camera_deinit();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Camera deinit failed: %s", esp_err_to_name(err));
+    }
+    err = s_start();
+    TRACE_END("camera_recover");
+    if (err != ESP_OK) {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.recovery_failures++;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGE(TAG, "Camera re-init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    uint32_t took_us = (uint32_t)(esp_timer_get_time() - s_detected_us);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.recoveries++;
+    s_stats.last_recovery_us = took_us;
+    if (took_us > s_stats.max_recovery_us) s_stats.max_recovery_us = took_us;
+    s_consecutive_failures = 0;
+    s_consecutive_stalls = 0;
+    s_last_frame_us = 0;
+    s_pending = false;
+    s_stats.recovering = false;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "Camera recovered in %lu ms", (unsigned long)(took_us / 1000));
+    return ESP_OK;
+}
+
+/**
+ * @brief Supervisor task: recovers the camera when the grab path reports a problem
+ *
+ * @param arg Unused
+ */
+static void supervisor_task(void *arg){
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t retry_ms = CAMERA_GUARD_RETRY_MS;
+        while (recover() != ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS(retry_ms));
+            retry_ms = retry_ms * 2 > CAMERA_GUARD_RETRY_MAX_MS ? CAMERA_GUARD_RETRY_MAX_MS : retry_ms * 2;
+        }
+    }
+}
+
+/**
+ * @brief Start the supervisor
+ *
+ * @param start Function that brings the camera up again after a deinit
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t camera_guard_init(camera_guard_start_fn start){
+    if (!start) return ESP_ERR_INVALID_ARG;
+    if (s_supervisor) return ESP_OK;
+    if (!s_sensor) {
+        s_sensor = xSemaphoreCreateMutex();
+        if (!s_sensor) return ESP_ERR_NO_MEM;
+    }
+    s_start = start;
+    return task_plan_create(TASK_PLAN_CAMERA_GUARD, supervisor_task, NULL, &s_supervisor);
+}
+
+void camera_guard_get_stats(camera_guard_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
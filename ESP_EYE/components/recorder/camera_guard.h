@@ -0,0 +1,68 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_camera.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/* Consecutive failed grabs that mark the camera as wedged */
+#ifndef CAMERA_GUARD_FAIL_LIMIT
+#define CAMERA_GUARD_FAIL_LIMIT 5
+#endif
+
+/* Consecutive frames whose timestamp does not advance that mark it as stalled */
+#ifndef CAMERA_GUARD_STALL_LIMIT
+#define CAMERA_GUARD_STALL_LIMIT 5
+#endif
+
+/* How long recovery waits for users to give back their frames */
+#ifndef CAMERA_GUARD_QUIESCE_MS
+#define CAMERA_GUARD_QUIESCE_MS 5000
+#endif
+
+/* First retry delay after a failed re-init; doubles up to CAMERA_GUARD_RETRY_MAX_MS */
+#ifndef CAMERA_GUARD_RETRY_MS
+#define CAMERA_GUARD_RETRY_MS 1000
+#endif
+
+#ifndef CAMERA_GUARD_RETRY_MAX_MS
+#define CAMERA_GUARD_RETRY_MAX_MS 30000
+#endif
+
+// Bring the camera up (esp_camera_init plus sensor tuning). Called again after each deinit.
+typedef esp_err_t (*camera_guard_start_fn)(void);
+
+typedef struct {
+    bool recovering;
+    uint32_t frames;
+    uint32_t grab_failures;
+    uint32_t stalls;                // frames with a timestamp that did not advance
+    uint32_t recoveries;            // successful re-inits
+    uint32_t recovery_failures;     // re-init attempts that failed
+    uint32_t gate_timeouts;         // users that gave up waiting for a recovery
+    uint32_t last_recovery_us;      // detection to resumed, last recovery
+    uint32_t max_recovery_us;
+    const char *last_reason;        // "grab_failures", "stalled" or NULL
+} camera_guard_stats_t;
+
+// Start the supervisor for a camera brought up with `start`
+esp_err_t camera_guard_init(camera_guard_start_fn start);
+
+// Begin using the camera (sensor or frames). Waits up to `wait` while it is being re-initialised.
+bool camera_guard_enter(TickType_t wait);
+
+// Done with the camera; every frame from camera_guard_fb_get() must be returned first
+void camera_guard_exit(void);
+
+// esp_camera_fb_get() that feeds the failure and stall detection. Call between enter and exit.
+camera_fb_t *camera_guard_fb_get(void);
+
+// Own the sensor settings (frame size, quality) until camera_guard_sensor_give(). Call between enter and exit.
+bool camera_guard_sensor_take(TickType_t wait);
+
+// Release the sensor settings
+void camera_guard_sensor_give(void);
+
+// Snapshot of supervisor counters
+void camera_guard_get_stats(camera_guard_stats_t *out);
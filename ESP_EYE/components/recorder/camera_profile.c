@@ -0,0 +1,309 @@
+/**
+ * @file camera_profile.c
+ * @author xholanp00
+ * @brief Board pinout and sensor profile table used to bring the camera up
+ *
+ * Profiles are tried in table order until one initialises. The winner is
+ * stored in NVS so the next boot tries it first and does not pay for a
+ * failing esp_camera_init() on boards where the first profile never works.
+ * A profile is only given up for a lesser one after it failed several boots
+ * in a row, so one flaky start-up does not downgrade the node for good.
+ */
+
+#include "camera_profile.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "settings.h"
+
+static const char *TAG = "camera_profile"; // Tag for logging
+
+/* settings keeps the frame_size range as plain numbers */
+_Static_assert(SETTINGS_FRAMESIZE_MIN == FRAMESIZE_QQVGA && SETTINGS_FRAMESIZE_MAX == FRAMESIZE_UXGA,
+               "SETTINGS_FRAMESIZE_MIN/MAX no longer match framesize_t");
+
+#define CAMERA_PROFILE_NAMESPACE "camera"
+#define CAMERA_PROFILE_KEY "profile"
+#define CAMERA_PROFILE_MISSES_KEY "misses"
+
+/* Consecutive failed start-ups of the preferred profile before another one is remembered instead */
+#ifndef CAMERA_PROFILE_DOWNGRADE_AFTER
+#define CAMERA_PROFILE_DOWNGRADE_AFTER 3
+#endif
+
+/* Longest profile name stored in NVS (incl. terminator) */
+#define CAMERA_PROFILE_NAME_MAX 16
+
+typedef struct {
+    const char *name;
+    framesize_t frame_size;
+    int jpeg_quality;
+    size_t fb_count;
+    void (*tune)(sensor_t *s);
+} camera_profile_t;
+
+/**
+ * @brief AI-Thinker ESP32-CAM pinout; profiles only override the frame settings
+ *
+ */
+static const camera_config_t s_board = {
+    .pin_pwdn = 32,
+    .pin_reset = -1,
+    .pin_xclk = 0,
+    .pin_sccb_sda = 26,
+    .pin_sccb_scl = 27,
+    .pin_d7 = 35,
+    .pin_d6 = 34,
+    .pin_d5 = 39,
+    .pin_d4 = 36,
+    .pin_d3 = 21,
+    .pin_d2 = 19,
+    .pin_d1 = 18,
+    .pin_d0 = 5,
+    .pin_vsync = 25,
+    .pin_href = 23,
+    .pin_pclk = 22,
+    .xclk_freq_hz = 20000000,
+    .ledc_timer = LEDC_TIMER_0,
+    .ledc_channel = LEDC_CHANNEL_0,
+    .pixel_format = PIXFORMAT_JPEG,
+    .fb_location = CAMERA_FB_IN_PSRAM,
+    .grab_mode = CAMERA_GRAB_LATEST
+};
+
+/**
+ * @brief Full OV2640 tuning for the XGA profile
+ *
+ * @param s Sensor
+ */
+static void tune_full(sensor_t *s){
+    s->set_brightness(s, 0);
+    s->set_contrast(s, 0);
+    s->set_saturation(s, 0);
+    s->set_whitebal(s, 1);
+    s->set_awb_gain(s, 1);
+    s->set_wb_mode(s, 0);
+    s->set_exposure_ctrl(s, 1);
+    s->set_aec2(s, 0);
+    s->set_ae_level(s, 0);
+    s->set_aec_value(s, 300);
+    s->set_gain_ctrl(s, 1);
+    s->set_agc_gain(s, 0);
+    s->set_gainceiling(s, (gainceiling_t)0);
+    s->set_bpc(s, 0);
+    s->set_wpc(s, 1);
+    s->set_raw_gma(s, 1);
+    s->set_lenc(s, 1);
+    s->set_hmirror(s, 0);
+    s->set_vflip(s, 0);
+    s->set_dcw(s, 1);
+}
+
+/**
+ * @brief Automatic white balance, exposure and gain only
+ *
+ * @param s Sensor
+ */
+static void tune_basic(sensor_t *s){
+    s->set_whitebal(s, 1);
+    s->set_awb_gain(s, 1);
+    s->set_exposure_ctrl(s, 1);
+    s->set_gain_ctrl(s, 1);
+    s->set_lenc(s, 1);
+}
+
+/* Tried in this order; the first that initialises wins */
+static const camera_profile_t s_profiles[CAMERA_PROFILE_COUNT] = {
+    { "xga", FRAMESIZE_XGA, 12, 2, tune_full },
+    { "vga", FRAMESIZE_VGA, 12, 2, tune_basic },
+};
+
+static int s_active = -1;
+static int s_remembered = -1;
+static uint8_t s_misses = 0;      // consecutive start-ups the preferred profile failed
+static bool s_booted = false;
+static camera_init_stats_t s_stats = {0};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int find_profile(const char *name){
+    for (int i = 0; i < CAMERA_PROFILE_COUNT; i++) {
+        if (strcmp(s_profiles[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Profile stored by an earlier boot
+ *
+ * @return int Table index, -1 if none is stored or NVS is unavailable
+ */
+static int load_remembered(void){
+    nvs_handle_t nvs;
+    if (nvs_open(CAMERA_PROFILE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return -1;
+    char name[CAMERA_PROFILE_NAME_MAX];
+    size_t len = sizeof(name);
+    esp_err_t err = nvs_get_str(nvs, CAMERA_PROFILE_KEY, name, &len);
+    if (nvs_get_u8(nvs, CAMERA_PROFILE_MISSES_KEY, &s_misses) != ESP_OK) s_misses = 0;
+    nvs_close(nvs);
+    if (err != ESP_OK) return -1;
+    int index = find_profile(name);
+    if (index < 0) {
+        ESP_LOGW(TAG, "Stored profile %s is not in the table", name);
+    }
+    return index;
+}
+
+/**
+ * @brief Store the profile to try first and the failure count of the preferred one
+ *
+ * @param index Table index
+ * @param misses Consecutive failed start-ups of that profile
+ */
+static void store_remembered(int index, uint8_t misses){
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CAMERA_PROFILE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs, CAMERA_PROFILE_KEY, s_profiles[index].name);
+        if (err == ESP_OK) err = nvs_set_u8(nvs, CAMERA_PROFILE_MISSES_KEY, misses);
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Could not remember profile %s: %s", s_profiles[index].name, esp_err_to_name(err));
+    }
+}
+
+/**
+ * @brief Initialise the camera with one profile and time it
+ *
+ * @param index Table index
+ * @return esp_err_t Result of esp_camera_init()
+ */
+static esp_err_t try_profile(int index){
+    const camera_profile_t *p = &s_profiles[index];
+    camera_config_t config = s_board;
+    config.frame_size = p->frame_size;
+    config.jpeg_quality = p->jpeg_quality;
+    config.fb_count = p->fb_count;
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_camera_init(&config);
+    uint32_t took_us = (uint32_t)(esp_timer_get_time() - t0);
+
+    portENTER_CRITICAL(&s_lock);
+    camera_profile_stats_t *st = &s_stats.profiles[index];
+    if (err == ESP_OK) st->inits++;
+    else st->failures++;
+    st->last_init_us = took_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Profile %s failed in %lu ms: %s", p->name, (unsigned long)(took_us / 1000),
+                 esp_err_to_name(err));
+        return err;
+    }
+    sensor_t *s = esp_camera_sensor_get();
+    if (s && p->tune) p->tune(s);
+    return ESP_OK;
+}
+
+/**
+ * @brief Bring the camera up with the first working profile
+ *
+ * @return esp_err_t ESP_OK on success, error of the last attempt otherwise
+ */
+esp_err_t camera_profile_start(void){
+    int64_t t0 = esp_timer_get_time();
+    bool boot = !s_booted;
+    if (boot) {
+        s_booted = true;
+        s_remembered = load_remembered();
+    }
+
+    /* Active profile (watchdog re-init), then the remembered one, then the table */
+    int order[CAMERA_PROFILE_COUNT + 2];
+    int n = 0;
+    if (s_active >= 0) order[n++] = s_active;
+    if (s_remembered >= 0 && s_remembered != s_active) order[n++] = s_remembered;
+    for (int i = 0; i < CAMERA_PROFILE_COUNT; i++) {
+        if (i != s_active && i != s_remembered) order[n++] = i;
+    }
+
+    /* The remembered profile, or the table's first while nothing is remembered */
+    int preferred = s_remembered >= 0 ? s_remembered : 0;
+    bool preferred_failed = false;
+
+    esp_err_t err = ESP_FAIL;
+    int attempts = 0;
+    int winner = -1;
+    for (int i = 0; i < n && winner < 0; i++) {
+        attempts++;
+        err = try_profile(order[i]);
+        if (err == ESP_OK) winner = order[i];
+        else if (order[i] == preferred) preferred_failed = true;
+    }
+    uint32_t took_us = (uint32_t)(esp_timer_get_time() - t0);
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.last_start_us = took_us;
+    if (boot) {
+        s_stats.remembered = s_remembered >= 0 ? s_profiles[s_remembered].name : NULL;
+        s_stats.boot_init_us = took_us;
+        s_stats.boot_attempts = attempts;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    s_active = winner;
+
+    if (winner < 0) {
+        ESP_LOGE(TAG, "No camera profile initialised: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Camera up with profile %s in %lu ms (%d attempt%s)", s_profiles[winner].name,
+             (unsigned long)(took_us / 1000), attempts, attempts == 1 ? "" : "s");
+    /* Frame buffers were sized for this profile; larger captures would not fit */
+    settings_set_limit(SETTING_CAPTURE_FRAMESIZE, s_profiles[winner].frame_size);
+    if (winner == preferred) {
+        if (winner != s_remembered || s_misses) store_remembered(winner, 0);
+        s_remembered = winner;
+        s_misses = 0;
+    } else if (preferred_failed) {
+        /* Keep trying the preferred profile first until it has failed often enough */
+        if (++s_misses >= CAMERA_PROFILE_DOWNGRADE_AFTER) {
+            ESP_LOGW(TAG, "Profile %s failed %u start-ups in a row, remembering %s", s_profiles[preferred].name,
+                     (unsigned)s_misses, s_profiles[winner].name);
+            s_remembered = winner;
+            s_misses = 0;
+        }
+        store_remembered(s_remembered >= 0 ? s_remembered : preferred, s_misses);
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.remembered_misses = s_misses;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+const char *camera_profile_active(void){
+    int index = s_active;
+    return index >= 0 ? s_profiles[index].name : NULL;
+}
+
+framesize_t camera_profile_frame_size(void){
+    int index = s_active;
+    return index >= 0 ? s_profiles[index].frame_size : FRAMESIZE_INVALID;
+}
+
+void camera_profile_get_stats(camera_init_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    out->active = camera_profile_active();
+    for (int i = 0; i < CAMERA_PROFILE_COUNT; i++) {
+        out->profiles[i].name = s_profiles[i].name;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "esp_err.h"
+#include "sensor.h"
+#include <stdint.h>
+
+/* Number of entries in the profile table (camera_profile.c) */
+#define CAMERA_PROFILE_COUNT 2
+
+typedef struct {
+    const char *name;
+    uint32_t inits;             // successful esp_camera_init() calls
+    uint32_t failures;          // failed esp_camera_init() calls
+    uint32_t last_init_us;      // duration of the latest attempt, failed or not
+} camera_profile_stats_t;
+
+typedef struct {
+    const char *active;         // profile in use, NULL if the camera never came up
+    const char *remembered;     // profile stored in NVS at boot, NULL if none
+    uint32_t remembered_misses; // consecutive start-ups the preferred profile failed
+    uint32_t boot_init_us;      // boot start-up, all attempts included
+    uint32_t boot_attempts;     // esp_camera_init() calls the boot start-up needed
+    uint32_t last_start_us;     // latest start-up (boot or watchdog re-init)
+    camera_profile_stats_t profiles[CAMERA_PROFILE_COUNT];
+} camera_init_stats_t;
+
+// Bring the camera up: the active profile first, then the one remembered in NVS,
+// then the table in order. Applies the profile's sensor tuning; a different winner is only
+// remembered after the preferred profile failed several start-ups in a row.
+esp_err_t camera_profile_start(void);
+
+// Name of the profile the camera runs with, NULL if it is not up
+const char *camera_profile_active(void);
+
+// Frame size the active profile starts the sensor with, FRAMESIZE_INVALID if it is not up
+framesize_t camera_profile_frame_size(void);
+
+// Start-up timings and per-profile counters
+void camera_profile_get_stats(camera_init_stats_t *out);
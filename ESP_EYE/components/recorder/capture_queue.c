@@ -0,0 +1,186 @@
+/**
+ * @file capture_queue.c
+ * @author xholanp00
+ * @brief Fixed-size capture request queue backed by a static slot table
+ *
+ * Producers copy a request into a free slot and queue its index; the worker
+ * takes the index, copies the request out and releases the slot when the
+ * capture is done. Nothing is allocated per request.
+ */
+
+#include "capture_queue.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "settings.h"
+
+static const char *TAG = "capture_queue"; // Tag for logging
+
+static capture_request_t s_slots[CAPTURE_QUEUE_LEN];
+static uint32_t s_next_seq = 1;
+static capture_queue_stats_t s_stats = {0};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static QueueHandle_t s_queue = NULL;
+static StaticQueue_t s_queue_struct;
+static uint8_t s_queue_storage[CAPTURE_QUEUE_LEN];
+
+/**
+ * @brief Create the queue of slot indices
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t capture_queue_init(void){
+    if (s_queue) return ESP_OK;
+    s_queue = xQueueCreateStatic(CAPTURE_QUEUE_LEN, sizeof(uint8_t), s_queue_storage, &s_queue_struct);
+    if (!s_queue) {
+        ESP_LOGE(TAG, "Failed to create capture queue");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Queue a capture request
+ *
+ * @param req Request to copy (path and trigger must fit their fields)
+ * @param wait Ticks to wait for the queue (the slot itself is never waited for)
+ * @return esp_err_t ESP_OK when queued, ESP_ERR_NO_MEM when every slot is in use
+ */
+esp_err_t capture_queue_push(const capture_request_t *req, TickType_t wait){
+    if (!req || req->path[0] == '\0') return ESP_ERR_INVALID_ARG;
+    if (!s_queue) return ESP_ERR_INVALID_STATE;
+
+    /* Runtime depth limit, never more than the static slots */
+    uint32_t depth = settings_get(SETTING_CAPTURE_QUEUE_DEPTH);
+    if (depth > CAPTURE_QUEUE_LEN) depth = CAPTURE_QUEUE_LEN;
+
+    int slot = -1;
+    uint32_t used = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < CAPTURE_QUEUE_LEN; i++) {
+        if (s_slots[i].state == CAPTURE_SLOT_FREE) {
+            if (slot < 0) slot = i;
+        } else {
+            used++;
+        }
+    }
+    if (used >= depth) slot = -1;
+    if (slot >= 0) {
+        s_slots[slot] = *req;
+        s_slots[slot].seq = s_next_seq++;
+        s_slots[slot].state = CAPTURE_SLOT_PENDING;
+        s_slots[slot].enqueued_us = esp_timer_get_time();
+        s_stats.pushed++;
+        s_stats.pending++;
+        if (used + 1 > s_stats.high_water) s_stats.high_water = used + 1;
+    } else {
+        s_stats.rejected++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (slot < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    /* There are as many queue entries as slots, so a claimed slot always fits */
+    uint8_t index = (uint8_t)slot;
+    if (xQueueSend(s_queue, &index, wait) != pdTRUE) {
+        portENTER_CRITICAL(&s_lock);
+        s_slots[slot].state = CAPTURE_SLOT_FREE;
+        s_stats.pushed--;
+        s_stats.pending--;
+        s_stats.rejected++;
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Take the next queued request
+ *
+ * @param out Receives a copy of the request
+ * @param wait Ticks to wait
+ * @return int Slot index to pass to capture_queue_done(), -1 on timeout
+ */
+int capture_queue_pop(capture_request_t *out, TickType_t wait){
+    uint8_t index;
+    if (!s_queue || xQueueReceive(s_queue, &index, wait) != pdTRUE) {
+        return -1;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    uint32_t waited = (uint32_t)(now - s_slots[index].enqueued_us);
+    s_slots[index].state = CAPTURE_SLOT_ACTIVE;
+    s_stats.pending--;
+    s_stats.active++;
+    s_stats.wait_us_total += waited;
+    if (waited > s_stats.wait_us_max) s_stats.wait_us_max = waited;
+    if (out) *out = s_slots[index];
+    portEXIT_CRITICAL(&s_lock);
+    return index;
+}
+
+/**
+ * @brief Release a slot once its capture finished
+ *
+ * @param slot Index returned by capture_queue_pop()
+ * @param outcome How the capture ended
+ */
+void capture_queue_done(int slot, capture_outcome_t outcome){
+    if (slot < 0 || slot >= CAPTURE_QUEUE_LEN) return;
+    portENTER_CRITICAL(&s_lock);
+    if (s_slots[slot].state == CAPTURE_SLOT_ACTIVE) {
+        s_slots[slot].state = CAPTURE_SLOT_FREE;
+        s_stats.active--;
+        if (outcome == CAPTURE_DONE_OK) s_stats.completed++;
+        else if (outcome == CAPTURE_DONE_DUPLICATE) s_stats.duplicates++;
+        else s_stats.failed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Copy the pending and active requests, oldest first
+ *
+ * @param out Destination array
+ * @param max Capacity of `out`
+ * @return size_t Number of requests copied
+ */
+size_t capture_queue_snapshot(capture_request_t *out, size_t max){
+    if (!out || max == 0) return 0;
+    size_t n = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < CAPTURE_QUEUE_LEN && n < max; i++) {
+        if (s_slots[i].state != CAPTURE_SLOT_FREE) {
+            out[n++] = s_slots[i];
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    /* Insertion sort by sequence number; n is at most CAPTURE_QUEUE_LEN */
+    for (size_t i = 1; i < n; i++) {
+        capture_request_t tmp = out[i];
+        size_t j = i;
+        while (j > 0 && (int32_t)(out[j - 1].seq - tmp.seq) > 0) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = tmp;
+    }
+    return n;
+}
+
+/**
+ * @brief Copy the queue counters
+ *
+ * @param out Destination
+ */
+void capture_queue_get_stats(capture_queue_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_camera.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "settings.h"   // CAPTURE_QUEUE_LEN, the bound of the queue_depth setting
+
+/* Longest output path kept in a request (incl. terminator) */
+#define CAPTURE_PATH_MAX 96
+
+/* Longest trigger source name kept in a request (incl. terminator) */
+#define CAPTURE_TRIGGER_MAX 16
+
+typedef enum {
+    CAPTURE_SLOT_FREE = 0,
+    CAPTURE_SLOT_PENDING,    // queued, waiting for the worker
+    CAPTURE_SLOT_ACTIVE,     // being captured
+} capture_slot_state_t;
+
+/* One capture request, copied by value into the pending table */
+typedef struct {
+    uint32_t seq;                     // assigned on push, increases per request
+    capture_slot_state_t state;
+    uint64_t requested_ms;            // epoch ms the trigger asked for (0 if none)
+    int64_t enqueued_us;              // esp_timer time of the push
+    framesize_t frame_size;
+    int jpeg_quality;
+    char trigger[CAPTURE_TRIGGER_MAX];
+    char path[CAPTURE_PATH_MAX];
+} capture_request_t;
+
+/* How a popped request ended */
+typedef enum {
+    CAPTURE_DONE_OK = 0,
+    CAPTURE_DONE_FAILED,
+    CAPTURE_DONE_DUPLICATE,           // dropped as a near-duplicate, nothing written
+} capture_outcome_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t rejected;        // table full or bad arguments
+    uint32_t completed;
+    uint32_t failed;
+    uint32_t duplicates;      // dropped as near-duplicates, nothing written
+    uint32_t pending;         // currently queued
+    uint32_t active;          // currently being captured
+    uint32_t high_water;      // most slots in use at once
+    uint64_t wait_us_total;   // push to pickup
+    uint32_t wait_us_max;
+} capture_queue_stats_t;
+
+// Create the queue. The slot table and the queue storage are static.
+esp_err_t capture_queue_init(void);
+
+// Copy `req` into a free slot and queue it. Seq, state and enqueue time are filled in.
+esp_err_t capture_queue_push(const capture_request_t *req, TickType_t wait);
+
+// Wait for the next request. Returns its slot index (>= 0) and copies it to `out`, or -1 on timeout.
+int capture_queue_pop(capture_request_t *out, TickType_t wait);
+
+// Release a slot returned by capture_queue_pop() and count how its capture ended
+void capture_queue_done(int slot, capture_outcome_t outcome);
+
+// Copy the used slots to `out` (up to `max`), returning how many were copied
+size_t capture_queue_snapshot(capture_request_t *out, size_t max);
+
+// Snapshot of queue counters
+void capture_queue_get_stats(capture_queue_stats_t *out);
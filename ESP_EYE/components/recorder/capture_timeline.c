@@ -0,0 +1,162 @@
+/**
+ * @file capture_timeline.c
+ * @author xholanp00
+ * @brief Ring of per-slot capture counters behind GET /photos/histogram
+ *
+ * Every kept photo bumps the counter of its 5 minute slot, so an activity
+ * histogram is a sum over at most CAPTURE_TIMELINE_SLOTS counters and never
+ * walks the photo directory. The store is read once at startup to fill the
+ * ring with the photos taken before the boot.
+ */
+
+#include "capture_timeline.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "capture_timeline"; // Tag for logging
+
+/* Counters indexed by slot number modulo the ring size; s_head is the newest
+   slot number held and every slot in (s_head - SLOTS, s_head] is current */
+static uint16_t s_counts[CAPTURE_TIMELINE_SLOTS];
+static int64_t s_head = -1;
+static capture_timeline_stats_t s_stats = {0};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Ring index of a slot number; negative numbers wrap like positive ones */
+static size_t ring_index(int64_t slot){
+    int64_t i = slot % CAPTURE_TIMELINE_SLOTS;
+    return (size_t)(i < 0 ? i + CAPTURE_TIMELINE_SLOTS : i);
+}
+
+void capture_timeline_add(int64_t epoch_s){
+    int64_t slot = epoch_s / CAPTURE_TIMELINE_SLOT_S;
+    portENTER_CRITICAL(&s_lock);
+    if (epoch_s < CAPTURE_TIMELINE_MIN_EPOCH_S) {
+        s_stats.unsynced++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    if (s_head < 0 || slot - s_head >= CAPTURE_TIMELINE_SLOTS) {
+        /* First capture, or the whole ring is out of date */
+        memset(s_counts, 0, sizeof(s_counts));
+        s_head = slot;
+    } else if (slot > s_head) {
+        /* Move the head forward, clearing the slots it passes */
+        for (int64_t i = s_head + 1; i <= slot; i++) {
+            s_counts[ring_index(i)] = 0;
+        }
+        s_head = slot;
+    }
+    if (slot <= s_head - CAPTURE_TIMELINE_SLOTS) {
+        s_stats.too_old++;
+    } else {
+        uint16_t *c = &s_counts[ring_index(slot)];
+        if (*c < UINT16_MAX) (*c)++;
+        s_stats.added++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Days from 1970-01-01 to a proleptic Gregorian date
+ *
+ * Names are UTC, so this replaces mktime(), which would apply the local
+ * time zone and DST rules.
+ *
+ * @param y Year
+ * @param m Month, 1-12
+ * @param d Day of the month, 1-31
+ * @return int64_t Day number, negative before 1970
+ */
+static int64_t days_from_civil(int64_t y, int m, int d){
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+bool capture_timeline_parse_name(const char *name, int64_t *epoch_s){
+    int year, mon, mday, hour, min, sec;
+    int n = 0;
+    if (sscanf(name, "%4d-%2d-%2dx%2d_%2d_%2d.jpg%n", &year, &mon, &mday,
+               &hour, &min, &sec, &n) != 6 || n == 0 || name[n] != '\0') {
+        return false;
+    }
+    if (mon < 1 || mon > 12 || mday < 1 || mday > 31 || hour < 0 || hour > 23 ||
+        min < 0 || min > 59 || sec < 0 || sec > 60) {
+        return false;
+    }
+    *epoch_s = days_from_civil(year, mon, mday) * 86400 + hour * 3600 + min * 60 + sec;
+    return true;
+}
+
+/**
+ * @brief Count the photos already in the store
+ *
+ * Only names are read (no stat), so the scan costs one directory walk.
+ *
+ * @param dir Photo directory
+ * @return esp_err_t ESP_OK, or ESP_ERR_NOT_FOUND if the directory cannot be opened
+ */
+esp_err_t capture_timeline_seed(const char *dir){
+    int64_t t0 = esp_timer_get_time();
+    DIR *d = opendir(dir);
+    if (!d) {
+        ESP_LOGW(TAG, "Cannot open %s", dir);
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t seeded = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        int64_t t;
+        if (capture_timeline_parse_name(entry->d_name, &t)) {
+            capture_timeline_add(t);
+            seeded++;
+        }
+    }
+    closedir(d);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.seeded += seeded;
+    s_stats.seed_us = us;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "Counted %lu photos in %s (%lu us)", (unsigned long)seeded, dir, (unsigned long)us);
+    return ESP_OK;
+}
+
+void capture_timeline_query(int64_t from_s, uint32_t bucket_s, uint32_t *counts, size_t nbuckets){
+    int64_t first = from_s / CAPTURE_TIMELINE_SLOT_S;
+    uint32_t per_bucket = bucket_s / CAPTURE_TIMELINE_SLOT_S;
+    portENTER_CRITICAL(&s_lock);
+    int64_t oldest = s_head - CAPTURE_TIMELINE_SLOTS + 1;
+    for (size_t b = 0; b < nbuckets; b++) {
+        uint32_t sum = 0;
+        int64_t lo = first + (int64_t)b * per_bucket;
+        int64_t hi = lo + per_bucket - 1;
+        if (s_head >= 0 && hi >= oldest && lo <= s_head) {
+            if (lo < oldest) lo = oldest;
+            if (hi > s_head) hi = s_head;
+            for (int64_t slot = lo; slot <= hi; slot++) {
+                sum += s_counts[ring_index(slot)];
+            }
+        }
+        counts[b] = sum;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void capture_timeline_get_stats(capture_timeline_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    out->covered_from_s = s_head < 0 ? -1 : (s_head - CAPTURE_TIMELINE_SLOTS + 1) * CAPTURE_TIMELINE_SLOT_S;
+    out->covered_to_s = s_head < 0 ? -1 : (s_head + 1) * CAPTURE_TIMELINE_SLOT_S;
+    portEXIT_CRITICAL(&s_lock);
+}
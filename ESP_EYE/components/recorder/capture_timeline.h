@@ -0,0 +1,51 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Width of one counter in seconds; histogram buckets are whole multiples of it */
+#ifndef CAPTURE_TIMELINE_SLOT_S
+#define CAPTURE_TIMELINE_SLOT_S 300
+#endif
+
+/* Counters kept; older captures fall out of the ring (2016 x 5 min = 7 days) */
+#ifndef CAPTURE_TIMELINE_SLOTS
+#define CAPTURE_TIMELINE_SLOTS 2016
+#endif
+
+/* Captures stamped earlier than this (2020-01-01) were taken before the clock
+   was set by POST /time and carry the uptime, so they are not counted */
+#ifndef CAPTURE_TIMELINE_MIN_EPOCH_S
+#define CAPTURE_TIMELINE_MIN_EPOCH_S 1577836800
+#endif
+
+typedef struct {
+    int64_t covered_from_s;     // start of the oldest slot held, -1 while empty
+    int64_t covered_to_s;       // end of the newest slot held, -1 while empty
+    uint32_t added;             // captures counted
+    uint32_t too_old;           // captures older than the ring, not counted
+    uint32_t unsynced;          // captures before CAPTURE_TIMELINE_MIN_EPOCH_S, not counted
+    uint32_t seeded;            // photos counted from the store at startup
+    uint32_t seed_us;           // time taken by the startup scan
+} capture_timeline_stats_t;
+
+// Count a photo captured at `epoch_s`
+void capture_timeline_add(int64_t epoch_s);
+
+// Count the photos already in `dir` by their file names. Call once at startup.
+esp_err_t capture_timeline_seed(const char *dir);
+
+// Capture time encoded in a photo file name (YYYY-MM-DDxHH_MM_SS.jpg, UTC)
+bool capture_timeline_parse_name(const char *name, int64_t *epoch_s);
+
+/**
+ * Counts per bucket for [from_s, from_s + nbuckets * bucket_s). `from_s` must
+ * be a multiple of CAPTURE_TIMELINE_SLOT_S and `bucket_s` a positive multiple
+ * of it. Time outside the ring reads as 0.
+ */
+void capture_timeline_query(int64_t from_s, uint32_t bucket_s, uint32_t *counts, size_t nbuckets);
+
+// Snapshot of ring coverage and counters
+void capture_timeline_get_stats(capture_timeline_stats_t *out);
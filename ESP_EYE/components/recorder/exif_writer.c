@@ -0,0 +1,166 @@
+/**
+ * @file exif_writer.c
+ * @author xholanp00
+ * @brief Minimal EXIF APP1 segment builder (little-endian TIFF) for captured JPEGs
+ *
+ */
+
+#include "exif_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TIFF_ASCII 2
+#define TIFF_LONG 4
+#define TIFF_UNDEFINED 7
+
+#define TAG_IMAGE_DESCRIPTION 0x010E
+#define TAG_MODEL 0x0110
+#define TAG_EXIF_IFD_POINTER 0x8769
+#define TAG_DATETIME_ORIGINAL 0x9003
+#define TAG_USER_COMMENT 0x9286
+#define TAG_SUBSEC_TIME_ORIGINAL 0x9291
+
+/* APP1 marker, length and "Exif\0\0" precede the TIFF header */
+#define APP1_HEADER_LEN 10
+
+typedef struct {
+    uint16_t tag;
+    uint16_t type;
+    uint32_t count;
+    const void *data;   // NULL for an inline LONG held in `value`
+    uint32_t value;
+} exif_entry_t;
+
+static void put16(uint8_t *p, uint16_t v){
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v){
+    put16(p, v & 0xFFFF);
+    put16(p + 2, v >> 16);
+}
+
+static size_t ifd_size(int n){
+    return 2 + 12 * n + 4;
+}
+
+/* Bytes an entry needs outside the IFD (word aligned), 0 if its value fits inline */
+static size_t entry_data_size(const exif_entry_t *e){
+    size_t size = e->type == TIFF_LONG ? 4 * e->count : e->count;
+    if (!e->data || size <= 4) return 0;
+    return size + (size & 1);
+}
+
+/**
+ * @brief Serialize one IFD and its out-of-line values
+ *
+ * @param tiff Start of the TIFF header (offsets are relative to it)
+ * @param ifd_off Offset of the IFD
+ * @param entries Entries sorted by tag
+ * @param n Number of entries
+ * @param data_off Offset where out-of-line values go
+ * @return size_t Offset just past the written values
+ */
+static size_t write_ifd(uint8_t *tiff, size_t ifd_off, const exif_entry_t *entries, int n, size_t data_off){
+    uint8_t *p = tiff + ifd_off;
+    put16(p, n);
+    p += 2;
+    for (int i = 0; i < n; i++, p += 12) {
+        const exif_entry_t *e = &entries[i];
+        put16(p, e->tag);
+        put16(p + 2, e->type);
+        put32(p + 4, e->count);
+        memset(p + 8, 0, 4);
+        if (!e->data) {
+            put32(p + 8, e->value);
+        } else if (entry_data_size(e) == 0) {
+            memcpy(p + 8, e->data, e->count);
+        } else {
+            put32(p + 8, data_off);
+            memcpy(tiff + data_off, e->data, e->count);
+            if (e->count & 1) tiff[data_off + e->count] = 0;
+            data_off += entry_data_size(e);
+        }
+    }
+    put32(p, 0); // no next IFD
+    return data_off;
+}
+
+/**
+ * @brief Build an EXIF APP1 segment describing a capture
+ *
+ * @param meta Capture metadata
+ * @param out Destination buffer
+ * @param cap Destination capacity
+ * @return size_t Segment length including the FFE1 marker, 0 if it does not fit
+ */
+size_t exif_build_app1(const exif_meta_t *meta, uint8_t *out, size_t cap){
+    char description[40];
+    char model[24];
+    char datetime[20];
+    char subsec[4];
+    char comment[8 + 64];
+
+    snprintf(description, sizeof(description), "trigger=%s%s", meta->trigger ? meta->trigger : "unknown",
+             meta->duplicate ? " duplicate" : "");
+    snprintf(model, sizeof(model), "%s", meta->sensor ? meta->sensor : "unknown");
+
+    struct tm tm;
+    time_t sec = meta->captured.tv_sec;
+    localtime_r(&sec, &tm);
+    strftime(datetime, sizeof(datetime), "%Y:%m:%d %H:%M:%S", &tm);
+    snprintf(subsec, sizeof(subsec), "%03u", (unsigned)(meta->captured.tv_usec / 1000) % 1000u);
+
+    /* UserComment starts with an 8-byte character code; ASCII text follows unterminated */
+    memcpy(comment, "ASCII\0\0\0", 8);
+    int text_len = snprintf(comment + 8, sizeof(comment) - 8, "exposure_lines=%lu gain=%lu.%02lu",
+                            (unsigned long)meta->exposure_lines,
+                            (unsigned long)(meta->gain_x100 / 100), (unsigned long)(meta->gain_x100 % 100));
+    if (text_len < 0) text_len = 0;
+    if (text_len > (int)sizeof(comment) - 9) text_len = sizeof(comment) - 9;
+
+    exif_entry_t ifd0[] = {
+        { TAG_IMAGE_DESCRIPTION, TIFF_ASCII, strlen(description) + 1, description, 0 },
+        { TAG_MODEL, TIFF_ASCII, strlen(model) + 1, model, 0 },
+        { TAG_EXIF_IFD_POINTER, TIFF_LONG, 1, NULL, 0 },
+    };
+    exif_entry_t exif_ifd[] = {
+        { TAG_DATETIME_ORIGINAL, TIFF_ASCII, strlen(datetime) + 1, datetime, 0 },
+        { TAG_USER_COMMENT, TIFF_UNDEFINED, 8 + text_len, comment, 0 },
+        { TAG_SUBSEC_TIME_ORIGINAL, TIFF_ASCII, strlen(subsec) + 1, subsec, 0 },
+    };
+    const int n0 = sizeof(ifd0) / sizeof(ifd0[0]);
+    const int n1 = sizeof(exif_ifd) / sizeof(exif_ifd[0]);
+
+    size_t ifd0_off = 8;
+    size_t ifd0_data = ifd0_off + ifd_size(n0);
+    size_t exif_off = ifd0_data;
+    for (int i = 0; i < n0; i++) exif_off += entry_data_size(&ifd0[i]);
+    size_t exif_data = exif_off + ifd_size(n1);
+    size_t tiff_len = exif_data;
+    for (int i = 0; i < n1; i++) tiff_len += entry_data_size(&exif_ifd[i]);
+
+    size_t total = APP1_HEADER_LEN + tiff_len;
+    if (total > cap || total - 2 > 0xFFFF) {
+        return 0;
+    }
+    ifd0[n0 - 1].value = exif_off;
+
+    out[0] = 0xFF;
+    out[1] = 0xE1;
+    out[2] = (total - 2) >> 8;  // segment length is big-endian like every JPEG marker
+    out[3] = (total - 2) & 0xFF;
+    memcpy(out + 4, "Exif\0\0", 6);
+
+    uint8_t *tiff = out + APP1_HEADER_LEN;
+    tiff[0] = 'I';
+    tiff[1] = 'I';
+    put16(tiff + 2, 0x002A);
+    put32(tiff + 4, ifd0_off);
+    write_ifd(tiff, ifd0_off, ifd0, n0, ifd0_data);
+    write_ifd(tiff, exif_off, exif_ifd, n1, exif_data);
+    return total;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+/* Upper bound of the APP1 segment produced by exif_build_app1() */
+#define EXIF_APP1_MAX 320
+
+typedef struct {
+    struct timeval captured;    // wall-clock time of the frame
+    const char *trigger;        // trigger source, e.g. "pir" or "ui"
+    const char *sensor;         // sensor model name
+    uint32_t exposure_lines;    // AEC exposure in sensor line periods
+    uint32_t gain_x100;         // analog gain multiplied by 100
+    bool duplicate;             // near-duplicate of the previous photo from this trigger
+} exif_meta_t;
+
+// Build a complete EXIF APP1 segment (marker included). Returns its length, 0 if it does not fit.
+size_t exif_build_app1(const exif_meta_t *meta, uint8_t *out, size_t cap);
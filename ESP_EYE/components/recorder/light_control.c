@@ -0,0 +1,185 @@
+/**
+ * @file light_control.c
+ * @author xholanp00
+ * @brief Day/night sensor presets and PWM flash LED driven by the sensor's exposure estimate
+ *
+ */
+
+#include "light_control.h"
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "driver/ledc.h"
+#endif
+
+static const char *TAG = "light_control"; // Tag for logging
+
+/* The camera XCLK owns LEDC timer 0 / channel 0 */
+#define LED_LEDC_MODE LEDC_LOW_SPEED_MODE
+#define LED_LEDC_TIMER LEDC_TIMER_1
+#define LED_LEDC_CHANNEL LEDC_CHANNEL_1
+#define LED_PWM_FREQ_HZ 5000
+#define LED_DUTY_MAX 255
+
+/* Exposure value = exposure lines * gain. Entering night needs a darker scene
+   than leaving it so the mode does not flap around the threshold. */
+#ifndef LIGHT_NIGHT_ENTER_EV
+#define LIGHT_NIGHT_ENTER_EV 2400
+#endif
+
+#ifndef LIGHT_NIGHT_EXIT_EV
+#define LIGHT_NIGHT_EXIT_EV 800
+#endif
+
+/* Exposure value at which the LED reaches full duty */
+#ifndef LIGHT_LED_FULL_EV
+#define LIGHT_LED_FULL_EV 9600
+#endif
+
+/* Lowest duty used when the LED is on at all */
+#ifndef LIGHT_LED_MIN_DUTY
+#define LIGHT_LED_MIN_DUTY 48
+#endif
+
+static bool s_led_ready = false;
+static int64_t s_led_on_since_us = 0;
+static light_control_stats_t s_stats = {0};
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void apply_day_preset(sensor_t *s){
+    s->set_aec2(s, 0);
+    s->set_gainceiling(s, GAINCEILING_2X);
+}
+
+static void apply_night_preset(sensor_t *s){
+    /* DSP night mode lets AEC stretch exposure; allow more analog gain */
+    s->set_aec2(s, 1);
+    s->set_gainceiling(s, GAINCEILING_16X);
+}
+
+/**
+ * @brief Configure the LED output
+ *
+ * @param gpio LED GPIO, negative to run without LED
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t light_control_init(int gpio){
+    if (gpio < 0) {
+        s_led_ready = false;
+        return ESP_OK;
+    }
+#if CONFIG_IDF_TARGET_LINUX
+    /* Host build: nothing to drive, duty and on-time are still tracked */
+    ESP_LOGI(TAG, "LED on GPIO %d is simulated", gpio);
+#else
+    ledc_timer_config_t timer = {
+        .speed_mode = LED_LEDC_MODE,
+        .duty_resolution = LEDC_TIMER_8_BIT,
+        .timer_num = LED_LEDC_TIMER,
+        .freq_hz = LED_PWM_FREQ_HZ,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    esp_err_t err = ledc_timer_config(&timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "LED timer config failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    ledc_channel_config_t channel = {
+        .gpio_num = gpio,
+        .speed_mode = LED_LEDC_MODE,
+        .channel = LED_LEDC_CHANNEL,
+        .timer_sel = LED_LEDC_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    err = ledc_channel_config(&channel);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "LED channel config failed: %s", esp_err_to_name(err));
+        return err;
+    }
+#endif
+    s_led_ready = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Update the light estimate and pick the LED duty for the next capture
+ *
+ * @param s Sensor handle (may be NULL)
+ * @param exposure_lines Current AEC exposure in line periods
+ * @param gain_x100 Current analog gain multiplied by 100
+ * @return uint32_t LED duty (0 = no flash)
+ */
+uint32_t light_control_update(sensor_t *s, uint32_t exposure_lines, uint32_t gain_x100){
+    uint32_t ev = exposure_lines * gain_x100 / 100;
+
+    portENTER_CRITICAL(&s_stats_lock);
+    bool was_night = s_stats.night;
+    bool night = was_night ? ev > LIGHT_NIGHT_EXIT_EV : ev >= LIGHT_NIGHT_ENTER_EV;
+    s_stats.night = night;
+    s_stats.exposure_value = ev;
+    if (night != was_night) s_stats.mode_switches++;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    if (night != was_night) {
+        ESP_LOGI(TAG, "Switching to %s preset (ev=%lu)", night ? "night" : "day", (unsigned long)ev);
+        if (s) {
+            if (night) apply_night_preset(s); else apply_day_preset(s);
+        }
+    }
+
+    uint32_t duty = 0;
+    if (night && s_led_ready) {
+        /* Scale linearly from the night threshold up to full brightness */
+        uint32_t span = LIGHT_LED_FULL_EV - LIGHT_NIGHT_EXIT_EV;
+        uint32_t above = ev > LIGHT_NIGHT_EXIT_EV ? ev - LIGHT_NIGHT_EXIT_EV : 0;
+        duty = above >= span ? LED_DUTY_MAX : LED_DUTY_MAX * above / span;
+        if (duty < LIGHT_LED_MIN_DUTY) duty = LIGHT_LED_MIN_DUTY;
+    }
+    return duty;
+}
+
+/**
+ * @brief Set the LED brightness
+ *
+ * @param duty Duty 0..255, 0 turns the LED off
+ */
+void light_control_led_set(uint32_t duty){
+    if (!s_led_ready) return;
+    if (duty > LED_DUTY_MAX) duty = LED_DUTY_MAX;
+#if !CONFIG_IDF_TARGET_LINUX
+    ledc_set_duty(LED_LEDC_MODE, LED_LEDC_CHANNEL, duty);
+    ledc_update_duty(LED_LEDC_MODE, LED_LEDC_CHANNEL);
+#endif
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_lock);
+    if (duty) {
+        if (!s_led_on_since_us) {
+            s_led_on_since_us = now;
+            s_stats.led_flashes++;
+        }
+        s_stats.led_duty = duty;
+    } else if (s_led_on_since_us) {
+        uint32_t on_us = (uint32_t)(now - s_led_on_since_us);
+        s_stats.led_on_us_total += on_us;
+        if (on_us > s_stats.led_on_us_max) s_stats.led_on_us_max = on_us;
+        s_led_on_since_us = 0;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+/**
+ * @brief Copy the light control state
+ *
+ * @param out Destination
+ */
+void light_control_get_stats(light_control_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_camera.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    bool night;                 // night preset active
+    uint32_t exposure_value;    // last exposure_lines * gain estimate
+    uint32_t led_duty;          // duty used for the last capture (0..255)
+    uint32_t mode_switches;
+    uint32_t led_flashes;
+    uint64_t led_on_us_total;
+    uint32_t led_on_us_max;
+} light_control_stats_t;
+
+// Configure the flash LED on `gpio` as a LEDC PWM output. A negative gpio disables the LED.
+esp_err_t light_control_init(int gpio);
+
+// Feed the current exposure estimate; switches day/night presets and returns the LED duty for the next capture.
+uint32_t light_control_update(sensor_t *s, uint32_t exposure_lines, uint32_t gain_x100);
+
+// Drive the LED at `duty` (0 turns it off). On-time is accumulated in the stats.
+void light_control_led_set(uint32_t duty);
+
+// Snapshot of light control state and LED counters
+void light_control_get_stats(light_control_stats_t *out);
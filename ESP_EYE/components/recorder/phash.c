@@ -0,0 +1,88 @@
+/**
+ * @file phash.c
+ * @author xholanp00
+ * @brief Cheap perceptual hash of captured JPEGs used to spot near-identical frames
+ *
+ */
+
+#include "phash.h"
+
+#include <stdlib.h>
+#include "jpeg_decoder.h"
+#include "mem_tags.h"
+
+/* dHash compares horizontally adjacent cells of a 9x8 luminance grid */
+#define GRID_W 9
+#define GRID_H 8
+
+/**
+ * @brief Compute the dHash of a JPEG
+ *
+ * Only the DC coefficients are needed for a 1/8-scale decode, so this costs
+ * a small fraction of a full decode (80x60 pixels for a VGA frame).
+ *
+ * @param jpg JPEG data
+ * @param len JPEG length
+ * @param out Receives the hash
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t phash_dhash_jpeg(const uint8_t *jpg, size_t len, uint64_t *out){
+    if (!jpg || !len || !out) return ESP_ERR_INVALID_ARG;
+
+    esp_jpeg_image_cfg_t cfg = {
+        .indata = (uint8_t *)jpg,
+        .indata_size = len,
+        .out_format = JPEG_IMAGE_FORMAT_RGB565,
+        .out_scale = JPEG_IMAGE_SCALE_1_8,
+    };
+    esp_jpeg_image_output_t info = {0};
+    esp_err_t err = esp_jpeg_get_image_info(&cfg, &info);
+    if (err != ESP_OK) return err;
+
+    int w = info.width / 8;
+    int h = info.height / 8;
+    if (w < GRID_W || h < GRID_H) return ESP_ERR_INVALID_SIZE;
+
+    size_t px_len = (size_t)((info.width + 7) / 8) * ((info.height + 7) / 8) * 2;
+    uint16_t *px = mem_tags_alloc(MEM_TAG_PHASH, px_len);
+    if (!px) return ESP_ERR_NO_MEM;
+    cfg.outbuf = (uint8_t *)px;
+    cfg.outbuf_size = px_len;
+    err = esp_jpeg_decode(&cfg, &info);
+    if (err != ESP_OK) {
+        mem_tags_free(px);
+        return err;
+    }
+
+    /* Box-average luminance into the grid */
+    uint32_t grid[GRID_H][GRID_W];
+    for (int gy = 0; gy < GRID_H; gy++) {
+        int y0 = gy * h / GRID_H, y1 = (gy + 1) * h / GRID_H;
+        for (int gx = 0; gx < GRID_W; gx++) {
+            int x0 = gx * w / GRID_W, x1 = (gx + 1) * w / GRID_W;
+            uint32_t sum = 0;
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    uint16_t p = px[y * w + x];
+                    uint32_t r = (p >> 11) & 0x1F, g = (p >> 5) & 0x3F, b = p & 0x1F;
+                    sum += (r << 3) * 77 + (g << 2) * 150 + (b << 3) * 29;
+                }
+            }
+            grid[gy][gx] = sum / ((x1 - x0) * (y1 - y0));
+        }
+    }
+    mem_tags_free(px);
+
+    uint64_t hash = 0;
+    for (int gy = 0; gy < GRID_H; gy++) {
+        for (int gx = 0; gx < GRID_W - 1; gx++) {
+            hash = (hash << 1) | (grid[gy][gx] < grid[gy][gx + 1]);
+        }
+    }
+    *out = hash;
+    return ESP_OK;
+}
+
+int phash_distance(uint64_t a, uint64_t b){
+    return __builtin_popcountll(a ^ b);
+}
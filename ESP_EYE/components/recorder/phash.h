@@ -0,0 +1,11 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit difference hash (dHash) of a JPEG, computed from a 1/8-scale decode.
+esp_err_t phash_dhash_jpeg(const uint8_t *jpg, size_t len, uint64_t *out);
+
+// Number of differing bits between two hashes
+int phash_distance(uint64_t a, uint64_t b);
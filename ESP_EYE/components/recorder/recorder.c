@@ -6,23 +6,111 @@
  */
 
 #include "recorder.h"
+#include "node_profile.h"
 
 
 static const char *TAG = "recorder"; // Tag for logging
 
-// Capture queue and worker task handle
-static QueueHandle_t s_capture_queue = NULL;
+// Capture worker task handle; requests live in the capture_queue slot table
 static TaskHandle_t s_capture_worker = NULL;
 
 #ifndef RECORDER_LED_GPIO
 #define RECORDER_LED_GPIO 4
 #endif
 
-#ifndef RECORDER_WORKER_PRIORITY
-#define RECORDER_WORKER_PRIORITY (tskIDLE_PRIORITY + 5)
+/* Captures whose dHash is within this many bits of the last kept photo from
+   the same trigger source count as duplicates. Negative disables dedup. */
+#ifndef RECORDER_DEDUP_THRESHOLD
+#define RECORDER_DEDUP_THRESHOLD 5
 #endif
 
-static bool recorder_led_configured = false;
+/* 1: duplicates are not written; 0: they are written and tagged in EXIF */
+#ifndef RECORDER_DEDUP_DROP
+#define RECORDER_DEDUP_DROP 1
+#endif
+
+/* Trigger source that is never deduplicated: a user pressing Take photo twice wants two photos */
+#ifndef RECORDER_DEDUP_SKIP_TRIGGER
+#define RECORDER_DEDUP_SKIP_TRIGGER "ui"
+#endif
+
+/* Number of trigger sources tracked for dedup */
+#define RECORDER_DEDUP_SOURCES 4
+
+/* Dropped duplicates remembered so their advertised name still resolves */
+#ifndef RECORDER_DEDUP_ALIASES
+#define RECORDER_DEDUP_ALIASES 16
+#endif
+
+/* Frames discarded after the LED comes on: the newest buffered frame may
+   have been exposed before the flash */
+#ifndef RECORDER_LED_SETTLE_FRAMES
+#define RECORDER_LED_SETTLE_FRAMES 1
+#endif
+
+/* How long a capture waits for the camera watchdog to finish a re-init */
+#ifndef RECORDER_CAMERA_WAIT_MS
+#define RECORDER_CAMERA_WAIT_MS 10000
+#endif
+
+/* JPEG quality captures are held to while memory is short
+   (MEM_PRESSURE_CAPTURE_LOW); higher is coarser and smaller */
+#ifndef RECORDER_PRESSURE_QUALITY
+#define RECORDER_PRESSURE_QUALITY 45
+#endif
+
+/* Most frames discarded because they were buffered before the node woke from
+   light sleep (the camera DMA stops while it sleeps) */
+#ifndef RECORDER_STALE_FRAMES_MAX
+#define RECORDER_STALE_FRAMES_MAX 3
+#endif
+
+/* Hash of the last kept photo per trigger source */
+typedef struct {
+    char trigger[RECORDER_TRIGGER_MAX];
+    char kept[PHOTO_CACHE_ID_MAX];    // name of that photo
+    uint64_t hash;
+    bool valid;
+} dedup_slot_t;
+
+/* A dropped duplicate and the kept photo it duplicates */
+typedef struct {
+    char name[PHOTO_CACHE_ID_MAX];
+    char kept[PHOTO_CACHE_ID_MAX];
+} dedup_alias_t;
+
+static dedup_slot_t s_dedup_slots[RECORDER_DEDUP_SOURCES];
+static int s_dedup_next_slot = 0;
+static dedup_alias_t s_dedup_aliases[RECORDER_DEDUP_ALIASES];
+static int s_dedup_next_alias = 0;
+static recorder_dedup_stats_t s_dedup_stats = {0};
+static portMUX_TYPE s_dedup_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static recorder_latency_stats_t s_latency_stats = {0};
+static portMUX_TYPE s_latency_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* One contiguous piece of the output file */
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+} write_seg_t;
+
+static esp_err_t capture_guarded(const char *filepath, framesize_t frame_size, int jpeg_quality,
+                                 const char *trigger, int64_t *grabbed_us, bool *dropped);
+
+/**
+ * @brief Account one trigger-to-capture latency
+ * 
+ * @param us Enqueue to frame in hand
+ */
+static void latency_add(uint32_t us){
+    portENTER_CRITICAL(&s_latency_lock);
+    s_latency_stats.captures++;
+    s_latency_stats.trigger_us_total += us;
+    s_latency_stats.trigger_us_last = us;
+    if (us > s_latency_stats.trigger_us_max) s_latency_stats.trigger_us_max = us;
+    portEXIT_CRITICAL(&s_latency_lock);
+}
 
 /**
  * @brief Capture worker task
@@ -32,96 +120,58 @@ static bool recorder_led_configured = false;
 static void capture_worker_task(void *arg){
     (void)arg;
     for (;;) {
-        char *path = NULL;
-        if (xQueueReceive(s_capture_queue, &path, portMAX_DELAY) == pdTRUE) {
-            if (path) {
-                esp_err_t res = recorder_capture_to_file(path, FRAMESIZE_VGA, 30);
-                if (res != ESP_OK) {
-                    ESP_LOGE(TAG, "Capture failed: %s", path);
-                }
-                free(path);
-            }
+        capture_request_t req;
+        int slot = capture_queue_pop(&req, portMAX_DELAY);
+        if (slot < 0) {
+            continue;
+        }
+        /* Under heavy memory pressure a coarser photo beats a lost one */
+        int quality = req.jpeg_quality;
+        if (mem_pressure_level() >= MEM_PRESSURE_CAPTURE_LOW && quality < RECORDER_PRESSURE_QUALITY) {
+            quality = RECORDER_PRESSURE_QUALITY;
+            mem_pressure_note(MEM_PRESSURE_CAPTURE_LOW);
         }
+        TRACE_BEGIN("capture");
+        int64_t grabbed_us = 0;
+        bool dropped = false;
+        esp_err_t res = capture_guarded(req.path, req.frame_size, quality, req.trigger, &grabbed_us, &dropped);
+        TRACE_END("capture");
+        capture_outcome_t outcome = CAPTURE_DONE_OK;
+        if (res != ESP_OK) {
+            ESP_LOGE(TAG, "Capture #%lu failed (%s): %s", (unsigned long)req.seq, esp_err_to_name(res), req.path);
+            outcome = CAPTURE_DONE_FAILED;
+        } else if (dropped) {
+            ESP_LOGI(TAG, "Capture #%lu dropped as a duplicate: %s", (unsigned long)req.seq, req.path);
+            outcome = CAPTURE_DONE_DUPLICATE;
+        }
+        if (grabbed_us) {
+            latency_add((uint32_t)(grabbed_us - req.enqueued_us));
+        }
+        capture_queue_done(slot, outcome);
+        /* Taken by recorder_enqueue_capture() */
+        power_ctl_release(POWER_LOCK_CAPTURE);
     }
 }
 
 
-/**
- * @brief Primary camera configuration (XGA)
- * 
- */
-static camera_config_t camera_config_primary = {
-    .pin_pwdn = 32,
-    .pin_reset = -1,
-    .pin_xclk = 0,
-    .pin_sccb_sda = 26,
-    .pin_sccb_scl = 27,
-    .pin_d7 = 35,
-    .pin_d6 = 34,
-    .pin_d5 = 39,
-    .pin_d4 = 36,
-    .pin_d3 = 21,
-    .pin_d2 = 19,
-    .pin_d1 = 18,
-    .pin_d0 = 5,
-    .pin_vsync = 25,
-    .pin_href = 23,
-    .pin_pclk = 22,
-    .xclk_freq_hz = 20000000,
-    .ledc_timer = LEDC_TIMER_0,
-    .ledc_channel = LEDC_CHANNEL_0,
-    .pixel_format = PIXFORMAT_JPEG,
-    .frame_size = FRAMESIZE_XGA,
-    .jpeg_quality = 12,
-    .fb_count = 2,
-    .fb_location = CAMERA_FB_IN_PSRAM,
-    .grab_mode = CAMERA_GRAB_LATEST
-};
-
-/**
- * @brief Fallback camera configuration (VGA)
- * 
- */
-static camera_config_t camera_config_fallback = {
-    .pin_pwdn = 32,
-    .pin_reset = -1,
-    .pin_xclk = 0,
-    .pin_sccb_sda = 26,
-    .pin_sccb_scl = 27,
-    .pin_d7 = 35,
-    .pin_d6 = 34,
-    .pin_d5 = 39,
-    .pin_d4 = 36,
-    .pin_d3 = 21,
-    .pin_d2 = 19,
-    .pin_d1 = 18,
-    .pin_d0 = 5,
-    .pin_vsync = 25,
-    .pin_href = 23,
-    .pin_pclk = 22,
-    .xclk_freq_hz = 20000000,
-    .ledc_timer = LEDC_TIMER_0,
-    .ledc_channel = LEDC_CHANNEL_0,
-    .pixel_format = PIXFORMAT_JPEG,
-    .frame_size = FRAMESIZE_VGA,
-    .jpeg_quality = 12,
-    .fb_count = 2,
-    .fb_location = CAMERA_FB_IN_PSRAM,
-    .grab_mode = CAMERA_GRAB_LATEST
-};
-
 /**
  * @brief Start the recorder worker task
  * 
  */
 static void recorder_start_worker(void){
-    if (!s_capture_queue) {
-        s_capture_queue = xQueueCreate(8, sizeof(char *));
-        if (!s_capture_queue) {
-            ESP_LOGE(TAG, "Failed to create capture queue");
+    if (!s_capture_worker) {
+        if (capture_queue_init() != ESP_OK) {
+            return;
+        }
+        if (task_plan_create(TASK_PLAN_RECORDER, capture_worker_task, NULL, &s_capture_worker) != ESP_OK) {
             return;
         }
-        xTaskCreate(capture_worker_task, "rec_cap_worker", 12288, NULL, RECORDER_WORKER_PRIORITY, &s_capture_worker);
+        /* A stored priority overrides the task plan (applied at start-up only) */
+        int32_t prio = settings_get(SETTING_RECORDER_PRIORITY);
+        if (prio > 0) {
+            vTaskPrioritySet(s_capture_worker, prio);
+            ESP_LOGI(TAG, "Capture worker priority %ld (settings)", (long)prio);
+        }
     }
 }
 
@@ -132,72 +182,23 @@ static void recorder_start_worker(void){
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
 esp_err_t recorder_init(void){
-    // Try primary camera configuration first
-    esp_err_t err = esp_camera_init(&camera_config_primary);
-    // Apply sensor tuning
-    if (err == ESP_OK) {
-        
-        sensor_t * s = esp_camera_sensor_get();
-        s->set_brightness(s, 0);
-        s->set_contrast(s, 0);
-        s->set_saturation(s, 0);
-        s->set_whitebal(s, 1);
-        s->set_awb_gain(s, 1);
-        s->set_wb_mode(s, 0);
-        s->set_exposure_ctrl(s, 1);
-        s->set_aec2(s, 0);
-        s->set_ae_level(s, 0);
-        s->set_aec_value(s, 300);
-        s->set_gain_ctrl(s, 1);
-        s->set_agc_gain(s, 0);
-        s->set_gainceiling(s, (gainceiling_t)0);
-        s->set_bpc(s, 0);
-        s->set_wpc(s, 1);
-        s->set_raw_gma(s, 1);
-        s->set_lenc(s, 1);
-        s->set_hmirror(s, 0);
-        s->set_vflip(s, 0);
-        s->set_dcw(s, 1);
-
-        /* Configure optional LED GPIO (primary init path) */
-        if (RECORDER_LED_GPIO >= 0) {
-            gpio_reset_pin(RECORDER_LED_GPIO);
-            gpio_set_direction(RECORDER_LED_GPIO, GPIO_MODE_OUTPUT);
-            gpio_set_level(RECORDER_LED_GPIO, 0);
-            recorder_led_configured = true;
-        }
-
-        recorder_start_worker();
-        return ESP_OK;
-    }
-
-    ESP_LOGW(TAG, "Primary camera init failed, trying VGA fallback");
-
-    err = esp_camera_init(&camera_config_fallback);
+    esp_err_t err = camera_profile_start();
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Fallback camera init failed: %s", esp_err_to_name(err));
         return err;
     }
 
-    ESP_LOGI(TAG, "Camera initialized with fallback config (VGA)");
-    
-    // Apply sensor tuning
-    sensor_t * s = esp_camera_sensor_get();
-    s->set_whitebal(s, 1);
-    s->set_awb_gain(s, 1);
-    s->set_exposure_ctrl(s, 1);
-    s->set_gain_ctrl(s, 1);
-    s->set_lenc(s, 1);
+    /* Flash LED is PWM driven and only used when the scene is dark */
+    light_control_init(RECORDER_LED_GPIO);
 
-    /* Configure optional LED GPIO (fallback init path) */
-    if (RECORDER_LED_GPIO >= 0) {
-        gpio_reset_pin(RECORDER_LED_GPIO);
-        gpio_set_direction(RECORDER_LED_GPIO, GPIO_MODE_OUTPUT);
-        gpio_set_level(RECORDER_LED_GPIO, 0);
-        recorder_led_configured = true;
+    /* Re-initialises the camera in place if it wedges */
+    if (camera_guard_init(camera_profile_start) != ESP_OK) {
+        ESP_LOGW(TAG, "Camera watchdog unavailable");
     }
 
-    recorder_start_worker();
+    /* Stream-only builds take no triggered photos and run no worker */
+    if (NODE_HAS_CAPTURE) {
+        recorder_start_worker();
+    }
     return ESP_OK;
 }
 
@@ -218,27 +219,315 @@ esp_err_t recorder_deinit(void){
 /**
  * @brief Enqueue a capture request
  * 
- * @param filepath Path to save the captured image
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @param filepath Path to save the captured image (copied into the request)
+ * @param requested_ms Epoch ms the trigger asked for, 0 if unknown
+ * @param trigger Trigger source recorded with the photo (may be NULL)
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NO_MEM when the queue is full, error code otherwise
  */
-esp_err_t recorder_enqueue_capture(char *filepath){
+esp_err_t recorder_enqueue_capture(const char *filepath, uint64_t requested_ms, const char *trigger){
     if (!filepath) return ESP_ERR_INVALID_ARG;
-    if (!s_capture_queue) return ESP_ERR_INVALID_STATE;
-    if (xQueueSend(s_capture_queue, &filepath, pdMS_TO_TICKS(100)) != pdTRUE) {
-        return ESP_FAIL;
+    capture_request_t req = {
+        .requested_ms = requested_ms,
+        .frame_size = settings_get(SETTING_CAPTURE_FRAMESIZE),
+        .jpeg_quality = settings_get(SETTING_CAPTURE_QUALITY),
+    };
+    if (strlcpy(req.path, filepath, sizeof(req.path)) >= sizeof(req.path)) {
+        ESP_LOGE(TAG, "Capture path too long: %s", filepath);
+        return ESP_ERR_INVALID_SIZE;
     }
-    return ESP_OK;
+    strlcpy(req.trigger, trigger ? trigger : "unknown", sizeof(req.trigger));
+    /* Full speed from the trigger until the worker is done with it */
+    power_ctl_acquire(POWER_LOCK_CAPTURE);
+    esp_err_t err = capture_queue_push(&req, pdMS_TO_TICKS(100));
+    if (err != ESP_OK) {
+        power_ctl_release(POWER_LOCK_CAPTURE);
+    }
+    return err;
 }
 
 /**
- * @brief Capture an image to a file
+ * @brief Write a list of buffers to a file back to back
+ * 
+ * @param f Open file
+ * @param segs Buffers to write
+ * @param nsegs Number of buffers
+ * @return size_t Total bytes written
+ */
+static size_t write_segments(FILE *f, const write_seg_t *segs, int nsegs){
+    size_t total = 0;
+    for (int i = 0; i < nsegs; i++) {
+        if (segs[i].len == 0) continue;
+        size_t w = fwrite(segs[i].data, 1, segs[i].len, f);
+        total += w;
+        if (w != segs[i].len) break;
+    }
+    return total;
+}
+
+/**
+ * @brief Name of the attached sensor model
+ * 
+ * @param s Sensor handle (may be NULL)
+ * @return const char* Model name
+ */
+static const char *sensor_name(sensor_t *s){
+    if (!s) return "unknown";
+    camera_sensor_info_t *info = esp_camera_sensor_get_info(&s->id);
+    return (info && info->name) ? info->name : "unknown";
+}
+
+/**
+ * @brief Read the exposure and gain the sensor used for the last frame
+ * 
+ * @param s Sensor handle (may be NULL)
+ * @param meta Receives exposure_lines and gain_x100
+ */
+static void read_exposure(sensor_t *s, exif_meta_t *meta){
+    if (!s) return;
+    if (s->id.PID == OV2640_PID && s->get_reg) {
+        /* Sensor bank (0x1xx): AEC[15:10] in 0x45, AEC[9:2] in 0x10, AEC[1:0] in 0x04; gain in 0x00 */
+        int aec_hi = s->get_reg(s, 0x145, 0x3F);
+        int aec_mid = s->get_reg(s, 0x110, 0xFF);
+        int aec_lo = s->get_reg(s, 0x104, 0x03);
+        int gain = s->get_reg(s, 0x100, 0xFF);
+        if (aec_hi >= 0 && aec_mid >= 0 && aec_lo >= 0 && gain >= 0) {
+            meta->exposure_lines = ((uint32_t)aec_hi << 10) | ((uint32_t)aec_mid << 2) | (uint32_t)aec_lo;
+            uint32_t mult = (((gain >> 7) & 1) + 1) * (((gain >> 6) & 1) + 1) * (((gain >> 5) & 1) + 1) * (((gain >> 4) & 1) + 1);
+            meta->gain_x100 = mult * (16 + (gain & 0x0F)) * 100 / 16;
+            return;
+        }
+    }
+    /* Other sensors: report the configured manual values */
+    meta->exposure_lines = s->status.aec_value;
+    meta->gain_x100 = (s->status.agc_gain + 1) * 100;
+}
+
+static dedup_slot_t *dedup_slot_for(const char *trigger){
+    for (int i = 0; i < RECORDER_DEDUP_SOURCES; i++) {
+        if (s_dedup_slots[i].valid && strcmp(s_dedup_slots[i].trigger, trigger) == 0) {
+            return &s_dedup_slots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Hash a frame and compare it with the last kept photo of the same source
+ * 
+ * @param jpg JPEG data
+ * @param len JPEG length
+ * @param trigger Trigger source
+ * @param hash Receives the frame hash
+ * @param kept Receives the name of the photo it duplicates
+ * @param kept_len Size of `kept`
+ * @return true if the frame is a near-duplicate
+ */
+static bool dedup_check(const uint8_t *jpg, size_t len, const char *trigger, uint64_t *hash,
+                        char *kept, size_t kept_len){
+    TRACE_BEGIN("phash");
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = phash_dhash_jpeg(jpg, len, hash);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    TRACE_END("phash");
+
+    bool duplicate = false;
+    int distance = -1;
+    portENTER_CRITICAL(&s_dedup_lock);
+    if (err != ESP_OK) {
+        s_dedup_stats.hash_failures++;
+    } else {
+        s_dedup_stats.hashed++;
+        s_dedup_stats.hash_us_total += us;
+        if (us > s_dedup_stats.hash_us_max) s_dedup_stats.hash_us_max = us;
+        dedup_slot_t *slot = dedup_slot_for(trigger);
+        if (slot) {
+            distance = phash_distance(slot->hash, *hash);
+            duplicate = distance <= RECORDER_DEDUP_THRESHOLD;
+            if (duplicate) strlcpy(kept, slot->kept, kept_len);
+        }
+        if (duplicate) {
+            if (RECORDER_DEDUP_DROP) s_dedup_stats.dropped++; else s_dedup_stats.marked++;
+        } else {
+            s_dedup_stats.unique++;
+        }
+    }
+    portEXIT_CRITICAL(&s_dedup_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Perceptual hash failed: %s", esp_err_to_name(err));
+    } else if (duplicate) {
+        ESP_LOGI(TAG, "Duplicate of last %s capture (distance %d, %lu us)", trigger, distance, (unsigned long)us);
+    }
+    return duplicate;
+}
+
+/**
+ * @brief Remember the hash of a kept photo as the reference for its source
+ * 
+ * @param trigger Trigger source
+ * @param hash Photo hash
+ * @param name Photo name
+ */
+static void dedup_remember(const char *trigger, uint64_t hash, const char *name){
+    portENTER_CRITICAL(&s_dedup_lock);
+    dedup_slot_t *slot = dedup_slot_for(trigger);
+    if (!slot) {
+        slot = &s_dedup_slots[s_dedup_next_slot];
+        s_dedup_next_slot = (s_dedup_next_slot + 1) % RECORDER_DEDUP_SOURCES;
+        strlcpy(slot->trigger, trigger, sizeof(slot->trigger));
+        slot->valid = true;
+    }
+    slot->hash = hash;
+    strlcpy(slot->kept, name, sizeof(slot->kept));
+    portEXIT_CRITICAL(&s_dedup_lock);
+}
+
+/**
+ * @brief Point a dropped duplicate's name at the photo it duplicates
+ *
+ * The trigger was already answered with the dropped name; without this the
+ * client's download of it would fail.
+ *
+ * @param name Name that was not written
+ * @param kept Name of the kept photo (empty to forget `name`, which now exists)
+ */
+static void dedup_alias(const char *name, const char *kept){
+    portENTER_CRITICAL(&s_dedup_lock);
+    dedup_alias_t *alias = NULL;
+    for (int i = 0; i < RECORDER_DEDUP_ALIASES; i++) {
+        if (strcmp(s_dedup_aliases[i].name, name) == 0) {
+            alias = &s_dedup_aliases[i];
+            break;
+        }
+    }
+    if (!alias && kept[0]) {
+        alias = &s_dedup_aliases[s_dedup_next_alias];
+        s_dedup_next_alias = (s_dedup_next_alias + 1) % RECORDER_DEDUP_ALIASES;
+    }
+    if (alias) {
+        strlcpy(alias->name, kept[0] ? name : "", sizeof(alias->name));
+        strlcpy(alias->kept, kept, sizeof(alias->kept));
+    }
+    portEXIT_CRITICAL(&s_dedup_lock);
+}
+
+/**
+ * @brief Look up a photo name dropped as a duplicate
+ *
+ * @param name Photo name
+ * @param kept Receives the name of the kept photo it duplicates
+ * @param kept_len Size of `kept`
+ * @return true if `name` was dropped and is still remembered
+ */
+bool recorder_duplicate_of(const char *name, char *kept, size_t kept_len){
+    if (!name || !name[0] || !kept || kept_len == 0) return false;
+    bool found = false;
+    portENTER_CRITICAL(&s_dedup_lock);
+    for (int i = 0; i < RECORDER_DEDUP_ALIASES; i++) {
+        if (strcmp(s_dedup_aliases[i].name, name) == 0) {
+            strlcpy(kept, s_dedup_aliases[i].kept, kept_len);
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_dedup_lock);
+    return found;
+}
+
+/**
+ * @brief Copy the dedup counters
+ * 
+ * @param out Destination
+ */
+void recorder_get_dedup_stats(recorder_dedup_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_dedup_lock);
+    *out = s_dedup_stats;
+    portEXIT_CRITICAL(&s_dedup_lock);
+}
+
+/**
+ * @brief Copy the trigger-to-capture latency counters
+ * 
+ * @param out Destination
+ */
+void recorder_get_latency_stats(recorder_latency_stats_t *out){
+    if (!out) return;
+    portENTER_CRITICAL(&s_latency_lock);
+    *out = s_latency_stats;
+    portEXIT_CRITICAL(&s_latency_lock);
+}
+
+/**
+ * @brief esp_timer time a frame was taken
+ * 
+ * @param fb Frame buffer
+ * @return int64_t Microseconds since boot
+ */
+static int64_t frame_us(const camera_fb_t *fb){
+    return (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+}
+
+/**
+ * @brief Grab a frame, flashing the LED only around its exposure
+ * 
+ * @param led_duty LED duty for this frame, 0 for no flash
+ * @return camera_fb_t* Frame buffer, or NULL if the camera returned none
+ */
+static camera_fb_t *grab_frame(uint32_t led_duty){
+    TRACE_BEGIN("fb_get");
+    if (led_duty) {
+        light_control_led_set(led_duty);
+        for (int i = 0; i < RECORDER_LED_SETTLE_FRAMES; i++) {
+            camera_fb_t *stale = camera_guard_fb_get();
+            if (stale) esp_camera_fb_return(stale);
+        }
+    }
+    camera_fb_t *fb = NULL;
+    for (int i = 0; i < 3; i++) {
+        fb = camera_guard_fb_get();
+        if (fb) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    /* The camera stops while the node light-sleeps, so the newest buffered
+       frame can predate the trigger by minutes */
+    int64_t wake_us = power_ctl_wake_us();
+    for (int i = 0; fb && wake_us && i < RECORDER_STALE_FRAMES_MAX && frame_us(fb) < wake_us; i++) {
+        esp_camera_fb_return(fb);
+        portENTER_CRITICAL(&s_latency_lock);
+        s_latency_stats.stale_frames++;
+        portEXIT_CRITICAL(&s_latency_lock);
+        fb = camera_guard_fb_get();
+    }
+    /* The frame is exposed; the LED is not needed for encoding or writing */
+    if (led_duty) {
+        light_control_led_set(0);
+    }
+    TRACE_END("fb_get");
+    return fb;
+}
+
+/**
+ * @brief Capture an image to a file; the caller holds the camera guard
  * 
  * @param filepath Path to save the captured image
  * @param frame_size Frame size to set for the capture
  * @param jpeg_quality JPEG quality to set for the capture
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @param trigger Trigger source recorded in the EXIF metadata (may be NULL)
+ * @param grabbed_us Set to the esp_timer time the frame was in hand (may be NULL)
+ * @param dropped Set to true if the frame was a near-duplicate and was not written (may be NULL)
+ * @return esp_err_t ESP_OK on success or when dropped, ESP_ERR_TIMEOUT if the sensor stayed busy,
+ *         error code otherwise
  */
-esp_err_t recorder_capture_to_file(const char *filepath, framesize_t frame_size, int jpeg_quality){
+static esp_err_t capture_locked(const char *filepath, framesize_t frame_size, int jpeg_quality, const char *trigger,
+                                int64_t *grabbed_us, bool *dropped){
+    /* The frame size and quality must still be ours when the frame is grabbed */
+    if (!camera_guard_sensor_take(pdMS_TO_TICKS(RECORDER_CAMERA_WAIT_MS))) {
+        ESP_LOGE(TAG, "Camera sensor busy, capture skipped");
+        return ESP_ERR_TIMEOUT;
+    }
     sensor_t *s = esp_camera_sensor_get();
     if (s) {
         if (frame_size != (framesize_t)-1) {
@@ -248,40 +537,85 @@ esp_err_t recorder_capture_to_file(const char *filepath, framesize_t frame_size,
             s->set_quality(s, jpeg_quality);
         }
     }
-    if (recorder_led_configured) {
-        gpio_set_level(RECORDER_LED_GPIO, 1);
-        vTaskDelay(pdMS_TO_TICKS(50));
-    }
-    
-    camera_fb_t *fb = NULL;
-    for (int i = 0; i < 3; i++) {
-        fb = esp_camera_fb_get();
-        if (fb) {
-            break;
-        }
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
+
+    /* The sensor's current exposure and gain tell how dark the scene is */
+    exif_meta_t light = {0};
+    read_exposure(s, &light);
+    uint32_t led_duty = light_control_update(s, light.exposure_lines, light.gain_x100);
+
+    camera_fb_t *fb = grab_frame(led_duty);
+    camera_guard_sensor_give();
     if (!fb) {
         ESP_LOGE(TAG, "Camera capture failed after retries");
-        if (recorder_led_configured) {
-            gpio_set_level(RECORDER_LED_GPIO, 0);
-        }
         return ESP_FAIL;
     }
+    if (grabbed_us) {
+        *grabbed_us = esp_timer_get_time();
+    }
 
-    size_t img_len = fb->len;
+    if (!trigger) {
+        trigger = "unknown";
+    }
 
-    uint8_t *heap_buf = malloc(img_len);
-    if (!heap_buf) {
-        ESP_LOGE(TAG, "OOM allocating heap buffer for image copy");
+    /* Near-identical frames from the same source (static scene re-triggering
+       the PIR) are dropped or tagged. The reference is the last kept photo,
+       so slow drift still produces a new photo once it adds up. */
+    const char *photo_id = strrchr(filepath, '/') ? strrchr(filepath, '/') + 1 : filepath;
+    uint64_t hash = 0;
+    char kept[PHOTO_CACHE_ID_MAX] = "";
+    bool duplicate = false;
+    bool hashed = RECORDER_DEDUP_THRESHOLD >= 0 && strcmp(trigger, RECORDER_DEDUP_SKIP_TRIGGER) != 0;
+    if (hashed) {
+        duplicate = dedup_check(fb->buf, fb->len, trigger, &hash, kept, sizeof(kept));
+    }
+    if (duplicate && RECORDER_DEDUP_DROP) {
         esp_camera_fb_return(fb);
-        if (recorder_led_configured) gpio_set_level(RECORDER_LED_GPIO, 0);
-        return ESP_FAIL;
+        dedup_alias(photo_id, kept);
+        if (dropped) *dropped = true;
+        return ESP_OK;
     }
-    memcpy(heap_buf, fb->buf, img_len);
 
-    esp_camera_fb_return(fb);
+    /* Splice an EXIF APP1 segment right after SOI; the JPEG data itself is
+       never re-encoded. Frames without an SOI marker are stored untouched. */
+    exif_meta_t meta = {
+        .trigger = trigger,
+        .sensor = sensor_name(s),
+        .duplicate = duplicate,
+    };
+    gettimeofday(&meta.captured, NULL);
+    read_exposure(s, &meta);
+    uint8_t app1[EXIF_APP1_MAX];
+    size_t app1_len = 0;
+    if (fb->len > 2 && fb->buf[0] == 0xFF && fb->buf[1] == 0xD8) {
+        app1_len = exif_build_app1(&meta, app1, sizeof(app1));
+    }
+    write_seg_t segs[3] = {
+        { fb->buf, app1_len ? 2 : fb->len },
+        { app1, app1_len },
+        { fb->buf + 2, app1_len ? fb->len - 2 : 0 },
+    };
+    int nsegs = 3;
+    size_t img_len = segs[0].len + segs[1].len + segs[2].len;
+
+    /* Gather the segments straight into a photo cache reservation so the
+       download that usually follows the capture is served from PSRAM and
+       the frame buffer goes back to the driver immediately. If the image
+       cannot be cached, write the segments directly from the frame buffer. */
+    photo_cache_entry_t *cached = photo_cache_reserve(photo_id, 1, img_len);
+    if (cached) {
+        uint8_t *dst = photo_cache_entry_buf(cached);
+        for (int i = 0; i < nsegs; i++) {
+            memcpy(dst, segs[i].data, segs[i].len);
+            dst += segs[i].len;
+        }
+        esp_camera_fb_return(fb);
+        fb = NULL;
+        segs[0].data = photo_cache_entry_buf(cached);
+        segs[0].len = img_len;
+        nsegs = 1;
+    }
 
+    TRACE_BEGIN("sd_write");
     FILE *f = NULL;
     const int max_open_attempts = 3;
     for (int attempt = 0; attempt < max_open_attempts; ++attempt) {
@@ -290,27 +624,40 @@ esp_err_t recorder_capture_to_file(const char *filepath, framesize_t frame_size,
         vTaskDelay(pdMS_TO_TICKS(100 * (attempt + 1)));
     }
     if (!f) {
+        TRACE_END("sd_write");
         ESP_LOGE(TAG, "fopen failed");
-        free(heap_buf);
-        if (recorder_led_configured) gpio_set_level(RECORDER_LED_GPIO, 0);
+        if (fb) esp_camera_fb_return(fb);
+        photo_cache_discard(cached);
         return ESP_FAIL;
     }
 
-    size_t written = fwrite(heap_buf, 1, img_len, f);
+    size_t written = write_segments(f, segs, nsegs);
     fflush(f);
     fclose(f);
+    TRACE_END("sd_write");
 
-    if (recorder_led_configured) {
-        gpio_set_level(RECORDER_LED_GPIO, 0);
+    if (fb) {
+        esp_camera_fb_return(fb);
     }
 
-    free(heap_buf);
-
     if (written != img_len) {
+        photo_cache_discard(cached);
         ESP_LOGE(TAG, "Failed to write complete image");
         return ESP_FAIL;
     }
 
+    if (hashed && !duplicate) {
+        dedup_remember(trigger, hash, photo_id);
+    }
+    dedup_alias(photo_id, "");
+    capture_timeline_add(meta.captured.tv_sec);
+
+    if (cached) {
+        /* A rewritten file name makes any scaled variants stale */
+        photo_cache_invalidate(photo_id);
+        photo_cache_commit(cached);
+    }
+
     return ESP_OK;
 }
 
@@ -326,7 +673,7 @@ void recorder_capture_to_file_async_task(void *param){
         return;
     }
 
-    esp_err_t res = recorder_capture_to_file(path, FRAMESIZE_VGA, 30);
+    esp_err_t res = recorder_capture_to_file(path, FRAMESIZE_VGA, 30, "async", NULL);
     if (res != ESP_OK) {
         ESP_LOGE(TAG, "Async capture failed: %s", path);
     }
@@ -334,3 +681,44 @@ void recorder_capture_to_file_async_task(void *param){
     free(path);
     vTaskDelete(NULL);
 }
+
+/**
+ * @brief Capture an image to a file
+ * 
+ * Waits for the camera if the watchdog is re-initialising it.
+ * 
+ * @param filepath Path to save the captured image
+ * @param frame_size Frame size to set for the capture
+ * @param jpeg_quality JPEG quality to set for the capture
+ * @param trigger Trigger source recorded in the EXIF metadata (may be NULL)
+ * @param dropped Set to true if the frame was a near-duplicate and was not written (may be NULL)
+ * @return esp_err_t ESP_OK on success or when dropped, ESP_ERR_TIMEOUT if the camera stayed down,
+ *         error code otherwise
+ */
+esp_err_t recorder_capture_to_file(const char *filepath, framesize_t frame_size, int jpeg_quality, const char *trigger,
+                                   bool *dropped){
+    return capture_guarded(filepath, frame_size, jpeg_quality, trigger, NULL, dropped);
+}
+
+/**
+ * @brief Capture an image to a file under the camera guard
+ * 
+ * @param filepath Path to save the captured image
+ * @param frame_size Frame size to set for the capture
+ * @param jpeg_quality JPEG quality to set for the capture
+ * @param trigger Trigger source recorded in the EXIF metadata (may be NULL)
+ * @param grabbed_us Set to the esp_timer time the frame was in hand (may be NULL)
+ * @param dropped Set to true if the frame was a near-duplicate and was not written (may be NULL)
+ * @return esp_err_t ESP_OK on success or when dropped, ESP_ERR_TIMEOUT if the camera stayed down,
+ *         error code otherwise
+ */
+static esp_err_t capture_guarded(const char *filepath, framesize_t frame_size, int jpeg_quality,
+                                 const char *trigger, int64_t *grabbed_us, bool *dropped){
+    if (!camera_guard_enter(pdMS_TO_TICKS(RECORDER_CAMERA_WAIT_MS))) {
+        ESP_LOGE(TAG, "Camera still recovering, capture skipped");
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t err = capture_locked(filepath, frame_size, jpeg_quality, trigger, grabbed_us, dropped);
+    camera_guard_exit();
+    return err;
+}
@@ -8,14 +8,25 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
-#include "driver/gpio.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
 #include <unistd.h>
-#include "ff.h"
+#include "photo_cache.h"
+#include "exif_writer.h"
+#include "phash.h"
+#include "light_control.h"
+#include "capture_queue.h"
+#include "task_plan.h"
+#include "event_trace.h"
+#include "settings.h"
+#include "camera_guard.h"
+#include "camera_profile.h"
+#include "capture_timeline.h"
+#include "power_ctl.h"
+#include "mem_pressure.h"
 
 
 // Initialize the camera. Returns ESP_OK on success.
@@ -24,9 +35,43 @@ esp_err_t recorder_init(void);
 // Deinitialize camera
 esp_err_t recorder_deinit(void);
 
-esp_err_t recorder_capture_to_file(const char *filepath, framesize_t frame_size, int jpeg_quality);
+/* Longest trigger source name kept with a capture request (incl. terminator) */
+#define RECORDER_TRIGGER_MAX CAPTURE_TRIGGER_MAX
 
-esp_err_t recorder_enqueue_capture(char *filepath);
+typedef struct {
+    uint32_t hashed;          // captures hashed successfully
+    uint32_t hash_failures;
+    uint32_t unique;
+    uint32_t dropped;         // near-duplicates not written
+    uint32_t marked;          // near-duplicates written with a duplicate tag
+    uint64_t hash_us_total;
+    uint32_t hash_us_max;
+} recorder_dedup_stats_t;
+
+typedef struct {
+    uint32_t captures;        // queued captures that got a frame
+    uint32_t stale_frames;    // frames older than the last wake-up, discarded
+    uint64_t trigger_us_total;    // enqueue to frame in hand
+    uint32_t trigger_us_max;
+    uint32_t trigger_us_last;
+} recorder_latency_stats_t;
+
+// Capture a frame to `filepath`, tagging it with EXIF metadata naming `trigger`.
+// `dropped` (may be NULL) is set when the frame was a near-duplicate and was not written.
+esp_err_t recorder_capture_to_file(const char *filepath, framesize_t frame_size, int jpeg_quality, const char *trigger,
+                                   bool *dropped);
+
+// Queue a capture of `filepath` (copied). `requested_ms` is the trigger's epoch ms, 0 if unknown.
+esp_err_t recorder_enqueue_capture(const char *filepath, uint64_t requested_ms, const char *trigger);
+
+// Name of the kept photo that `name` was dropped in favour of, if it is still remembered
+bool recorder_duplicate_of(const char *name, char *kept, size_t kept_len);
+
+// Snapshot of perceptual-hash dedup counters
+void recorder_get_dedup_stats(recorder_dedup_stats_t *out);
+
+// Snapshot of trigger-to-capture latency counters
+void recorder_get_latency_stats(recorder_latency_stats_t *out);
 
 
 
@@ -0,0 +1,308 @@
+/**
+ * @file settings.c
+ * @author xholanp00
+ * @brief Typed registry of runtime performance knobs persisted in NVS
+ *
+ * Live settings are read by their users on every use, so storing a new value
+ * applies it. The others are read once at start-up; a new value is stored and
+ * reported as pending until the next restart.
+ */
+
+#include "settings.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "settings"; // Tag for logging
+
+#define SETTINGS_NAMESPACE "settings"
+
+/* Compile-time defaults, used until a value is stored in NVS */
+
+/* Accept capture commands only if requested capture time is within this window
+    (milliseconds) of the device's synced time. Prevents accepting stale/late
+    triggers from remote PIR device. */
+#ifndef CAPTURE_ACCEPT_WINDOW_MS
+#define CAPTURE_ACCEPT_WINDOW_MS 5000
+#endif
+
+/* Frame size (framesize_t value, 8 = FRAMESIZE_VGA) and quality used for queued captures */
+#ifndef RECORDER_CAPTURE_FRAMESIZE
+#define RECORDER_CAPTURE_FRAMESIZE 8
+#endif
+
+#ifndef RECORDER_CAPTURE_QUALITY
+#define RECORDER_CAPTURE_QUALITY 30
+#endif
+
+/* Pause between MJPEG frames */
+#ifndef FRAME_DELAY_MS
+#define FRAME_DELAY_MS 100
+#endif
+
+/* 16KB chunk for faster downloads, placed in PSRAM (MEM_TAG_HTTP_SCRATCH) */
+#ifndef SCRATCH_BUFSIZE
+#define SCRATCH_BUFSIZE 16384
+#endif
+
+#ifndef HTTPD_IO_TIMEOUT_S
+#define HTTPD_IO_TIMEOUT_S 20
+#endif
+
+/* Highest recorder priority accepted: below the lwIP tcpip task, so a busy
+   capture worker cannot starve the network stack */
+#ifdef CONFIG_LWIP_TCPIP_TASK_PRIO
+#define SETTINGS_RECORDER_PRIORITY_MAX (CONFIG_LWIP_TCPIP_TASK_PRIO - 1)
+#else
+#define SETTINGS_RECORDER_PRIORITY_MAX 17
+#endif
+
+/* Longest key accepted in a PATCH body (NVS keys are at most 15 characters) */
+#define SETTINGS_KEY_MAX 16
+
+static const setting_desc_t s_desc[SETTING_COUNT] = {
+    [SETTING_CAPTURE_WINDOW_MS] = { "capture_window", 100, 60000, CAPTURE_ACCEPT_WINDOW_MS, true },
+    [SETTING_CAPTURE_QUEUE_DEPTH] = { "queue_depth", 1, CAPTURE_QUEUE_LEN, CAPTURE_QUEUE_LEN, true },
+    /* The camera profile lowers the bound to the size its frame buffers were allocated for */
+    [SETTING_CAPTURE_FRAMESIZE] = { "frame_size", SETTINGS_FRAMESIZE_MIN, SETTINGS_FRAMESIZE_MAX, RECORDER_CAPTURE_FRAMESIZE, true },
+    /* Below ~8 frames grow past what the frame buffers hold */
+    [SETTING_CAPTURE_QUALITY] = { "jpeg_quality", 8, 63, RECORDER_CAPTURE_QUALITY, true },
+    [SETTING_RECORDER_PRIORITY] = { "rec_priority", 0, SETTINGS_RECORDER_PRIORITY_MAX, 0, false },
+    [SETTING_STREAM_FRAME_DELAY_MS] = { "stream_delay", 0, 2000, FRAME_DELAY_MS, true },
+    [SETTING_HTTP_SCRATCH_SIZE] = { "scratch_size", 4096, 65536, SCRATCH_BUFSIZE, false },
+    [SETTING_HTTP_RECV_TIMEOUT_S] = { "http_recv_s", 1, 120, HTTPD_IO_TIMEOUT_S, false },
+    [SETTING_HTTP_SEND_TIMEOUT_S] = { "http_send_s", 1, 120, HTTPD_IO_TIMEOUT_S, false },
+    /* Upper bound is the last mem_pressure stage (MEM_PRESSURE_CAPTURE_LOW) */
+    [SETTING_MEM_PRESSURE_FLOOR] = { "pressure_floor", 0, 4, 0, true },
+};
+
+static int32_t s_active[SETTING_COUNT];    // in effect now
+static int32_t s_pending[SETTING_COUNT];   // stored, in effect after restart
+static int32_t s_limit[SETTING_COUNT];     // runtime upper bound below s_desc max, 0 = none
+static bool s_loaded = false;
+static bool s_nvs_ok = false;
+
+static bool in_range(setting_id_t id, int32_t v){
+    return v >= s_desc[id].min && v <= settings_max(id);
+}
+
+/**
+ * @brief Load stored values, falling back to defaults for missing or out-of-range ones
+ *
+ * @return esp_err_t ESP_OK (also when NVS is unavailable)
+ */
+esp_err_t settings_init(void){
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        s_active[i] = s_pending[i] = s_desc[i].def;
+    }
+    s_loaded = true;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SETTINGS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        s_nvs_ok = true;   // nothing stored yet
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "NVS unavailable (%s); defaults only, changes are not persisted", esp_err_to_name(err));
+        return ESP_OK;
+    }
+    s_nvs_ok = true;
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        int32_t v;
+        if (nvs_get_i32(nvs, s_desc[i].key, &v) != ESP_OK) continue;
+        if (!in_range(i, v)) {
+            ESP_LOGW(TAG, "Stored %s=%ld out of range, using %ld", s_desc[i].key, (long)v, (long)s_desc[i].def);
+            continue;
+        }
+        s_active[i] = s_pending[i] = v;
+        ESP_LOGI(TAG, "%s=%ld", s_desc[i].key, (long)v);
+    }
+    nvs_close(nvs);
+    return ESP_OK;
+}
+
+int32_t settings_get(setting_id_t id){
+    if (id >= SETTING_COUNT) return 0;
+    if (!s_loaded) return s_desc[id].def;
+    return __atomic_load_n(&s_active[id], __ATOMIC_RELAXED);
+}
+
+int32_t settings_get_pending(setting_id_t id){
+    if (id >= SETTING_COUNT) return 0;
+    if (!s_loaded) return s_desc[id].def;
+    return __atomic_load_n(&s_pending[id], __ATOMIC_RELAXED);
+}
+
+const setting_desc_t *settings_desc(setting_id_t id){
+    if (id >= SETTING_COUNT) return NULL;
+    return &s_desc[id];
+}
+
+int32_t settings_max(setting_id_t id){
+    if (id >= SETTING_COUNT) return 0;
+    int32_t limit = __atomic_load_n(&s_limit[id], __ATOMIC_RELAXED);
+    return limit && limit < s_desc[id].max ? limit : s_desc[id].max;
+}
+
+/**
+ * @brief Lower the upper bound of a setting to what the running hardware allows
+ *
+ * Values above the new bound are rejected by settings_patch_json(). A value in
+ * effect above it is clamped in RAM; the stored one is kept, so a restart with
+ * a larger limit gets it back.
+ *
+ * @param id Setting
+ * @param max New upper bound, at least the setting's minimum (0 removes the limit)
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for an unknown setting or a bound below its minimum
+ */
+esp_err_t settings_set_limit(setting_id_t id, int32_t max){
+    if (id >= SETTING_COUNT || (max && max < s_desc[id].min)) return ESP_ERR_INVALID_ARG;
+    __atomic_store_n(&s_limit[id], max, __ATOMIC_RELAXED);
+    max = settings_max(id);
+    if (settings_get(id) > max) {
+        ESP_LOGW(TAG, "%s=%ld above the limit, using %ld", s_desc[id].key, (long)settings_get(id), (long)max);
+        __atomic_store_n(&s_active[id], max, __ATOMIC_RELAXED);
+        if (s_desc[id].live) __atomic_store_n(&s_pending[id], max, __ATOMIC_RELAXED);
+    }
+    return ESP_OK;
+}
+
+setting_id_t settings_find(const char *key){
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        if (strcmp(s_desc[i].key, key) == 0) return i;
+    }
+    return SETTING_COUNT;
+}
+
+static const char *skip_ws(const char *p){
+    while (isspace((unsigned char)*p)) p++;
+    return p;
+}
+
+/* `p` points at the closing brace; only whitespace may follow it */
+static esp_err_t end_object(const char *p, char *msg, size_t msg_len){
+    if (*skip_ws(p + 1) != '\0') {
+        snprintf(msg, msg_len, "unexpected data after the object");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Parse a flat JSON object of integers into per-setting values
+ *
+ * @param json Request body
+ * @param values Receives the values
+ * @param given Set for every setting present in the body
+ * @param msg Error description
+ * @param msg_len Capacity of `msg`
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG with `msg` filled in
+ */
+static esp_err_t parse_patch(const char *json, int32_t *values, bool *given, char *msg, size_t msg_len){
+    const char *p = skip_ws(json);
+    if (*p++ != '{') {
+        snprintf(msg, msg_len, "expected a JSON object");
+        return ESP_ERR_INVALID_ARG;
+    }
+    p = skip_ws(p);
+    if (*p == '}') return end_object(p, msg, msg_len);
+    for (;;) {
+        char key[SETTINGS_KEY_MAX];
+        size_t n = 0;
+        if (*p++ != '"') {
+            snprintf(msg, msg_len, "expected a quoted key");
+            return ESP_ERR_INVALID_ARG;
+        }
+        while (*p && *p != '"' && n < sizeof(key) - 1) key[n++] = *p++;
+        key[n] = '\0';
+        if (*p++ != '"') {
+            snprintf(msg, msg_len, "unknown setting");
+            return ESP_ERR_INVALID_ARG;
+        }
+        setting_id_t id = settings_find(key);
+        if (id == SETTING_COUNT) {
+            snprintf(msg, msg_len, "unknown setting %s", key);
+            return ESP_ERR_INVALID_ARG;
+        }
+        p = skip_ws(p);
+        if (*p++ != ':') {
+            snprintf(msg, msg_len, "expected ':' after %s", key);
+            return ESP_ERR_INVALID_ARG;
+        }
+        p = skip_ws(p);
+        char *end;
+        long v = strtol(p, &end, 10);
+        if (end == p || (*end != ',' && *end != '}' && !isspace((unsigned char)*end))) {
+            snprintf(msg, msg_len, "%s must be an integer", key);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (v < s_desc[id].min || v > settings_max(id)) {
+            snprintf(msg, msg_len, "%s must be in %ld..%ld", key, (long)s_desc[id].min, (long)settings_max(id));
+            return ESP_ERR_INVALID_ARG;
+        }
+        values[id] = v;
+        given[id] = true;
+        p = skip_ws(end);
+        if (*p == '}') return end_object(p, msg, msg_len);
+        if (*p++ != ',') {
+            snprintf(msg, msg_len, "expected ',' or '}'");
+            return ESP_ERR_INVALID_ARG;
+        }
+        p = skip_ws(p);
+    }
+}
+
+/**
+ * @brief Validate, persist and apply a set of changes
+ *
+ * @param json Flat JSON object of setting keys and integer values
+ * @param msg Receives an error description
+ * @param msg_len Capacity of `msg`
+ * @param restart_needed Set when a changed setting only applies after a restart (may be NULL)
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for a bad body, NVS error otherwise
+ */
+esp_err_t settings_patch_json(const char *json, char *msg, size_t msg_len, bool *restart_needed){
+    int32_t values[SETTING_COUNT];
+    bool given[SETTING_COUNT] = {0};
+    if (restart_needed) *restart_needed = false;
+    if (!json || !s_loaded) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = parse_patch(json, values, given, msg, msg_len);
+    if (err != ESP_OK) return err;
+
+    if (s_nvs_ok) {
+        nvs_handle_t nvs;
+        err = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &nvs);
+        if (err != ESP_OK) {
+            snprintf(msg, msg_len, "NVS open failed: %s", esp_err_to_name(err));
+            return err;
+        }
+        for (int i = 0; i < SETTING_COUNT && err == ESP_OK; i++) {
+            if (given[i]) err = nvs_set_i32(nvs, s_desc[i].key, values[i]);
+        }
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+        if (err != ESP_OK) {
+            snprintf(msg, msg_len, "NVS write failed: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        if (!given[i]) continue;
+        __atomic_store_n(&s_pending[i], values[i], __ATOMIC_RELAXED);
+        if (s_desc[i].live) {
+            __atomic_store_n(&s_active[i], values[i], __ATOMIC_RELAXED);
+        } else if (values[i] != s_active[i] && restart_needed) {
+            *restart_needed = true;
+        }
+        ESP_LOGI(TAG, "%s=%ld%s", s_desc[i].key, (long)values[i], s_desc[i].live ? "" : " (after restart)");
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Static capture request slots: the most captures that can be pending or in progress at once.
+   The queue_depth setting can lower the limit at runtime. */
+#ifndef CAPTURE_QUEUE_LEN
+#define CAPTURE_QUEUE_LEN 8
+#endif
+
+/* frame_size range as framesize_t values (FRAMESIZE_QQVGA..FRAMESIZE_UXGA), kept as
+   numbers so settings does not depend on the camera driver; camera_profile.c checks them */
+#define SETTINGS_FRAMESIZE_MIN 1
+#define SETTINGS_FRAMESIZE_MAX 13
+
+/* Runtime performance knobs. Values are kept in NVS and validated against
+   the ranges in settings.c; the compile-time defaults live there too. */
+typedef enum {
+    SETTING_CAPTURE_WINDOW_MS = 0,  // accepted trigger time skew
+    SETTING_CAPTURE_QUEUE_DEPTH,    // pending captures before triggers are rejected
+    SETTING_CAPTURE_FRAMESIZE,      // framesize_t of queued captures
+    SETTING_CAPTURE_QUALITY,        // JPEG quality of queued captures (lower is better)
+    SETTING_RECORDER_PRIORITY,      // recorder worker priority, 0 = task plan
+    SETTING_STREAM_FRAME_DELAY_MS,  // pause between MJPEG frames
+    SETTING_HTTP_SCRATCH_SIZE,      // file download chunk size
+    SETTING_HTTP_RECV_TIMEOUT_S,
+    SETTING_HTTP_SEND_TIMEOUT_S,
+    SETTING_MEM_PRESSURE_FLOOR,     // lowest degradation level, to exercise the stages
+    SETTING_COUNT
+} setting_id_t;
+
+typedef struct {
+    const char *key;        // JSON name and NVS key (max 15 characters)
+    int32_t min;
+    int32_t max;
+    int32_t def;
+    bool live;              // applied at once; otherwise on the next restart
+} setting_desc_t;
+
+// Load stored values from NVS (nvs_flash_init() must have run). Without NVS the defaults are used.
+esp_err_t settings_init(void);
+
+// Value in effect now
+int32_t settings_get(setting_id_t id);
+
+// Value in effect after the next restart (same as settings_get() for live settings)
+int32_t settings_get_pending(setting_id_t id);
+
+// Name, range, default and apply mode of a setting
+const setting_desc_t *settings_desc(setting_id_t id);
+
+// Upper bound in effect: the registry's, or a lower one set with settings_set_limit()
+int32_t settings_max(setting_id_t id);
+
+// Lower the upper bound at runtime (0 = registry bound); a value in effect above it is clamped
+esp_err_t settings_set_limit(setting_id_t id, int32_t max);
+
+// Setting with the given key, or SETTING_COUNT if there is none
+setting_id_t settings_find(const char *key);
+
+// Validate, store and apply a flat JSON object of integer values, e.g. {"jpeg_quality":20}.
+// Nothing is changed unless every value is valid; `msg` then explains the first problem.
+esp_err_t settings_patch_json(const char *json, char *msg, size_t msg_len, bool *restart_needed);
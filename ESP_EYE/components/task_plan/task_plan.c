@@ -0,0 +1,210 @@
+/**
+ * @file task_plan.c
+ * @author xholanp00
+ * @brief Central table of task cores, priorities and stack sizes
+ *
+ * Default plan (core 0 runs Wi-Fi, lwIP and httpd; core 1 the camera work).
+ * The split is by design, not yet measured against the legacy placement:
+ *
+ *   task            core  prio  stack
+ *   rec_cap_worker   1     6    12288   trigger latency matters most
+ *   mjpeg_tcp        1     4    12288   yields to captures
+ *   photo_scaler     1     2     8192   CPU bound, can wait
+ *   httpd            0     5    16384   short handlers, socket bound
+ *   log_drain        0     1     3072   console output whenever idle
+ *   cam_guard        1     7     6144   idle until the camera wedges
+ *
+ * These sizes are upper bounds. A CONFIG_TASK_PLAN_STACK_PROFILE build reports
+ * the high-water mark of every task on GET /stacks; tools/stack_profile.py
+ * runs a standard workload against it and writes task_plan_stacks.h, whose
+ * sizes replace the configured ones in later builds.
+ */
+
+#include "task_plan.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "task_plan"; // Tag for logging
+
+#if CONFIG_TASK_PLAN_LEGACY_PLACEMENT
+
+/* Placement before the task plan: unpinned, ad-hoc priorities */
+static const task_plan_entry_t s_plan[TASK_PLAN_COUNT] = {
+    [TASK_PLAN_RECORDER] = { "rec_cap_worker", 12288, tskIDLE_PRIORITY + 5, tskNO_AFFINITY },
+    [TASK_PLAN_STREAMER] = { "mjpeg_tcp", 12 * 1024, tskIDLE_PRIORITY + 1, tskNO_AFFINITY },
+    [TASK_PLAN_SCALER] = { "photo_scaler", 8192, tskIDLE_PRIORITY + 2, tskNO_AFFINITY },
+    [TASK_PLAN_HTTPD] = { "httpd", 16384, 5, tskNO_AFFINITY },
+    [TASK_PLAN_LOG_DRAIN] = { "log_drain", 3072, tskIDLE_PRIORITY + 1, tskNO_AFFINITY },
+    [TASK_PLAN_CAMERA_GUARD] = { "cam_guard", 6144, tskIDLE_PRIORITY + 6, tskNO_AFFINITY },
+};
+
+#define PLAN_STACK_SOURCE "legacy"
+
+#else
+
+#if CONFIG_TASK_PLAN_MEASURED_STACKS && __has_include("task_plan_stacks.h")
+/* Generated by tools/stack_profile.py; 0 keeps the configured size */
+#include "task_plan_stacks.h"
+#define PLAN_STACK(task, cfg) (TASK_PLAN_MEASURED_##task ? TASK_PLAN_MEASURED_##task : (cfg))
+#define PLAN_STACK_SOURCE "measured"
+#else
+#define PLAN_STACK(task, cfg) (cfg)
+#if CONFIG_TASK_PLAN_STACK_PROFILE
+#define PLAN_STACK_SOURCE "profiling"
+#else
+#define PLAN_STACK_SOURCE "configured"
+#endif
+#endif
+
+#if CONFIG_FREERTOS_UNICORE
+#define PLAN_CORE(c) ((c) < 0 ? tskNO_AFFINITY : 0)
+#else
+#define PLAN_CORE(c) ((c) < 0 ? tskNO_AFFINITY : (c))
+#endif
+
+static const task_plan_entry_t s_plan[TASK_PLAN_COUNT] = {
+    [TASK_PLAN_RECORDER] = { "rec_cap_worker", PLAN_STACK(RECORDER, CONFIG_TASK_PLAN_RECORDER_STACK),
+                             CONFIG_TASK_PLAN_RECORDER_PRIORITY, PLAN_CORE(CONFIG_TASK_PLAN_RECORDER_CORE) },
+    [TASK_PLAN_STREAMER] = { "mjpeg_tcp", PLAN_STACK(STREAMER, CONFIG_TASK_PLAN_STREAMER_STACK),
+                             CONFIG_TASK_PLAN_STREAMER_PRIORITY, PLAN_CORE(CONFIG_TASK_PLAN_STREAMER_CORE) },
+    [TASK_PLAN_SCALER] = { "photo_scaler", PLAN_STACK(SCALER, CONFIG_TASK_PLAN_SCALER_STACK),
+                           CONFIG_TASK_PLAN_SCALER_PRIORITY, PLAN_CORE(CONFIG_TASK_PLAN_SCALER_CORE) },
+    [TASK_PLAN_HTTPD] = { "httpd", PLAN_STACK(HTTPD, CONFIG_TASK_PLAN_HTTPD_STACK),
+                          CONFIG_TASK_PLAN_HTTPD_PRIORITY, PLAN_CORE(CONFIG_TASK_PLAN_HTTPD_CORE) },
+    [TASK_PLAN_LOG_DRAIN] = { "log_drain", PLAN_STACK(LOG_DRAIN, CONFIG_TASK_PLAN_LOG_DRAIN_STACK),
+                              CONFIG_TASK_PLAN_LOG_DRAIN_PRIORITY, PLAN_CORE(CONFIG_TASK_PLAN_LOG_DRAIN_CORE) },
+    [TASK_PLAN_CAMERA_GUARD] = { "cam_guard", PLAN_STACK(CAMERA_GUARD, CONFIG_TASK_PLAN_CAMERA_GUARD_STACK),
+                                 CONFIG_TASK_PLAN_CAMERA_GUARD_PRIORITY, PLAN_CORE(CONFIG_TASK_PLAN_CAMERA_GUARD_CORE) },
+};
+
+#endif
+
+/* Lower-case task_plan_id_t names; the generated header upper-cases them */
+static const char *const s_id_names[TASK_PLAN_COUNT] = {
+    [TASK_PLAN_RECORDER] = "recorder",
+    [TASK_PLAN_STREAMER] = "streamer",
+    [TASK_PLAN_SCALER] = "scaler",
+    [TASK_PLAN_HTTPD] = "httpd",
+    [TASK_PLAN_LOG_DRAIN] = "log_drain",
+    [TASK_PLAN_CAMERA_GUARD] = "camera_guard",
+};
+
+const task_plan_entry_t *task_plan_get(task_plan_id_t id){
+    if (id >= TASK_PLAN_COUNT) return NULL;
+    return &s_plan[id];
+}
+
+/**
+ * @brief Create a task as described by the plan
+ *
+ * @param id Task plan entry
+ * @param fn Task function
+ * @param arg Task argument
+ * @param out Receives the task handle (may be NULL)
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t task_plan_create(task_plan_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *out){
+    const task_plan_entry_t *t = task_plan_get(id);
+    if (!t || !fn) return ESP_ERR_INVALID_ARG;
+    if (xTaskCreatePinnedToCore(fn, t->name, t->stack_size, arg, t->priority, out, t->core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task %s", t->name);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Log the task table at boot
+ *
+ */
+void task_plan_log(void){
+    for (int i = 0; i < TASK_PLAN_COUNT; i++) {
+        const task_plan_entry_t *t = &s_plan[i];
+        if (t->core == tskNO_AFFINITY) {
+            ESP_LOGI(TAG, "%-15s core any prio %2u stack %lu", t->name, (unsigned)t->priority, (unsigned long)t->stack_size);
+        } else {
+            ESP_LOGI(TAG, "%-15s core %d   prio %2u stack %lu", t->name, (int)t->core, (unsigned)t->priority, (unsigned long)t->stack_size);
+        }
+    }
+}
+
+const char *task_plan_id_name(task_plan_id_t id){
+    return id < TASK_PLAN_COUNT ? s_id_names[id] : "unknown";
+}
+
+const char *task_plan_stack_source(void){
+    return PLAN_STACK_SOURCE;
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_TASK_PLAN_STACK_PROFILE && !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Plan entry a running task belongs to
+ *
+ * @param name Task name
+ * @return int task_plan_id_t, -1 when the task is not in the plan
+ */
+static int plan_id_of(const char *name){
+    for (int i = 0; i < TASK_PLAN_COUNT; i++) {
+        if (strcmp(s_plan[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+#endif
+
+/**
+ * @brief Stack high-water marks
+ *
+ * Every plan entry is listed, running or not, so a profiling run can tell
+ * "not exercised" from "small". A CONFIG_TASK_PLAN_STACK_PROFILE build also
+ * lists the tasks of ESP-IDF and the drivers (Wi-Fi, lwIP, camera, timers);
+ * their sizes are sdkconfig options and are left to the caller.
+ * The linux target runs tasks on pthread stacks and reports nothing.
+ *
+ * @param out Destination
+ * @param max Capacity of `out`
+ * @return size_t Entries written
+ */
+size_t task_plan_stack_usage(task_stack_usage_t *out, size_t max){
+    size_t n = 0;
+#if !CONFIG_IDF_TARGET_LINUX
+    for (int i = 0; i < TASK_PLAN_COUNT && n < max; i++) {
+        task_stack_usage_t *u = &out[n++];
+        memset(u, 0, sizeof(*u));
+        strlcpy(u->name, s_plan[i].name, sizeof(u->name));
+        u->plan = i;
+        u->stack_size = s_plan[i].stack_size;
+        /* Workers delete themselves on fatal errors: keep the TCB alive
+           between the lookup and the read */
+        vTaskSuspendAll();
+        TaskHandle_t h = xTaskGetHandle(s_plan[i].name);
+        if (h) {
+            u->running = true;
+            u->free_min = uxTaskGetStackHighWaterMark(h);
+        }
+        xTaskResumeAll();
+    }
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_TASK_PLAN_STACK_PROFILE
+    UBaseType_t count = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *tasks = malloc(count * sizeof(*tasks));
+    if (!tasks) return n;
+    count = uxTaskGetSystemState(tasks, count, NULL);
+    for (UBaseType_t i = 0; i < count && n < max; i++) {
+        if (plan_id_of(tasks[i].pcTaskName) >= 0) continue;
+        task_stack_usage_t *u = &out[n++];
+        memset(u, 0, sizeof(*u));
+        strlcpy(u->name, tasks[i].pcTaskName, sizeof(u->name));
+        u->plan = -1;
+        u->running = true;
+        u->free_min = tasks[i].usStackHighWaterMark;
+    }
+    free(tasks);
+#endif
+#else
+    (void)out;
+    (void)max;
+#endif
+    return n;
+}
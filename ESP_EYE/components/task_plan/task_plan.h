@@ -0,0 +1,56 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* Long-running tasks of the camera node. The camera driver task (CONFIG_CAMERA_CORE*),
+   Wi-Fi and lwIP are placed by their own components' options. */
+typedef enum {
+    TASK_PLAN_RECORDER = 0,   // frame grab, EXIF, SD write
+    TASK_PLAN_STREAMER,       // MJPEG TCP server
+    TASK_PLAN_SCALER,         // scaled photo variants
+    TASK_PLAN_HTTPD,          // esp_http_server task
+    TASK_PLAN_LOG_DRAIN,      // log ring to console
+    TASK_PLAN_CAMERA_GUARD,   // camera watchdog and re-init
+    TASK_PLAN_COUNT
+} task_plan_id_t;
+
+typedef struct {
+    const char *name;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    BaseType_t core;          // tskNO_AFFINITY when unpinned
+} task_plan_entry_t;
+
+// Placement of one task
+const task_plan_entry_t *task_plan_get(task_plan_id_t id);
+
+// Create a task with the name, stack, priority and core from the plan
+esp_err_t task_plan_create(task_plan_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *out);
+
+// Log the whole table
+void task_plan_log(void);
+
+/* Entries returned by task_plan_stack_usage() at most */
+#define TASK_PLAN_STACK_REPORT_MAX 32
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    int plan;                 // task_plan_id_t, -1 for tasks outside the plan
+    bool running;
+    uint32_t stack_size;      // bytes; 0 for tasks outside the plan
+    uint32_t free_min;        // least free stack since the task started (high-water mark)
+} task_stack_usage_t;
+
+// Stack high-water marks of the plan's tasks; of every task in a CONFIG_TASK_PLAN_STACK_PROFILE build
+size_t task_plan_stack_usage(task_stack_usage_t *out, size_t max);
+
+// Origin of the plan's stack sizes: "configured", "measured", "profiling" or "legacy"
+const char *task_plan_stack_source(void);
+
+// Short name of a plan entry as used in task_plan_stacks.h ("recorder", "httpd", ...)
+const char *task_plan_id_name(task_plan_id_t id);
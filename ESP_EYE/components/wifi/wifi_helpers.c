@@ -15,10 +15,19 @@
 #include "freertos/task.h"
 #include <string.h>
 #include "lwip/inet.h"
+#include "sdkconfig.h"
 
 
 static const char *TAG = "wifi_helpers";
 
+/* Modem sleep lets the node light-sleep between beacons in STA mode. An AP
+   has to answer its stations at any time and always runs WIFI_PS_NONE. */
+#if CONFIG_POWER_CTL_LIGHT_SLEEP
+#define WIFI_HELPERS_STA_PS WIFI_PS_MIN_MODEM
+#else
+#define WIFI_HELPERS_STA_PS WIFI_PS_NONE
+#endif
+
 static bool s_wifi_initialized = false;
 static char s_ap_ssid[33] = {0};
 static char s_ap_pass[65] = {0};
@@ -152,7 +161,7 @@ esp_err_t wifi_helpers_init_sta(const char *ssid, const char *password){
     if (err != ESP_OK) return err;
     err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
     if (err != ESP_OK) return err;
-    esp_wifi_set_ps(WIFI_PS_NONE);
+    esp_wifi_set_ps(WIFI_HELPERS_STA_PS);
     esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N);
     esp_wifi_set_bandwidth(WIFI_IF_STA, WIFI_BW_HT40);
     esp_wifi_set_max_tx_power(78);
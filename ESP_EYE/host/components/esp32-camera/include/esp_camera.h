@@ -0,0 +1,88 @@
+#pragma once
+
+/* Subset of esp32-camera's esp_camera.h for the host build. Frames are
+   replayed from JPEG files instead of being read from a sensor. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include "esp_err.h"
+#include "sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The host has no LEDC; the values only fill camera_config_t */
+typedef enum {
+    LEDC_TIMER_0 = 0,
+    LEDC_TIMER_1,
+    LEDC_TIMER_2,
+    LEDC_TIMER_3,
+} ledc_timer_t;
+
+typedef enum {
+    LEDC_CHANNEL_0 = 0,
+    LEDC_CHANNEL_1,
+    LEDC_CHANNEL_2,
+    LEDC_CHANNEL_3,
+} ledc_channel_t;
+
+typedef enum {
+    CAMERA_GRAB_WHEN_EMPTY,
+    CAMERA_GRAB_LATEST,
+} camera_grab_mode_t;
+
+typedef enum {
+    CAMERA_FB_IN_PSRAM,
+    CAMERA_FB_IN_DRAM,
+} camera_fb_location_t;
+
+typedef struct {
+    int pin_pwdn;
+    int pin_reset;
+    int pin_xclk;
+    int pin_sccb_sda;
+    int pin_sccb_scl;
+    int pin_d7;
+    int pin_d6;
+    int pin_d5;
+    int pin_d4;
+    int pin_d3;
+    int pin_d2;
+    int pin_d1;
+    int pin_d0;
+    int pin_vsync;
+    int pin_href;
+    int pin_pclk;
+    int xclk_freq_hz;
+    ledc_timer_t ledc_timer;
+    ledc_channel_t ledc_channel;
+    pixformat_t pixel_format;
+    framesize_t frame_size;
+    int jpeg_quality;
+    size_t fb_count;
+    camera_fb_location_t fb_location;
+    camera_grab_mode_t grab_mode;
+} camera_config_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t width;
+    size_t height;
+    pixformat_t format;
+    struct timeval timestamp;
+} camera_fb_t;
+
+esp_err_t esp_camera_init(const camera_config_t *config);
+esp_err_t esp_camera_deinit(void);
+camera_fb_t *esp_camera_fb_get(void);
+void esp_camera_fb_return(camera_fb_t *fb);
+sensor_t *esp_camera_sensor_get(void);
+camera_sensor_info_t *esp_camera_sensor_get_info(sensor_id_t *id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+/* Subset of esp32-camera's img_converters.h for the host build */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Baseline JPEG encoder (jpeg_encoder.c); RGB565, RGB888 and GRAYSCALE input, quality 1..100
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, uint8_t **out, size_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
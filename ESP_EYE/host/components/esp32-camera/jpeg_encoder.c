@@ -0,0 +1,358 @@
+/**
+ * @file jpeg_encoder.c
+ * @author xholanp00
+ * @brief Minimal baseline JPEG encoder standing in for esp32-camera's fmt2jpg
+ *
+ * The photo scaler decodes a photo at 1/2, 1/4 or 1/8 and re-encodes it with
+ * fmt2jpg(). On the host there is no esp32-camera, so this file provides a
+ * small baseline encoder: 4:4:4 YCbCr, the Annex K quantisation tables scaled
+ * by quality like libjpeg, and the standard Huffman tables. It favours
+ * brevity over speed; thumbnails are small.
+ */
+
+#include "img_converters.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "mock_jpeg"; // Tag for logging
+
+static const uint8_t s_zigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+/* ITU T.81 Annex K.1, natural order */
+static const uint8_t s_luma_q[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+
+static const uint8_t s_chroma_q[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+/* ITU T.81 Annex K.3: code counts per length 1..16, then symbols */
+static const uint8_t s_dc_luma_bits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t s_dc_chroma_bits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t s_dc_vals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t s_ac_luma_bits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t s_ac_luma_vals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t s_ac_chroma_bits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t s_ac_chroma_vals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+/* Code and length per symbol, built from a bits/values table */
+typedef struct {
+    uint16_t code[256];
+    uint8_t len[256];
+} huff_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    uint32_t acc;       // pending bits, left-aligned at bit 31 - nbits
+    int nbits;
+    bool oom;
+} jpeg_out_t;
+
+static void build_huff(huff_t *h, const uint8_t bits[16], const uint8_t *vals){
+    memset(h, 0, sizeof(*h));
+    uint16_t code = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++) {
+        for (int i = 0; i < bits[l - 1]; i++, k++) {
+            h->code[vals[k]] = code++;
+            h->len[vals[k]] = (uint8_t)l;
+        }
+        code <<= 1;
+    }
+}
+
+static void put_byte(jpeg_out_t *o, uint8_t b){
+    if (o->len == o->cap) {
+        size_t cap = o->cap ? o->cap * 2 : 4096;
+        uint8_t *p = realloc(o->buf, cap);
+        if (!p) {
+            o->oom = true;
+            return;
+        }
+        o->buf = p;
+        o->cap = cap;
+    }
+    o->buf[o->len++] = b;
+}
+
+static void put_u16(jpeg_out_t *o, uint16_t v){
+    put_byte(o, v >> 8);
+    put_byte(o, v & 0xFF);
+}
+
+static void put_bits(jpeg_out_t *o, uint32_t bits, int n){
+    o->acc |= (bits & ((1u << n) - 1)) << (24 - o->nbits - n);
+    o->nbits += n;
+    while (o->nbits >= 8) {
+        uint8_t b = (uint8_t)(o->acc >> 16);
+        put_byte(o, b);
+        if (b == 0xFF) put_byte(o, 0);   // byte stuffing
+        o->acc = (o->acc << 8) & 0xFFFFFF;
+        o->nbits -= 8;
+    }
+}
+
+static void put_dqt(jpeg_out_t *o, int id, const uint8_t q[64]){
+    put_u16(o, 0xFFDB);
+    put_u16(o, 67);
+    put_byte(o, (uint8_t)id);
+    for (int i = 0; i < 64; i++) put_byte(o, q[s_zigzag[i]]);
+}
+
+static void put_dht(jpeg_out_t *o, int cls_id, const uint8_t bits[16], const uint8_t *vals){
+    int n = 0;
+    for (int i = 0; i < 16; i++) n += bits[i];
+    put_u16(o, 0xFFC4);
+    put_u16(o, (uint16_t)(19 + n));
+    put_byte(o, (uint8_t)cls_id);
+    for (int i = 0; i < 16; i++) put_byte(o, bits[i]);
+    for (int i = 0; i < n; i++) put_byte(o, vals[i]);
+}
+
+/* Magnitude category and the low bits JPEG stores for a coefficient */
+static int category(int v, uint32_t *bits){
+    int a = v < 0 ? -v : v;
+    int n = 0;
+    while (a) {
+        n++;
+        a >>= 1;
+    }
+    *bits = v < 0 ? (uint32_t)(v - 1) : (uint32_t)v;
+    return n;
+}
+
+/**
+ * @brief Forward DCT, quantisation and entropy coding of one 8x8 block
+ *
+ * @param o Output
+ * @param block Samples, level-shifted to -128..127
+ * @param q Quantisation table (natural order)
+ * @param dc Huffman table for DC
+ * @param ac Huffman table for AC
+ * @param prev_dc DC of the previous block of this component, updated
+ */
+static void encode_block(jpeg_out_t *o, const float block[64], const uint8_t q[64], const huff_t *dc,
+                         const huff_t *ac, int *prev_dc){
+    int coef[64];
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+            float sum = 0.0f;
+            for (int y = 0; y < 8; y++) {
+                for (int x = 0; x < 8; x++) {
+                    sum += block[y * 8 + x] * cosf((2 * x + 1) * u * (float)M_PI / 16) *
+                           cosf((2 * y + 1) * v * (float)M_PI / 16);
+                }
+            }
+            float cu = u ? 1.0f : (float)M_SQRT1_2;
+            float cv = v ? 1.0f : (float)M_SQRT1_2;
+            coef[v * 8 + u] = (int)lroundf(0.25f * cu * cv * sum / q[v * 8 + u]);
+        }
+    }
+
+    uint32_t bits;
+    int diff = coef[0] - *prev_dc;
+    *prev_dc = coef[0];
+    int n = category(diff, &bits);
+    put_bits(o, dc->code[n], dc->len[n]);
+    put_bits(o, bits, n);
+
+    int run = 0;
+    for (int i = 1; i < 64; i++) {
+        int c = coef[s_zigzag[i]];
+        if (c == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            put_bits(o, ac->code[0xF0], ac->len[0xF0]);   // ZRL
+            run -= 16;
+        }
+        n = category(c, &bits);
+        int sym = (run << 4) | n;
+        put_bits(o, ac->code[sym], ac->len[sym]);
+        put_bits(o, bits, n);
+        run = 0;
+    }
+    if (run) put_bits(o, ac->code[0x00], ac->len[0x00]);   // EOB
+}
+
+/**
+ * @brief Read one pixel as RGB
+ *
+ * @param src Pixel data
+ * @param format PIXFORMAT_RGB565 (big-endian, as the sensor sends it), RGB888 (B, G, R) or GRAYSCALE
+ * @param i Pixel index
+ * @param rgb Receives red, green and blue
+ */
+static void read_pixel(const uint8_t *src, pixformat_t format, size_t i, int rgb[3]){
+    if (format == PIXFORMAT_RGB565) {
+        uint16_t p = (uint16_t)(src[2 * i] << 8 | src[2 * i + 1]);
+        rgb[0] = ((p >> 11) & 0x1F) * 255 / 31;
+        rgb[1] = ((p >> 5) & 0x3F) * 255 / 63;
+        rgb[2] = (p & 0x1F) * 255 / 31;
+    } else if (format == PIXFORMAT_RGB888) {
+        rgb[0] = src[3 * i + 2];
+        rgb[1] = src[3 * i + 1];
+        rgb[2] = src[3 * i];
+    } else {
+        rgb[0] = rgb[1] = rgb[2] = src[i];
+    }
+}
+
+/**
+ * @brief Encode a raw frame as a baseline JPEG
+ *
+ * @param src Pixel data
+ * @param src_len Length of `src`
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param format PIXFORMAT_RGB565, PIXFORMAT_RGB888 or PIXFORMAT_GRAYSCALE
+ * @param quality 1..100, higher is better (as in esp32-camera)
+ * @param out Receives the JPEG (release with free())
+ * @param out_len Receives its length
+ * @return true on success
+ */
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+             uint8_t **out, size_t *out_len){
+    size_t bpp = format == PIXFORMAT_RGB565 ? 2 : format == PIXFORMAT_RGB888 ? 3 : format == PIXFORMAT_GRAYSCALE ? 1 : 0;
+    if (!src || !out || !out_len || !width || !height || !bpp || src_len < (size_t)width * height * bpp) {
+        ESP_LOGW(TAG, "Unsupported frame (%ux%u, format %d, %u bytes)", width, height, format, (unsigned)src_len);
+        return false;
+    }
+    int ncomp = format == PIXFORMAT_GRAYSCALE ? 1 : 3;
+
+    /* libjpeg's quality scaling */
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    uint8_t q[2][64];
+    for (int i = 0; i < 64; i++) {
+        int l = (s_luma_q[i] * scale + 50) / 100;
+        int c = (s_chroma_q[i] * scale + 50) / 100;
+        q[0][i] = (uint8_t)(l < 1 ? 1 : l > 255 ? 255 : l);
+        q[1][i] = (uint8_t)(c < 1 ? 1 : c > 255 ? 255 : c);
+    }
+
+    static huff_t dc[2], ac[2];
+    static bool tables_built = false;
+    if (!tables_built) {
+        build_huff(&dc[0], s_dc_luma_bits, s_dc_vals);
+        build_huff(&dc[1], s_dc_chroma_bits, s_dc_vals);
+        build_huff(&ac[0], s_ac_luma_bits, s_ac_luma_vals);
+        build_huff(&ac[1], s_ac_chroma_bits, s_ac_chroma_vals);
+        tables_built = true;
+    }
+
+    jpeg_out_t o = {0};
+    put_u16(&o, 0xFFD8);
+    static const uint8_t jfif[] = { 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+    for (size_t i = 0; i < sizeof(jfif); i++) put_byte(&o, jfif[i]);
+    put_dqt(&o, 0, q[0]);
+    if (ncomp == 3) put_dqt(&o, 1, q[1]);
+
+    put_u16(&o, 0xFFC0);   // SOF0, no subsampling
+    put_u16(&o, (uint16_t)(8 + 3 * ncomp));
+    put_byte(&o, 8);
+    put_u16(&o, height);
+    put_u16(&o, width);
+    put_byte(&o, (uint8_t)ncomp);
+    for (int c = 0; c < ncomp; c++) {
+        put_byte(&o, (uint8_t)(c + 1));
+        put_byte(&o, 0x11);
+        put_byte(&o, c ? 1 : 0);
+    }
+
+    put_dht(&o, 0x00, s_dc_luma_bits, s_dc_vals);
+    put_dht(&o, 0x10, s_ac_luma_bits, s_ac_luma_vals);
+    if (ncomp == 3) {
+        put_dht(&o, 0x01, s_dc_chroma_bits, s_dc_vals);
+        put_dht(&o, 0x11, s_ac_chroma_bits, s_ac_chroma_vals);
+    }
+
+    put_u16(&o, 0xFFDA);
+    put_u16(&o, (uint16_t)(6 + 2 * ncomp));
+    put_byte(&o, (uint8_t)ncomp);
+    for (int c = 0; c < ncomp; c++) {
+        put_byte(&o, (uint8_t)(c + 1));
+        put_byte(&o, c ? 0x11 : 0x00);
+    }
+    put_byte(&o, 0);
+    put_byte(&o, 63);
+    put_byte(&o, 0);
+
+    int prev_dc[3] = {0};
+    float block[3][64];
+    for (int by = 0; by < height; by += 8) {
+        for (int bx = 0; bx < width; bx += 8) {
+            for (int y = 0; y < 8; y++) {
+                for (int x = 0; x < 8; x++) {
+                    /* Edge blocks repeat the last row and column */
+                    int px = bx + x < width ? bx + x : width - 1;
+                    int py = by + y < height ? by + y : height - 1;
+                    int rgb[3];
+                    read_pixel(src, format, (size_t)py * width + px, rgb);
+                    block[0][y * 8 + x] = 0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2] - 128.0f;
+                    block[1][y * 8 + x] = -0.168736f * rgb[0] - 0.331264f * rgb[1] + 0.5f * rgb[2];
+                    block[2][y * 8 + x] = 0.5f * rgb[0] - 0.418688f * rgb[1] - 0.081312f * rgb[2];
+                }
+            }
+            for (int c = 0; c < ncomp; c++) {
+                encode_block(&o, block[c], q[c ? 1 : 0], &dc[c ? 1 : 0], &ac[c ? 1 : 0], &prev_dc[c]);
+            }
+        }
+    }
+    put_bits(&o, 0x7F, 7);   // pad the last byte with ones
+    put_u16(&o, 0xFFD9);
+
+    if (o.oom) {
+        free(o.buf);
+        ESP_LOGE(TAG, "Out of memory encoding %ux%u", width, height);
+        return false;
+    }
+    *out = o.buf;
+    *out_len = o.len;
+    return true;
+}
@@ -0,0 +1,422 @@
+/**
+ * @file mock_camera.c
+ * @author xholanp00
+ * @brief Host replacement for the esp32-camera driver replaying JPEG files
+ *
+ * Frames come from the *.jpg / *.jpeg files of a directory, in name order or
+ * at random, paced to a target frame rate. Each frame can be padded with JPEG
+ * comment segments to a size drawn uniformly from a range, so streaming and
+ * storage can be loaded with realistic frame sizes from a few sample images.
+ * Like the driver, only fb_count frames can be held at once.
+ *
+ * Environment:
+ *   MOCK_CAMERA_DIR       directory with the source JPEGs (default "frames")
+ *   MOCK_CAMERA_FPS       frame rate, 0 = as fast as possible (default 10)
+ *   MOCK_CAMERA_SIZE_MIN  smallest frame in bytes (default 0, no padding)
+ *   MOCK_CAMERA_SIZE_MAX  largest frame in bytes (default SIZE_MIN)
+ *   MOCK_CAMERA_RANDOM    1 to pick files at random (default 0)
+ *   MOCK_CAMERA_SEED      seed for the random choices (default 1)
+ *   MOCK_CAMERA_EXPOSURE  exposure lines reported by the sensor (default 300)
+ *   MOCK_CAMERA_WEDGE_AFTER  stop delivering after this many frames until the
+ *                         next esp_camera_init(), 0 = never (default 0)
+ */
+
+#include "esp_camera.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "mock_camera"; // Tag for logging
+
+#define MOCK_MAX_FILES 256
+#define MOCK_PATH_MAX 512
+
+/* Same wait the driver uses before giving up on a frame buffer */
+#define MOCK_FB_TIMEOUT_MS 4000
+
+/* A COM segment carries at most 65533 payload bytes */
+#define COM_SEGMENT_MAX 65535
+
+const resolution_info_t resolution[FRAMESIZE_INVALID] = {
+    {   96,   96 }, /* 96x96 */
+    {  160,  120 }, /* QQVGA */
+    {  176,  144 }, /* QCIF  */
+    {  240,  176 }, /* HQVGA */
+    {  240,  240 }, /* 240x240 */
+    {  320,  240 }, /* QVGA  */
+    {  400,  296 }, /* CIF   */
+    {  480,  320 }, /* HVGA  */
+    {  640,  480 }, /* VGA   */
+    {  800,  600 }, /* SVGA  */
+    { 1024,  768 }, /* XGA   */
+    { 1280,  720 }, /* HD    */
+    { 1280, 1024 }, /* SXGA  */
+    { 1600, 1200 }, /* UXGA  */
+};
+
+typedef struct {
+    char dir[MOCK_PATH_MAX];
+    int fps;
+    size_t size_min;
+    size_t size_max;
+    bool random;
+    unsigned int seed;
+    int exposure_lines;
+    long wedge_after;
+} mock_options_t;
+
+static mock_options_t s_opts;
+static char *s_files[MOCK_MAX_FILES];
+static int s_file_count = 0;
+static int s_next_file = 0;
+static int64_t s_next_frame_us = 0;
+static long s_frames_since_init = 0;
+static SemaphoreHandle_t s_lock = NULL;       // file cursor, pacing and random state
+static SemaphoreHandle_t s_fb_slots = NULL;   // free frame buffers
+static sensor_t s_sensor;
+static bool s_initialized = false;
+
+static camera_sensor_info_t s_sensor_info = {
+    .model = 0,
+    .name = "OV2640 (mock)",
+    .sccb_addr = 0x30,
+    .pid = OV2640_PID,
+    .max_size = FRAMESIZE_UXGA,
+    .support_jpeg = true,
+};
+
+static long env_long(const char *name, long def){
+    const char *v = getenv(name);
+    return (v && *v) ? strtol(v, NULL, 10) : def;
+}
+
+static void load_options(void){
+    const char *dir = getenv("MOCK_CAMERA_DIR");
+    strlcpy(s_opts.dir, (dir && *dir) ? dir : "frames", sizeof(s_opts.dir));
+    s_opts.fps = (int)env_long("MOCK_CAMERA_FPS", 10);
+    s_opts.size_min = (size_t)env_long("MOCK_CAMERA_SIZE_MIN", 0);
+    s_opts.size_max = (size_t)env_long("MOCK_CAMERA_SIZE_MAX", (long)s_opts.size_min);
+    if (s_opts.size_max < s_opts.size_min) s_opts.size_max = s_opts.size_min;
+    s_opts.random = env_long("MOCK_CAMERA_RANDOM", 0) != 0;
+    s_opts.seed = (unsigned int)env_long("MOCK_CAMERA_SEED", 1);
+    s_opts.exposure_lines = (int)env_long("MOCK_CAMERA_EXPOSURE", 300);
+    s_opts.wedge_after = env_long("MOCK_CAMERA_WEDGE_AFTER", 0);
+}
+
+static int name_cmp(const void *a, const void *b){
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool is_jpeg_name(const char *name){
+    const char *dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0);
+}
+
+static void free_files(void){
+    for (int i = 0; i < s_file_count; i++) {
+        free(s_files[i]);
+        s_files[i] = NULL;
+    }
+    s_file_count = 0;
+}
+
+static esp_err_t scan_frames(void){
+    DIR *d = opendir(s_opts.dir);
+    if (!d) {
+        ESP_LOGE(TAG, "Cannot open frame directory %s", s_opts.dir);
+        return ESP_ERR_NOT_FOUND;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL && s_file_count < MOCK_MAX_FILES) {
+        if (!is_jpeg_name(ent->d_name)) continue;
+        char path[MOCK_PATH_MAX];
+        if (snprintf(path, sizeof(path), "%s/%s", s_opts.dir, ent->d_name) >= (int)sizeof(path)) continue;
+        char *copy = strdup(path);
+        if (!copy) break;
+        s_files[s_file_count++] = copy;
+    }
+    closedir(d);
+    if (s_file_count == 0) {
+        ESP_LOGE(TAG, "No JPEG files in %s", s_opts.dir);
+        return ESP_ERR_NOT_FOUND;
+    }
+    qsort(s_files, s_file_count, sizeof(s_files[0]), name_cmp);
+    return ESP_OK;
+}
+
+/**
+ * @brief Pick the next source file and wait for its frame slot
+ *
+ * @param target_len Receives the padded frame size (0 = no padding)
+ * @return const char* Path of the source JPEG
+ */
+static const char *next_frame(size_t *target_len){
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int index = s_opts.random ? (int)(rand_r(&s_opts.seed) % s_file_count) : s_next_file;
+    s_next_file = (s_next_file + 1) % s_file_count;
+    size_t target = s_opts.size_min;
+    if (s_opts.size_max > s_opts.size_min) {
+        target += (size_t)rand_r(&s_opts.seed) % (s_opts.size_max - s_opts.size_min + 1);
+    }
+    int64_t due = s_next_frame_us;
+    int64_t now = esp_timer_get_time();
+    if (s_opts.fps > 0) {
+        int64_t period = 1000000 / s_opts.fps;
+        s_next_frame_us = (due > now ? due : now) + period;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (due > now) {
+        vTaskDelay(pdMS_TO_TICKS((due - now + 999) / 1000));
+    }
+    *target_len = target;
+    return s_files[index];
+}
+
+/**
+ * @brief Read a JPEG and pad it after SOI with COM segments up to a target size
+ *
+ * @param path Source JPEG
+ * @param target_len Wanted size, ignored when not larger than the file
+ * @param out_len Receives the frame length
+ * @return uint8_t* Frame data (free to release), NULL on error
+ */
+static uint8_t *load_frame(const char *path, size_t target_len, size_t *out_len){
+    struct stat st;
+    if (stat(path, &st) != 0 || st.st_size < 4) return NULL;
+    size_t src_len = (size_t)st.st_size;
+    size_t pad = target_len > src_len ? target_len - src_len : 0;
+    if (pad > 0 && pad < 4) pad = 4;   // smallest COM segment
+
+    uint8_t *buf = malloc(src_len + pad);
+    if (!buf) return NULL;
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        free(buf);
+        return NULL;
+    }
+    /* SOI first, then the padding, then the rest of the file */
+    size_t got = fread(buf, 1, 2, f);
+    got += fread(buf + 2 + pad, 1, src_len - 2, f);
+    fclose(f);
+    if (got != src_len || buf[0] != 0xFF || buf[1] != 0xD8) {
+        free(buf);
+        return NULL;
+    }
+    uint8_t *p = buf + 2;
+    while (pad > 0) {
+        size_t seg = pad > COM_SEGMENT_MAX + 2 ? COM_SEGMENT_MAX + 2 : pad;
+        if (pad - seg > 0 && pad - seg < 4) seg -= 4;   // keep room for a last valid segment
+        p[0] = 0xFF;
+        p[1] = 0xFE;
+        p[2] = (uint8_t)((seg - 2) >> 8);
+        p[3] = (uint8_t)((seg - 2) & 0xFF);
+        memset(p + 4, 0, seg - 4);
+        p += seg;
+        pad -= seg;
+    }
+    *out_len = (size_t)(p - buf) + (src_len - 2);
+    return buf;
+}
+
+static int set_framesize(sensor_t *s, framesize_t framesize){
+    if (framesize >= FRAMESIZE_INVALID) return -1;
+    s->status.framesize = framesize;
+    return 0;
+}
+
+static int set_quality(sensor_t *s, int quality){ s->status.quality = quality; return 0; }
+static int set_brightness(sensor_t *s, int level){ s->status.brightness = level; return 0; }
+static int set_contrast(sensor_t *s, int level){ s->status.contrast = level; return 0; }
+static int set_saturation(sensor_t *s, int level){ s->status.saturation = level; return 0; }
+static int set_whitebal(sensor_t *s, int enable){ s->status.awb = enable; return 0; }
+static int set_awb_gain(sensor_t *s, int enable){ s->status.awb_gain = enable; return 0; }
+static int set_wb_mode(sensor_t *s, int mode){ s->status.wb_mode = mode; return 0; }
+static int set_exposure_ctrl(sensor_t *s, int enable){ s->status.aec = enable; return 0; }
+static int set_aec2(sensor_t *s, int enable){ s->status.aec2 = enable; return 0; }
+static int set_ae_level(sensor_t *s, int level){ s->status.ae_level = level; return 0; }
+static int set_aec_value(sensor_t *s, int value){ s->status.aec_value = value; return 0; }
+static int set_gain_ctrl(sensor_t *s, int enable){ s->status.agc = enable; return 0; }
+static int set_agc_gain(sensor_t *s, int gain){ s->status.agc_gain = gain; return 0; }
+static int set_gainceiling(sensor_t *s, gainceiling_t ceiling){ s->status.gainceiling = ceiling; return 0; }
+static int set_bpc(sensor_t *s, int enable){ s->status.bpc = enable; return 0; }
+static int set_wpc(sensor_t *s, int enable){ s->status.wpc = enable; return 0; }
+static int set_raw_gma(sensor_t *s, int enable){ s->status.raw_gma = enable; return 0; }
+static int set_lenc(sensor_t *s, int enable){ s->status.lenc = enable; return 0; }
+static int set_hmirror(sensor_t *s, int enable){ s->status.hmirror = enable; return 0; }
+static int set_vflip(sensor_t *s, int enable){ s->status.vflip = enable; return 0; }
+static int set_dcw(sensor_t *s, int enable){ s->status.dcw = enable; return 0; }
+
+/**
+ * @brief OV2640 sensor-bank registers the recorder reads for its light estimate
+ *
+ * With AEC on the exposure comes from MOCK_CAMERA_EXPOSURE, otherwise from the
+ * manual value. Gain is reported as 1x with AGC on.
+ */
+static int get_reg(sensor_t *s, int reg, int mask){
+    int aec = s->status.aec ? s_opts.exposure_lines : s->status.aec_value;
+    int gain = s->status.agc ? 0 : s->status.agc_gain;
+    int value;
+    switch (reg) {
+    case 0x145: value = (aec >> 10) & 0x3F; break;
+    case 0x110: value = (aec >> 2) & 0xFF; break;
+    case 0x104: value = aec & 0x03; break;
+    case 0x100: value = gain; break;
+    default: value = 0; break;
+    }
+    return value & mask;
+}
+
+static int set_reg(sensor_t *s, int reg, int mask, int value){
+    (void)s; (void)reg; (void)mask; (void)value;
+    return 0;
+}
+
+static void init_sensor(const camera_config_t *config){
+    memset(&s_sensor, 0, sizeof(s_sensor));
+    s_sensor.id.PID = OV2640_PID;
+    s_sensor.slv_addr = 0x30;
+    s_sensor.pixformat = config->pixel_format;
+    s_sensor.status.framesize = config->frame_size;
+    s_sensor.status.quality = config->jpeg_quality;
+    s_sensor.status.aec = 1;
+    s_sensor.status.agc = 1;
+    s_sensor.set_framesize = set_framesize;
+    s_sensor.set_quality = set_quality;
+    s_sensor.set_brightness = set_brightness;
+    s_sensor.set_contrast = set_contrast;
+    s_sensor.set_saturation = set_saturation;
+    s_sensor.set_whitebal = set_whitebal;
+    s_sensor.set_awb_gain = set_awb_gain;
+    s_sensor.set_wb_mode = set_wb_mode;
+    s_sensor.set_exposure_ctrl = set_exposure_ctrl;
+    s_sensor.set_aec2 = set_aec2;
+    s_sensor.set_ae_level = set_ae_level;
+    s_sensor.set_aec_value = set_aec_value;
+    s_sensor.set_gain_ctrl = set_gain_ctrl;
+    s_sensor.set_agc_gain = set_agc_gain;
+    s_sensor.set_gainceiling = set_gainceiling;
+    s_sensor.set_bpc = set_bpc;
+    s_sensor.set_wpc = set_wpc;
+    s_sensor.set_raw_gma = set_raw_gma;
+    s_sensor.set_lenc = set_lenc;
+    s_sensor.set_hmirror = set_hmirror;
+    s_sensor.set_vflip = set_vflip;
+    s_sensor.set_dcw = set_dcw;
+    s_sensor.get_reg = get_reg;
+    s_sensor.set_reg = set_reg;
+}
+
+/**
+ * @brief Start replaying frames
+ *
+ * @param config Camera configuration (pixel format must be JPEG)
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t esp_camera_init(const camera_config_t *config){
+    if (!config || config->pixel_format != PIXFORMAT_JPEG) return ESP_ERR_NOT_SUPPORTED;
+    if (s_initialized) return ESP_ERR_INVALID_STATE;
+
+    load_options();
+    esp_err_t err = scan_frames();
+    if (err != ESP_OK) return err;
+
+    size_t fb_count = config->fb_count ? config->fb_count : 1;
+    s_lock = xSemaphoreCreateMutex();
+    s_fb_slots = xSemaphoreCreateCounting(fb_count, fb_count);
+    if (!s_lock || !s_fb_slots) {
+        esp_camera_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    init_sensor(config);
+    s_next_file = 0;
+    s_next_frame_us = 0;
+    s_frames_since_init = 0;
+    s_initialized = true;
+    ESP_LOGI(TAG, "Replaying %d frames from %s at %d fps, %u-%u bytes, %u buffers",
+             s_file_count, s_opts.dir, s_opts.fps, (unsigned)s_opts.size_min, (unsigned)s_opts.size_max,
+             (unsigned)fb_count);
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit(void){
+    if (s_lock) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+    }
+    if (s_fb_slots) {
+        vSemaphoreDelete(s_fb_slots);
+        s_fb_slots = NULL;
+    }
+    free_files();
+    s_initialized = false;
+    return ESP_OK;
+}
+
+/**
+ * @brief Get the next replayed frame
+ *
+ * @return camera_fb_t* Frame, or NULL when no buffer frees up in time, the file cannot be read
+ *         or the simulated sensor is wedged
+ */
+camera_fb_t *esp_camera_fb_get(void){
+    if (!s_initialized) return NULL;
+    if (s_opts.wedge_after > 0 &&
+        __atomic_fetch_add(&s_frames_since_init, 1, __ATOMIC_RELAXED) >= s_opts.wedge_after) {
+        /* Like a sensor that stopped sending VSYNC: the driver times out */
+        vTaskDelay(pdMS_TO_TICKS(MOCK_FB_TIMEOUT_MS));
+        ESP_LOGW(TAG, "Failed to get the frame on time!");
+        return NULL;
+    }
+    if (xSemaphoreTake(s_fb_slots, pdMS_TO_TICKS(MOCK_FB_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Failed to get the frame on time!");
+        return NULL;
+    }
+    size_t target_len = 0;
+    const char *path = next_frame(&target_len);
+
+    camera_fb_t *fb = calloc(1, sizeof(*fb));
+    if (fb) {
+        fb->buf = load_frame(path, target_len, &fb->len);
+    }
+    if (!fb || !fb->buf) {
+        ESP_LOGW(TAG, "Failed to load frame %s", path);
+        free(fb);
+        xSemaphoreGive(s_fb_slots);
+        return NULL;
+    }
+    const resolution_info_t *res = &resolution[s_sensor.status.framesize];
+    fb->width = res->width;
+    fb->height = res->height;
+    fb->format = PIXFORMAT_JPEG;
+    /* The driver stamps frames with esp_timer time, not the wall clock */
+    int64_t now_us = esp_timer_get_time();
+    fb->timestamp.tv_sec = now_us / 1000000;
+    fb->timestamp.tv_usec = now_us % 1000000;
+    return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb){
+    if (!fb) return;
+    free(fb->buf);
+    free(fb);
+    if (s_fb_slots) xSemaphoreGive(s_fb_slots);
+}
+
+sensor_t *esp_camera_sensor_get(void){
+    return s_initialized ? &s_sensor : NULL;
+}
+
+camera_sensor_info_t *esp_camera_sensor_get_info(sensor_id_t *id){
+    return (id && id->PID == OV2640_PID) ? &s_sensor_info : NULL;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file main.c
+ * @author xholanp00
+ * @brief Host entry point: camera node handlers on localhost with a mock camera
+ *
+ * Environment:
+ *   HOST_DATA_DIR  directory standing in for the SD card (default "data")
+ *   HOST_WWW_DIR   frontend files served as /spiffs (default "../spiffs")
+ *   MOCK_CAMERA_*  frame source, see components/esp32-camera/mock_camera.c
+ *   HOST_QUEUE_STRESS  "1" runs the capture queue stress test and exits with its result
+ *   HOST_QUEUE_STRESS_TOTAL  requests pushed by the stress test (default QUEUE_STRESS_TOTAL)
+ */
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "recorder.h"
+#include "file_server.h"
+#include "photo_cache.h"
+#include "task_plan.h"
+#include "event_trace.h"
+#include "log_ring.h"
+#include "settings.h"
+#include "node_profile.h"
+#include "queue_stress.h"
+
+static const char *TAG = "host_main"; // Tag for logging
+
+static const char *env_or(const char *name, const char *def){
+    const char *v = getenv(name);
+    return (v && *v) ? v : def;
+}
+
+void app_main(void){
+    const char *data_dir = env_or("HOST_DATA_DIR", "data");
+    const char *www_dir = env_or("HOST_WWW_DIR", "../spiffs");
+    mkdir(data_dir, 0755);
+
+    /* No NVS on the host: settings start from defaults and are not persisted */
+    ESP_ERROR_CHECK(settings_init());
+    if (atoi(env_or("HOST_QUEUE_STRESS", "0"))) {
+        uint32_t total = strtoul(env_or("HOST_QUEUE_STRESS_TOTAL", "0"), NULL, 10);
+        exit(queue_stress_run(total ? total : QUEUE_STRESS_TOTAL) ? 1 : 0);
+    }
+    ESP_ERROR_CHECK(log_ring_init());
+    task_plan_log();
+    ESP_ERROR_CHECK(event_trace_init());
+    ESP_ERROR_CHECK(photo_cache_init(PHOTO_CACHE_CAPACITY_BYTES));
+
+    esp_err_t err = recorder_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Mock camera failed to start (%s); set MOCK_CAMERA_DIR to a directory of JPEGs",
+                 esp_err_to_name(err));
+        exit(1);
+    }
+
+    ESP_ERROR_CHECK(example_start_file_server(www_dir, data_dir));
+    node_profile_ready();
+    ESP_LOGI(TAG, "Serving %s as the SD card on http://localhost:8080 (MJPEG on port 8081)", data_dir);
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(10000));
+    }
+}
@@ -0,0 +1,233 @@
+/**
+ * @file queue_stress.c
+ * @author xholanp00
+ * @brief Multi-producer stress run of the capture request slot table
+ *
+ * Several producers push as fast as the slots allow while one worker pops,
+ * holds and releases them and an observer keeps taking snapshots, as the
+ * HTTP handlers, the recorder worker and /metrics do on the device. Every
+ * request must come out exactly once, in order per producer, and the
+ * counters must add up when the queue drains. All tasks share a priority and
+ * only yield to each other, so the run is bound by the queue, not the tick.
+ */
+
+#include "queue_stress.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "capture_queue.h"
+#include "settings.h"
+
+static const char *TAG = "queue_stress"; // Tag for logging
+
+#define STRESS_PRODUCERS 4
+#define STRESS_PRIORITY 5
+
+typedef struct {
+    uint32_t per_producer;
+    uint32_t errors;                           // guarded by s_errors_lock
+    QueueHandle_t done;                        // each task posts once when it finishes
+    QueueHandle_t stop;                        // holds an item once the observer should stop
+    uint32_t rejected[STRESS_PRODUCERS];       // ESP_ERR_NO_MEM seen by each producer
+    uint32_t next[STRESS_PRODUCERS];           // next request number expected from each producer
+    uint32_t last_seq[STRESS_PRODUCERS];
+    uint32_t results[3];                       // outcomes handed to done, indexed by capture_outcome_t
+    uint32_t snapshots;
+    uint32_t max_snapshot;
+} stress_state_t;
+
+static stress_state_t s_st;
+static portMUX_TYPE s_errors_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            portENTER_CRITICAL(&s_errors_lock); \
+            s_st.errors++; \
+            portEXIT_CRITICAL(&s_errors_lock); \
+            ESP_LOGE(TAG, __VA_ARGS__); \
+        } \
+    } while (0)
+
+static uint32_t xorshift(uint32_t *x){
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+static void producer_task(void *arg){
+    int id = (int)(intptr_t)arg;
+    uint32_t rng = 0x9E3779B9u * (id + 1);
+    capture_request_t req = {0};
+    snprintf(req.trigger, sizeof(req.trigger), "p%d", id);
+    for (uint32_t n = 0; n < s_st.per_producer; ) {
+        req.requested_ms = ((uint64_t)id << 32) | (uint32_t)n;
+        snprintf(req.path, sizeof(req.path), "/data/pictures/p%d-%" PRIu32 ".jpg", id, n);
+        esp_err_t err = capture_queue_push(&req, 0);
+        if (err != ESP_OK) {
+            CHECK(err == ESP_ERR_NO_MEM, "producer %d: push returned %s", id, esp_err_to_name(err));
+            s_st.rejected[id]++;
+            /* Full: let the worker drain a slot */
+            taskYIELD();
+            continue;
+        }
+        n++;
+        if ((xorshift(&rng) & 7) == 0) taskYIELD();
+    }
+    uint8_t one = 1;
+    xQueueSend(s_st.done, &one, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+static void worker_task(void *arg){
+    (void)arg;
+    uint32_t rng = 12345;
+    uint32_t total = s_st.per_producer * STRESS_PRODUCERS;
+    for (uint32_t popped = 0; popped < total; ) {
+        capture_request_t req;
+        int slot = capture_queue_pop(&req, pdMS_TO_TICKS(5000));
+        if (slot < 0) {
+            CHECK(false, "worker: pop timed out after %" PRIu32 " requests", popped);
+            break;
+        }
+        popped++;
+        int id = (int)(req.requested_ms >> 32);
+        uint32_t n = (uint32_t)req.requested_ms;
+        char path[CAPTURE_PATH_MAX];
+        snprintf(path, sizeof(path), "/data/pictures/p%d-%" PRIu32 ".jpg", id, n);
+        if (id < 0 || id >= STRESS_PRODUCERS) {
+            CHECK(false, "worker: request from unknown producer %d", id);
+        } else {
+            /* One queue, so each producer's requests come out in the order it pushed them */
+            CHECK(n == s_st.next[id], "worker: p%d request %" PRIu32 ", expected %" PRIu32, id, n, s_st.next[id]);
+            CHECK(s_st.next[id] == 0 || (int32_t)(req.seq - s_st.last_seq[id]) > 0,
+                  "worker: p%d seq %" PRIu32 " after %" PRIu32, id, req.seq, s_st.last_seq[id]);
+            CHECK(strcmp(req.path, path) == 0, "worker: slot %d holds %s, expected %s", slot, req.path, path);
+            CHECK(req.state == CAPTURE_SLOT_ACTIVE, "worker: popped slot %d in state %d", slot, req.state);
+            s_st.next[id] = n + 1;
+            s_st.last_seq[id] = req.seq;
+        }
+        /* Hold some requests while the producers run into the full table */
+        if ((xorshift(&rng) & 3) == 0) taskYIELD();
+        capture_outcome_t r = (xorshift(&rng) % 8 == 0) ? CAPTURE_DONE_FAILED + (xorshift(&rng) & 1) : CAPTURE_DONE_OK;
+        s_st.results[r]++;
+        capture_queue_done(slot, r);
+    }
+    uint8_t one = 1;
+    xQueueSend(s_st.done, &one, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+static void observer_task(void *arg){
+    (void)arg;
+    capture_request_t snap[CAPTURE_QUEUE_LEN];
+    while (uxQueueMessagesWaiting(s_st.stop) == 0) {
+        size_t n = capture_queue_snapshot(snap, CAPTURE_QUEUE_LEN);
+        s_st.snapshots++;
+        if (n > s_st.max_snapshot) s_st.max_snapshot = n;
+        CHECK(n <= CAPTURE_QUEUE_LEN, "snapshot: %u requests", (unsigned)n);
+        int active = 0;
+        for (size_t i = 0; i < n; i++) {
+            CHECK(snap[i].state == CAPTURE_SLOT_PENDING || snap[i].state == CAPTURE_SLOT_ACTIVE,
+                  "snapshot: state %d", snap[i].state);
+            if (snap[i].state == CAPTURE_SLOT_ACTIVE) active++;
+            CHECK(i == 0 || (int32_t)(snap[i].seq - snap[i - 1].seq) > 0,
+                  "snapshot: seq %" PRIu32 " after %" PRIu32, snap[i].seq, i ? snap[i - 1].seq : 0);
+        }
+        CHECK(active <= 1, "snapshot: %d active requests with one worker", active);
+        taskYIELD();
+    }
+    uint8_t one = 1;
+    xQueueSend(s_st.done, &one, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Run the stress test against the real capture_queue
+ *
+ * Must run before recorder_init(), whose worker would also pop requests.
+ *
+ * @param total Requests to push, split evenly over the producers
+ * @return int Number of failed checks (0 = pass)
+ */
+int queue_stress_run(uint32_t total){
+    memset(&s_st, 0, sizeof(s_st));
+    s_st.per_producer = total / STRESS_PRODUCERS ? total / STRESS_PRODUCERS : 1;
+    total = s_st.per_producer * STRESS_PRODUCERS;
+    s_st.done = xQueueCreate(STRESS_PRODUCERS + 2, sizeof(uint8_t));
+    s_st.stop = xQueueCreate(1, sizeof(uint8_t));
+    if (!s_st.done || !s_st.stop || capture_queue_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the queues");
+        return 1;
+    }
+    uint32_t depth = settings_get(SETTING_CAPTURE_QUEUE_DEPTH);
+    if (depth > CAPTURE_QUEUE_LEN) depth = CAPTURE_QUEUE_LEN;
+    ESP_LOGI(TAG, "%d producers x %" PRIu32 " requests, %" PRIu32 " of %d slots", STRESS_PRODUCERS,
+             s_st.per_producer, depth, CAPTURE_QUEUE_LEN);
+
+    xTaskCreate(observer_task, "q_observer", 4096, NULL, STRESS_PRIORITY, NULL);
+    xTaskCreate(worker_task, "q_worker", 4096, NULL, STRESS_PRIORITY, NULL);
+    for (int i = 0; i < STRESS_PRODUCERS; i++) {
+        xTaskCreate(producer_task, "q_producer", 4096, (void *)(intptr_t)i, STRESS_PRIORITY, NULL);
+    }
+    uint8_t one;
+    for (int i = 0; i < STRESS_PRODUCERS + 1; i++) {
+        xQueueReceive(s_st.done, &one, portMAX_DELAY);
+    }
+    xQueueSend(s_st.stop, &one, portMAX_DELAY);
+    xQueueReceive(s_st.done, &one, portMAX_DELAY);
+    vQueueDelete(s_st.done);
+    vQueueDelete(s_st.stop);
+
+    capture_queue_stats_t st;
+    capture_queue_get_stats(&st);
+    uint32_t rejected = 0;
+    for (int i = 0; i < STRESS_PRODUCERS; i++) {
+        rejected += s_st.rejected[i];
+        CHECK(s_st.next[i] == s_st.per_producer, "p%d: %" PRIu32 " of %" PRIu32 " requests came out", i,
+              s_st.next[i], s_st.per_producer);
+    }
+    CHECK(st.pushed == total, "pushed %" PRIu32 ", expected %" PRIu32, st.pushed, total);
+    CHECK(st.rejected == rejected, "rejected %" PRIu32 ", producers saw %" PRIu32, st.rejected, rejected);
+    CHECK(st.completed == s_st.results[CAPTURE_DONE_OK], "completed %" PRIu32 ", expected %" PRIu32, st.completed,
+          s_st.results[CAPTURE_DONE_OK]);
+    CHECK(st.failed == s_st.results[CAPTURE_DONE_FAILED], "failed %" PRIu32 ", expected %" PRIu32, st.failed,
+          s_st.results[CAPTURE_DONE_FAILED]);
+    CHECK(st.duplicates == s_st.results[CAPTURE_DONE_DUPLICATE], "duplicates %" PRIu32 ", expected %" PRIu32,
+          st.duplicates, s_st.results[CAPTURE_DONE_DUPLICATE]);
+    CHECK(st.pending == 0 && st.active == 0, "%" PRIu32 " pending and %" PRIu32 " active after draining",
+          st.pending, st.active);
+    CHECK(st.high_water >= 1 && st.high_water <= depth, "high_water %" PRIu32 " outside 1..%" PRIu32,
+          st.high_water, depth);
+    CHECK(rejected == 0 || st.high_water == depth, "rejections with high_water %" PRIu32 " below depth %" PRIu32,
+          st.high_water, depth);
+    CHECK(s_st.max_snapshot <= st.high_water, "snapshot of %" PRIu32 " above high_water %" PRIu32,
+          s_st.max_snapshot, st.high_water);
+
+    /* Every slot must be free again: a full table's worth of pushes fits */
+    capture_request_t snap[CAPTURE_QUEUE_LEN];
+    CHECK(capture_queue_snapshot(snap, CAPTURE_QUEUE_LEN) == 0, "slots still in use after draining");
+    capture_request_t req = { .trigger = "drain" };
+    int refilled = 0;
+    for (uint32_t i = 0; i < depth; i++) {
+        snprintf(req.path, sizeof(req.path), "/data/pictures/drain-%" PRIu32 ".jpg", i);
+        if (capture_queue_push(&req, 0) == ESP_OK) refilled++;
+    }
+    CHECK(refilled == (int)depth, "only %d of %" PRIu32 " slots could be refilled", refilled, depth);
+    CHECK(capture_queue_push(&req, 0) == ESP_ERR_NO_MEM, "push past the depth limit was accepted");
+    for (int i = 0; i < refilled; i++) {
+        int slot = capture_queue_pop(&req, 0);
+        CHECK(slot >= 0, "refilled request %d missing", i);
+        capture_queue_done(slot, CAPTURE_DONE_OK);
+    }
+
+    ESP_LOGI(TAG, "%s: %" PRIu32 " requests, %" PRIu32 " rejected pushes, high_water %" PRIu32 ", %" PRIu32
+             " snapshots, %" PRIu32 " failed checks", s_st.errors ? "FAIL" : "PASS", total, rejected,
+             st.high_water, s_st.snapshots, s_st.errors);
+    return (int)s_st.errors;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Requests pushed by a run when HOST_QUEUE_STRESS_TOTAL is not set */
+#ifndef QUEUE_STRESS_TOTAL
+#define QUEUE_STRESS_TOTAL 1000000
+#endif
+
+// Push `total` requests into the capture request queue from several tasks; returns the number of failed checks
+int queue_stress_run(uint32_t total);
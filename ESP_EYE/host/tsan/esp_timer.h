@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Microseconds from CLOCK_MONOTONIC
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,23 @@
+#pragma once
+
+/* Just enough of FreeRTOS for capture_queue.c and queue_stress.c on pthreads */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))   // 1 kHz tick
+
+/* A critical section is a mutex per portMUX, which ThreadSanitizer understands */
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_MUTEX_INITIALIZER
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux) pthread_mutex_unlock(mux)
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *QueueHandle_t;
+typedef struct { uint8_t opaque[80]; } StaticQueue_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size);
+QueueHandle_t xQueueCreateStatic(UBaseType_t len, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *unused);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <sched.h>
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// Runs the task on a detached thread; stack size and priority are ignored
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out);
+
+// Only a task deleting itself (NULL) is supported
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+
+#define taskYIELD() sched_yield()
@@ -0,0 +1,214 @@
+/**
+ * @file freertos_pthread.c
+ * @author xholanp00
+ * @brief FreeRTOS calls used by the capture queue stress test, on pthreads
+ *
+ * The IDF linux target runs every task on one host thread at a time, so
+ * ThreadSanitizer cannot see the interleavings there. This shim gives each
+ * task its own thread and each portMUX its own mutex, so the real
+ * capture_queue.c runs truly in parallel under -fsanitize=thread.
+ *
+ * Environment:
+ *   QUEUE_STRESS_TOTAL  requests pushed (default QUEUE_STRESS_TOTAL)
+ *   QUEUE_STRESS_DEPTH  value of the queue_depth setting (default CAPTURE_QUEUE_LEN)
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "settings.h"
+#include "capture_queue.h"
+#include "queue_stress.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t *storage;
+    bool owns_storage;
+    size_t item_size;
+    size_t len;
+    size_t head;
+    size_t count;
+} queue_t;
+
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+} task_start_t;
+
+/**
+ * @brief Absolute CLOCK_REALTIME deadline `wait` ticks from now
+ *
+ * @param ts Deadline out
+ * @param wait Ticks (milliseconds)
+ */
+static void deadline(struct timespec *ts, TickType_t wait){
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += wait / 1000;
+    ts->tv_nsec += (long)(wait % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * @brief Wait on the queue's condition until `ready` holds or the wait runs out
+ *
+ * @param q Queue, locked
+ * @param want_space true to wait for space, false to wait for an item
+ * @param wait Ticks to wait, portMAX_DELAY for ever
+ * @return true once the condition holds
+ */
+static bool wait_for(queue_t *q, bool want_space, TickType_t wait){
+    struct timespec ts;
+    deadline(&ts, wait);
+    while (want_space ? q->count == q->len : q->count == 0) {
+        if (wait == 0) return false;
+        if (wait == portMAX_DELAY) {
+            pthread_cond_wait(&q->changed, &q->lock);
+        } else if (pthread_cond_timedwait(&q->changed, &q->lock, &ts) == ETIMEDOUT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t len, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *unused){
+    (void)unused;
+    queue_t *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->storage = storage;
+    q->item_size = item_size;
+    q->len = len;
+    return q;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size){
+    uint8_t *storage = calloc(len, item_size);
+    queue_t *q = storage ? xQueueCreateStatic(len, item_size, storage, NULL) : NULL;
+    if (!q) {
+        free(storage);
+        return NULL;
+    }
+    q->owns_storage = true;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue){
+    queue_t *q = queue;
+    pthread_cond_destroy(&q->changed);
+    pthread_mutex_destroy(&q->lock);
+    if (q->owns_storage) free(q->storage);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait){
+    queue_t *q = queue;
+    pthread_mutex_lock(&q->lock);
+    bool ok = wait_for(q, true, wait);
+    if (ok) {
+        memcpy(q->storage + (q->head + q->count) % q->len * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait){
+    queue_t *q = queue;
+    pthread_mutex_lock(&q->lock);
+    bool ok = wait_for(q, false, wait);
+    if (ok) {
+        memcpy(item, q->storage + q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->len;
+        q->count--;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue){
+    queue_t *q = queue;
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+static void *task_thread(void *arg){
+    task_start_t start = *(task_start_t *)arg;
+    free(arg);
+    start.fn(start.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out){
+    (void)name;
+    (void)stack;
+    (void)prio;
+    task_start_t *start = malloc(sizeof(*start));
+    if (!start) return pdFALSE;
+    start->fn = fn;
+    start->arg = arg;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_thread, start) != 0) {
+        free(start);
+        return pdFALSE;
+    }
+    pthread_detach(thread);
+    if (out) *out = NULL;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task){
+    (void)task;
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks){
+    usleep((useconds_t)ticks * 1000);
+}
+
+int64_t esp_timer_get_time(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+const char *esp_err_to_name(esp_err_t code){
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    default: return "ESP_ERR_UNKNOWN";
+    }
+}
+
+/* Only the queue depth is read by capture_queue.c and the stress test */
+int32_t settings_get(setting_id_t id){
+    const char *depth = getenv("QUEUE_STRESS_DEPTH");
+    if (id == SETTING_CAPTURE_QUEUE_DEPTH && depth && *depth) return atoi(depth);
+    return CAPTURE_QUEUE_LEN;
+}
+
+int main(void){
+    const char *total = getenv("QUEUE_STRESS_TOTAL");
+    uint32_t n = total && *total ? strtoul(total, NULL, 10) : 0;
+    return queue_stress_run(n ? n : QUEUE_STRESS_TOTAL) ? 1 : 0;
+}
@@ -11,12 +11,24 @@
 #include "esp_err.h"
 #include "nvs_flash.h"
 #include "esp_vfs.h"
+#include "node_profile.h"
+#if NODE_HAS_WEB_UI
 #include "esp_spiffs.h"
+#endif
 #include "recorder.h"
 #include "wifi_helpers.h"
+#if NODE_HAS_CAPTURE
 #include "sd_card_helpers.h"
+#endif
 #include "file_server.h"
-#include "driver/gpio.h"
+#include "photo_cache.h"
+#include "task_plan.h"
+#include "event_trace.h"
+#include "log_ring.h"
+#include "settings.h"
+#include "power_ctl.h"
+
+static const char *TAG = "main"; // Tag for logging
 
 void app_main(void){
     /* Initialize NVS and network stack */
@@ -26,31 +38,47 @@ void app_main(void){
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    // Runtime knobs stored in NVS (GET/PATCH /settings)
+    ESP_ERROR_CHECK(settings_init());
+    // Buffered logging: console output moves to a low-priority task
+    ESP_ERROR_CHECK(log_ring_init());
+    // Cores and priorities of the camera node tasks
+    task_plan_log();
+    // Trace rings (no-op unless CONFIG_EVENT_TRACE_ENABLE)
+    ESP_ERROR_CHECK(event_trace_init());
+    node_profile_mark("nvs");
+
+    // Idle CPU frequency and light sleep; set up before Wi-Fi starts.
+    // Without it the node still works, only at a fixed clock.
+    ret = power_ctl_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Power management off (%s), running at a fixed CPU clock", esp_err_to_name(ret));
+    }
+
     // Initialize the TCP/IP stack
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
     // Initialize Wi-Fi in AP mode
     ESP_ERROR_CHECK(wifi_helpers_init_ap("SS", "superSecret"));
+    node_profile_mark("wifi");
 
-    // Initialize the recorder component
-    ESP_ERROR_CHECK(recorder_init());
+#if NODE_HAS_CAPTURE
+    // PSRAM cache for recently served photos and their scaled variants
+    ESP_ERROR_CHECK(photo_cache_init(CONFIG_NODE_PHOTO_CACHE_KB * 1024));
+#endif
 
-    // Configure GPIO for recorder LED indication
-    gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << GPIO_NUM_4),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE
-    };
-    // Configure the GPIO with the given settings
-    gpio_config(&io_conf);
-    gpio_set_level(GPIO_NUM_4, 0);
+    // Initialize the recorder component (camera and PWM flash LED on GPIO 4)
+    ESP_ERROR_CHECK(recorder_init());
+    node_profile_mark("camera");
 
+#if NODE_HAS_CAPTURE
     // Mount SD card at /data
     ESP_ERROR_CHECK(sd_card_mount("/data"));
+    node_profile_mark("sd_card");
+#endif
 
+#if NODE_HAS_WEB_UI
     // Register SPIFFS at /spiffs
     esp_vfs_spiffs_conf_t spiffs_conf = {
         .base_path = "/spiffs",
@@ -60,9 +88,13 @@ void app_main(void){
     };
     // Register SPIFFS filesystem
     esp_vfs_spiffs_register(&spiffs_conf);
+    node_profile_mark("spiffs");
+#endif
 
     // Start the file server
     ESP_ERROR_CHECK(example_start_file_server("/spiffs", "/data"));
+    node_profile_mark("http");
+    node_profile_ready();
 
     // Main loop does nothing, all work is done in tasks
     while(1) {
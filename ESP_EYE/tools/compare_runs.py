@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Compare two loadgen.py results, e.g. the same load against two builds.
+
+  ./tools/loadgen.py --label legacy --duration 120 --output a.json
+  (flash the other build)
+  ./tools/loadgen.py --label plan --duration 120 --output b.json
+  ./tools/compare_runs.py a.json b.json
+
+Prints a Markdown table of the client-side figures (trigger latency,
+viewer fps, downloads) and of the node's own /metrics after the run
+(capture latency, stream reconnects, power, tracer cost). Counters that grow with
+uptime are shown per minute of the run. --metric adds any other value by
+its dotted path in the result, e.g. node_metrics.after.photo_cache.hits.
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import json
+import sys
+
+# (label, dotted path, "rate" for per-minute deltas of a counter, lower is better)
+DEFAULT_METRICS = [
+    ("trigger accept rate", "triggers.accept_rate", None, False),
+    ("trigger p50 ms", "triggers.latency_ms.p50", None, True),
+    ("trigger p99 ms", "triggers.latency_ms.p99", None, True),
+    ("viewer fps", "stream.fps_total", None, False),
+    ("download p50 ms", "gallery.download_latency_ms.p50", None, True),
+    ("download p99 ms", "gallery.download_latency_ms.p99", None, True),
+    ("download kB/s", "gallery.download_bytes_per_s", None, False),
+    ("gallery errors", "gallery.errors", None, True),
+    ("capture trigger_us_avg", "node_metrics.after.capture_latency.trigger_us_avg", None, True),
+    ("capture trigger_us_max", "node_metrics.after.capture_latency.trigger_us_max", None, True),
+    ("stream reconnects_last_min", "node_metrics.after.stream.reconnects_last_min", None, True),
+    ("stream reconnects/min", "node_metrics.{}.stream.reconnects", "rate", True),
+    ("power wakes/min", "node_metrics.{}.power.wakes", "rate", None),
+    ("power active %", "node_metrics.{}.power.active_ms", "duty", True),
+    ("trace core 0 ppm", "node_metrics.after.trace.cores.0.overhead_ppm", None, True),
+    ("trace core 1 ppm", "node_metrics.after.trace.cores.1.overhead_ppm", None, True),
+]
+
+
+def lookup(doc, path):
+    for part in path.split("."):
+        if isinstance(doc, list):
+            try:
+                doc = doc[int(part)]
+            except (ValueError, IndexError):
+                return None
+        elif isinstance(doc, dict):
+            doc = doc.get(part)
+        else:
+            return None
+        if doc is None:
+            return None
+    return doc if isinstance(doc, (int, float)) and not isinstance(doc, bool) else None
+
+
+def value(run, path, kind):
+    """One figure of a run; "rate" and "duty" use the before/after /metrics."""
+    if kind is None:
+        return lookup(run, path)
+    before, after = lookup(run, path.format("before")), lookup(run, path.format("after"))
+    if before is None or after is None:
+        return None
+    if kind == "duty":
+        up = lookup(run, "node_metrics.after.power.uptime_ms")
+        up0 = lookup(run, "node_metrics.before.power.uptime_ms")
+        return 100.0 * (after - before) / (up - up0) if up and up0 is not None and up > up0 else None
+    minutes = run.get("elapsed_s", 0) / 60.0
+    return (after - before) / minutes if minutes > 0 else None
+
+
+def fmt(v):
+    if v is None:
+        return "-"
+    return ("%.2f" % v).rstrip("0").rstrip(".") if isinstance(v, float) else str(v)
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("baseline", help="loadgen.py result of the reference build")
+    p.add_argument("candidate", help="loadgen.py result of the build under test")
+    p.add_argument("--metric", action="append", default=[], help="extra dotted path to compare")
+    args = p.parse_args()
+
+    runs = []
+    for path in (args.baseline, args.candidate):
+        with open(path) as f:
+            runs.append(json.load(f))
+    a, b = runs
+    if a.get("config") != b.get("config"):
+        print("warning: the runs used different loadgen settings", file=sys.stderr)
+
+    metrics = DEFAULT_METRICS + [(m, m, None, None) for m in args.metric]
+    names = [r.get("label") or path for r, path in zip(runs, (args.baseline, args.candidate))]
+    print("| metric | %s | %s | change |" % tuple(names))
+    print("|---|---|---|---|")
+    for label, path, kind, lower_better in metrics:
+        va, vb = value(a, path, kind), value(b, path, kind)
+        if va is None and vb is None:
+            continue
+        change = "-"
+        if va is not None and vb is not None:
+            change = fmt(vb - va if isinstance(vb - va, int) else round(vb - va, 2))
+            if va:
+                change += " (%+.1f %%)" % (100.0 * (vb - va) / va)
+            if lower_better is not None and vb != va:
+                change += " better" if (vb < va) == lower_better else " worse"
+        print("| %s | %s | %s | %s |" % (label, fmt(va), fmt(vb), change))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Compare JSON and CBOR responses of the camera node (device or host build).
+
+For each endpoint that negotiates its format (/photos, /photos/histogram,
+/metrics) the script requests both encodings R times and reports payload
+bytes, client-side latency and the device's own build time per response.
+Build time comes from the "encoding" section of /metrics: handler time
+outside socket sends, so it covers formatting and not the Wi-Fi link.
+Every CBOR body is decoded and checked against the JSON one.
+
+Usage: ./tools/encoding_bench.py --host 192.168.4.1 --repeat 20 --limit 200
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import http.client
+import json
+import struct
+import sys
+import time
+
+JSON = "application/json"
+CBOR = "application/cbor"
+
+
+def cbor_decode(data):
+    """Decode one CBOR item (the subset the device emits)."""
+    pos = 0
+
+    def arg(info):
+        nonlocal pos
+        if info < 24:
+            return info
+        n = {24: 1, 25: 2, 26: 4, 27: 8}[info]
+        v = int.from_bytes(data[pos:pos + n], "big")
+        pos += n
+        return v
+
+    def item():
+        nonlocal pos
+        ib = data[pos]
+        pos += 1
+        major, info = ib >> 5, ib & 31
+        if ib == 0xFF:
+            return StopIteration
+        if major == 0:
+            return arg(info)
+        if major == 1:
+            return -1 - arg(info)
+        if major in (2, 3):
+            n = arg(info)
+            raw = data[pos:pos + n]
+            pos += n
+            return raw.decode() if major == 3 else raw
+        if major in (4, 5):
+            out = []
+            n = None if info == 31 else arg(info) * (2 if major == 5 else 1)
+            while n is None or len(out) < n:
+                v = item()
+                if v is StopIteration:
+                    break
+                out.append(v)
+            return dict(zip(out[::2], out[1::2])) if major == 5 else out
+        if major == 7:
+            if info in (20, 21, 22):
+                return {20: False, 21: True, 22: None}[info]
+            if info == 26:
+                pos += 4
+                return round(struct.unpack(">f", data[pos - 4:pos])[0], 3)
+        raise ValueError("unsupported CBOR item 0x%02x" % ib)
+
+    value = item()
+    if pos != len(data):
+        raise ValueError("trailing bytes after CBOR item")
+    return value
+
+
+def get(args, path, accept):
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    start = time.monotonic()
+    try:
+        conn.request("GET", path, headers={"Accept": accept})
+        resp = conn.getresponse()
+        body = resp.read()
+        if resp.status != 200:
+            raise SystemExit("%s: HTTP %d" % (path, resp.status))
+        return resp.getheader("Content-Type", ""), body, (time.monotonic() - start) * 1000.0
+    finally:
+        conn.close()
+
+
+def decode(ctype, body):
+    return cbor_decode(body) if CBOR in ctype else json.loads(body)
+
+
+def encoding_stats(args, measured):
+    """Device counters, read in the format that is not being measured."""
+    accept = JSON if measured == CBOR else CBOR
+    ctype, body, _ = get(args, "/metrics", accept)
+    return decode(ctype, body)["encoding"]
+
+
+def same(a, b):
+    """Equal documents; floats (CBOR float32) compared to 3 places."""
+    if isinstance(a, float) or isinstance(b, float):
+        return round(float(a), 3) == round(float(b), 3)
+    if isinstance(a, dict) and isinstance(b, dict):
+        return a.keys() == b.keys() and all(same(a[k], b[k]) for k in a)
+    if isinstance(a, list) and isinstance(b, list):
+        return len(a) == len(b) and all(same(x, y) for x, y in zip(a, b))
+    return a == b
+
+
+def bench(args, path):
+    result = {"path": path}
+    bodies = {}
+    for accept, name in ((JSON, "json"), (CBOR, "cbor")):
+        before = encoding_stats(args, accept)[name]
+        sizes, latency = [], []
+        for _ in range(args.repeat):
+            ctype, body, ms = get(args, path, accept)
+            if name == "cbor" and CBOR not in ctype:
+                raise SystemExit("%s: no CBOR support (Content-Type %s)" % (path, ctype))
+            sizes.append(len(body))
+            latency.append(ms)
+            bodies[name] = body
+        after = encoding_stats(args, accept)[name]
+        n = after["responses"] - before["responses"]
+        result[name] = {
+            "bytes": round(sum(sizes) / len(sizes)),
+            "latency_ms": round(sum(latency) / len(latency), 2),
+            "build_us": round((after["build_us"] - before["build_us"]) / n) if n else None,
+        }
+    # /metrics counters move between the two requests; only the shape must match
+    if path != "/metrics":
+        result["cbor_matches_json"] = same(cbor_decode(bodies["cbor"]), json.loads(bodies["json"]))
+    result["cbor_size_ratio"] = round(result["cbor"]["bytes"] / result["json"]["bytes"], 3)
+    return result
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    p.add_argument("--host", default="192.168.4.1", help="camera node address")
+    p.add_argument("--port", type=int, default=80, help="HTTP port (8080 for the host build)")
+    p.add_argument("--repeat", type=int, default=10, help="requests per endpoint and format")
+    p.add_argument("--limit", type=int, default=200, help="page size for /photos (0 = whole listing)")
+    p.add_argument("--timeout", type=float, default=10.0, help="socket timeout in seconds")
+    p.add_argument("--output", default="-", help="result file, '-' for stdout")
+    args = p.parse_args()
+
+    photos = "/photos?limit=%d" % args.limit if args.limit else "/photos"
+    results = [bench(args, path) for path in (photos, "/photos/histogram", "/metrics")]
+    text = json.dumps(results, indent=2)
+    if args.output == "-":
+        print(text)
+    else:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+    for r in results:
+        print("%-24s json %6d B %6s us  cbor %6d B %6s us  (x%.2f)" % (
+            r["path"], r["json"]["bytes"], r["json"]["build_us"], r["cbor"]["bytes"], r["cbor"]["build_us"],
+            r["cbor_size_ratio"]), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
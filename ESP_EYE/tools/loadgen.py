@@ -0,0 +1,307 @@
+#!/usr/bin/env python3
+"""Mixed load generator for the camera node (device or host build).
+
+Drives, for a fixed duration and all at once:
+  * N sensors posting `capture:<ms> source:<name>` to POST /photo with
+    jittered timestamps and intervals,
+  * M MJPEG viewers on the stream port,
+  * G gallery clients listing /photos and downloading photos.
+
+Writes one JSON document with accept/reject rates, trigger latency
+percentiles, per-viewer fps and download throughput, plus the node's own
+/metrics and /memory before and after the run, so runs can be compared across builds.
+
+Usage: ./tools/loadgen.py --host 192.168.4.1 --sensors 4 --viewers 1 \
+           --gallery 2 --duration 60 --output run.json
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import http.client
+import json
+import math
+import random
+import socket
+import sys
+import threading
+import time
+
+
+def now_ms():
+    return int(time.time() * 1000)
+
+
+def percentiles(samples):
+    """Nearest-rank p50/p90/p99 and max of a list of milliseconds."""
+    if not samples:
+        return {"count": 0, "p50": None, "p90": None, "p99": None, "max": None}
+    s = sorted(samples)
+
+    def rank(p):
+        return round(s[min(len(s) - 1, max(0, math.ceil(len(s) * p / 100.0) - 1))], 2)
+
+    return {"count": len(s), "p50": rank(50), "p90": rank(90), "p99": rank(99), "max": round(s[-1], 2)}
+
+
+class Stats:
+    """Counters and samples shared by the worker threads."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.trigger_latency_ms = []
+        self.trigger_results = {}
+        self.viewers = []
+        self.list_latency_ms = []
+        self.download_latency_ms = []
+        self.download_bytes = 0
+        self.download_time_s = 0.0
+        self.gallery_errors = 0
+
+    def count_trigger(self, result, latency_ms):
+        with self.lock:
+            self.trigger_results[result] = self.trigger_results.get(result, 0) + 1
+            if latency_ms is not None:
+                self.trigger_latency_ms.append(latency_ms)
+
+
+def request(args, method, path, body=None, headers=None):
+    """One HTTP request on a fresh connection; returns (status, body, elapsed ms)."""
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    start = time.monotonic()
+    try:
+        conn.request(method, path, body=body, headers=headers or {})
+        resp = conn.getresponse()
+        data = resp.read()
+        return resp.status, data, (time.monotonic() - start) * 1000.0
+    finally:
+        conn.close()
+
+
+def sensor_worker(args, stats, index, stop):
+    """Fire triggers at a jittered interval with a jittered capture timestamp."""
+    rng = random.Random(args.seed * 1000 + index)
+    source = "load%d" % index
+    while not stop.is_set():
+        capture = now_ms() + rng.randint(-args.jitter_ms, args.jitter_ms)
+        body = "capture:%d source:%s" % (capture, source)
+        try:
+            status, data, elapsed = request(args, "POST", "/photo", body, {"Content-Type": "text/plain"})
+            if status == 200:
+                result = "accepted"
+            else:
+                try:
+                    result = "rejected_" + json.loads(data).get("reason", str(status))
+                except ValueError:
+                    result = "http_%d" % status
+            stats.count_trigger(result, elapsed)
+        except (OSError, http.client.HTTPException):
+            stats.count_trigger("error", None)
+        wait = args.trigger_interval * rng.uniform(0.5, 1.5)
+        stop.wait(wait)
+
+
+def read_line(f):
+    line = f.readline()
+    if not line:
+        raise ConnectionError("stream closed")
+    return line.strip()
+
+
+def viewer_worker(args, stats, index, stop):
+    """Read the MJPEG stream and count frames until the run ends."""
+    record = {"viewer": index, "frames": 0, "bytes": 0, "first_frame_ms": None, "fps": 0.0, "error": None}
+    start = time.monotonic()
+    first = None
+    last = None
+    try:
+        sock = socket.create_connection((args.host, args.stream_port), timeout=args.timeout)
+        f = sock.makefile("rb")
+        while read_line(f):   # response headers
+            pass
+        while not stop.is_set():
+            line = read_line(f)
+            if not line.startswith(b"--"):
+                continue
+            length = 0
+            while True:
+                line = read_line(f)
+                if not line:
+                    break
+                name, _, value = line.partition(b":")
+                if name.strip().lower() == b"content-length":
+                    length = int(value)
+            data = f.read(length)
+            if len(data) != length:
+                raise ConnectionError("short frame")
+            last = time.monotonic()
+            if first is None:
+                first = last
+                record["first_frame_ms"] = round((first - start) * 1000.0, 2)
+            record["frames"] += 1
+            record["bytes"] += length
+        sock.close()
+    except (OSError, ValueError, ConnectionError) as e:
+        if not stop.is_set():
+            record["error"] = str(e)
+    if first is not None and last is not None and last > first and record["frames"] > 1:
+        record["fps"] = round((record["frames"] - 1) / (last - first), 2)
+    with stats.lock:
+        stats.viewers.append(record)
+
+
+def gallery_worker(args, stats, index, stop):
+    """List photos, then download a few of them, like someone browsing."""
+    rng = random.Random(args.seed * 2000 + index)
+    while not stop.is_set():
+        try:
+            status, data, elapsed = request(args, "GET", "/photos")
+            if status != 200:
+                raise http.client.HTTPException("list status %d" % status)
+            with stats.lock:
+                stats.list_latency_ms.append(elapsed)
+            files = [f["name"] for f in json.loads(data).get("files", [])]
+            for name in rng.sample(files, min(len(files), args.downloads_per_page)):
+                if stop.is_set():
+                    break
+                path = "/photo/" + name + ("?scale=%d" % args.scale if args.scale > 1 else "")
+                status, body, elapsed = request(args, "GET", path)
+                with stats.lock:
+                    if status == 200:
+                        stats.download_latency_ms.append(elapsed)
+                        stats.download_bytes += len(body)
+                        stats.download_time_s += elapsed / 1000.0
+                    else:
+                        stats.gallery_errors += 1
+        except (OSError, ValueError, http.client.HTTPException):
+            with stats.lock:
+                stats.gallery_errors += 1
+        stop.wait(args.gallery_interval)
+
+
+def fetch_json(args, path):
+    try:
+        status, data, _ = request(args, "GET", path)
+        return json.loads(data) if status == 200 else None
+    except (OSError, ValueError, http.client.HTTPException):
+        return None
+
+
+def sync_time(args):
+    body = json.dumps({"time_ms": now_ms()})
+    status, _, _ = request(args, "POST", "/time", body, {"Content-Type": "application/json"})
+    if status != 200:
+        raise SystemExit("time sync failed: HTTP %d" % status)
+
+
+def summarize(args, stats, elapsed_s, metrics_before, metrics_after, memory_before, memory_after):
+    total = sum(stats.trigger_results.values())
+    accepted = stats.trigger_results.get("accepted", 0)
+    throughput = stats.download_bytes / stats.download_time_s if stats.download_time_s > 0 else 0.0
+    viewers = sorted(stats.viewers, key=lambda v: v["viewer"])
+    return {
+        "label": args.label,
+        "target": {"host": args.host, "port": args.port, "stream_port": args.stream_port},
+        "config": {
+            "duration_s": args.duration,
+            "sensors": args.sensors,
+            "trigger_interval_s": args.trigger_interval,
+            "jitter_ms": args.jitter_ms,
+            "viewers": args.viewers,
+            "gallery": args.gallery,
+            "downloads_per_page": args.downloads_per_page,
+            "scale": args.scale,
+            "seed": args.seed,
+        },
+        "elapsed_s": round(elapsed_s, 2),
+        "triggers": {
+            "sent": total,
+            "accepted": accepted,
+            "accept_rate": round(accepted / total, 4) if total else None,
+            "results": stats.trigger_results,
+            "latency_ms": percentiles(stats.trigger_latency_ms),
+        },
+        "stream": {
+            "viewers": viewers,
+            "fps_total": round(sum(v["fps"] for v in viewers), 2),
+        },
+        "gallery": {
+            "lists": len(stats.list_latency_ms),
+            "list_latency_ms": percentiles(stats.list_latency_ms),
+            "downloads": len(stats.download_latency_ms),
+            "download_latency_ms": percentiles(stats.download_latency_ms),
+            "download_bytes": stats.download_bytes,
+            "download_bytes_per_s": round(throughput, 1),
+            "errors": stats.gallery_errors,
+        },
+        "node_metrics": {"before": metrics_before, "after": metrics_after},
+        "node_memory": {"before": memory_before, "after": memory_after},
+    }
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    p.add_argument("--host", default="192.168.4.1", help="camera node address")
+    p.add_argument("--port", type=int, default=80, help="HTTP port (8080 for the host build)")
+    p.add_argument("--stream-port", type=int, default=8081, help="MJPEG port")
+    p.add_argument("--duration", type=float, default=30.0, help="run length in seconds")
+    p.add_argument("--sensors", type=int, default=2, help="simulated trigger sources")
+    p.add_argument("--trigger-interval", type=float, default=2.0, help="mean seconds between triggers per sensor")
+    p.add_argument("--jitter-ms", type=int, default=500, help="max +/- offset of the capture timestamp")
+    p.add_argument("--viewers", type=int, default=1, help="concurrent MJPEG viewers")
+    p.add_argument("--gallery", type=int, default=1, help="gallery clients")
+    p.add_argument("--downloads-per-page", type=int, default=4, help="photos downloaded per listing")
+    p.add_argument("--gallery-interval", type=float, default=1.0, help="seconds between gallery listings")
+    p.add_argument("--scale", type=int, default=1, choices=(1, 2, 4, 8), help="download scale (1 = original)")
+    p.add_argument("--timeout", type=float, default=10.0, help="socket timeout in seconds")
+    p.add_argument("--seed", type=int, default=1, help="seed for jitter and photo choice")
+    p.add_argument("--no-sync-time", action="store_true", help="do not POST /time before the run")
+    p.add_argument("--label", default="", help="free-form name stored in the result (e.g. firmware build)")
+    p.add_argument("--output", default="-", help="result file, '-' for stdout")
+    args = p.parse_args()
+
+    if not args.no_sync_time:
+        sync_time(args)
+
+    stats = Stats()
+    stop = threading.Event()
+    threads = []
+    for i in range(args.sensors):
+        threads.append(threading.Thread(target=sensor_worker, args=(args, stats, i, stop), daemon=True))
+    for i in range(args.viewers):
+        threads.append(threading.Thread(target=viewer_worker, args=(args, stats, i, stop), daemon=True))
+    for i in range(args.gallery):
+        threads.append(threading.Thread(target=gallery_worker, args=(args, stats, i, stop), daemon=True))
+
+    metrics_before = fetch_json(args, "/metrics")
+    memory_before = fetch_json(args, "/memory")
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+    try:
+        stop.wait(args.duration)
+    except KeyboardInterrupt:
+        pass
+    stop.set()
+    for t in threads:
+        t.join(args.timeout + 1.0)
+    elapsed = time.monotonic() - start
+    metrics_after = fetch_json(args, "/metrics")
+    memory_after = fetch_json(args, "/memory")
+
+    result = summarize(args, stats, elapsed, metrics_before, metrics_after, memory_before, memory_after)
+    text = json.dumps(result, indent=2)
+    if args.output == "-":
+        print(text)
+    else:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+        t = result["triggers"]
+        print("triggers %d accepted %d p50 %s ms p99 %s ms, fps %s, downloads %d (%.1f kB/s) -> %s" % (
+            t["sent"], t["accepted"], t["latency_ms"]["p50"], t["latency_ms"]["p99"],
+            result["stream"]["fps_total"], result["gallery"]["downloads"],
+            result["gallery"]["download_bytes_per_s"] / 1024.0, args.output), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
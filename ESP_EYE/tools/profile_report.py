@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Build every firmware profile and compare flash, RAM and boot time.
+
+Each profile (components/node_profile/Kconfig) is built in its own
+build-profile-<name>/ directory from a copy of the project sdkconfig with
+only the profile choice changed. Sizes come from the ELF sections:
+
+  app      size of the application .bin written to flash
+  text     .flash.text (code run from flash)
+  rodata   .flash.rodata
+  dram     .dram0.data + .dram0.bss (static internal RAM, before the heap)
+  iram     .iram0.text + .iram0.vectors
+
+With --port the profile is also flashed and the boot time is read from the
+"Profile <name> ready in N ms" line the node logs at the end of app_main.
+
+Usage: ./tools/profile_report.py [--port /dev/ttyUSB0] [--profiles full,stream_only]
+
+Needs an ESP-IDF environment (idf.py and the xtensa toolchain on PATH);
+--port also needs pyserial, which esptool already installs.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+PROFILES = {
+    "full": "CONFIG_NODE_PROFILE_FULL",
+    "stream_only": "CONFIG_NODE_PROFILE_STREAM_ONLY",
+    "capture_only": "CONFIG_NODE_PROFILE_CAPTURE_ONLY",
+}
+
+# Options whose default depends on the profile; a value pinned in the
+# project sdkconfig would hide the difference
+PROFILE_DEFAULTS = re.compile(r"^#? ?CONFIG_(NODE_|TASK_PLAN_HTTPD_STACK)")
+
+SECTIONS = {
+    "text": [".flash.text"],
+    "rodata": [".flash.rodata"],
+    "dram": [".dram0.data", ".dram0.bss"],
+    "iram": [".iram0.text", ".iram0.vectors"],
+}
+
+READY = re.compile(r"Profile (\S+) ready in (\d+) ms")
+
+
+def project_dir():
+    return os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def write_sdkconfig(build_dir, profile):
+    """Seed the profile's sdkconfig from the project one."""
+    os.makedirs(build_dir, exist_ok=True)
+    with open(os.path.join(project_dir(), "sdkconfig")) as f:
+        lines = [l for l in f if not PROFILE_DEFAULTS.match(l)]
+    lines.append(f"{PROFILES[profile]}=y\n")
+    path = os.path.join(build_dir, "sdkconfig")
+    with open(path, "w") as f:
+        f.writelines(lines)
+    return path
+
+
+def idf(build_dir, sdkconfig, *args):
+    cmd = ["idf.py", "-C", project_dir(), "-B", build_dir, "-D", f"SDKCONFIG={sdkconfig}", *args]
+    print("+", " ".join(cmd), file=sys.stderr)
+    subprocess.run(cmd, check=True, stdout=sys.stderr)
+
+
+def section_sizes(elf, size_tool):
+    out = subprocess.run([size_tool, "-A", elf], check=True, capture_output=True, text=True).stdout
+    raw = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".") and parts[1].isdigit():
+            raw[parts[0]] = int(parts[1])
+    return {k: sum(raw.get(s, 0) for s in names) for k, names in SECTIONS.items()}
+
+
+def app_image(build_dir):
+    with open(os.path.join(build_dir, "project_description.json")) as f:
+        desc = json.load(f)
+    return os.path.join(build_dir, desc["app_bin"]), os.path.join(build_dir, desc["app_elf"])
+
+
+def boot_ms(port, profile, timeout):
+    """Reset the board over DTR/RTS and wait for the ready line."""
+    import serial
+
+    with serial.Serial(port, 115200, timeout=0.5) as ser:
+        ser.dtr = False
+        ser.rts = True
+        time.sleep(0.1)
+        ser.rts = False
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            line = ser.readline().decode(errors="replace")
+            m = READY.search(line)
+            if m:
+                if m.group(1) != profile:
+                    print(f"warning: board reports profile {m.group(1)}", file=sys.stderr)
+                return int(m.group(2))
+    return None
+
+
+def fmt_delta(value, base):
+    if value is None:
+        return "-"
+    if base is None or value == base:
+        return str(value)
+    return f"{value} ({value - base:+d})"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--profiles", default=",".join(PROFILES), help="comma separated, first is the baseline")
+    ap.add_argument("--port", help="serial port; flash each profile and measure boot time")
+    ap.add_argument("--boot-timeout", type=float, default=30.0)
+    ap.add_argument("--size-tool", default="xtensa-esp32-elf-size")
+    ap.add_argument("--no-build", action="store_true", help="report existing build-profile-* directories")
+    args = ap.parse_args()
+
+    rows = []
+    for profile in args.profiles.split(","):
+        if profile not in PROFILES:
+            ap.error(f"unknown profile {profile}")
+        build_dir = os.path.join(project_dir(), f"build-profile-{profile}")
+        sdkconfig = os.path.join(build_dir, "sdkconfig")
+        if not args.no_build:
+            sdkconfig = write_sdkconfig(build_dir, profile)
+            idf(build_dir, sdkconfig, "build")
+        app_bin, app_elf = app_image(build_dir)
+        row = {"profile": profile, "app": os.path.getsize(app_bin)}
+        row.update(section_sizes(app_elf, args.size_tool))
+        row["boot_ms"] = None
+        if args.port:
+            idf(build_dir, sdkconfig, "-p", args.port, "flash")
+            row["boot_ms"] = boot_ms(args.port, profile, args.boot_timeout)
+        rows.append(row)
+
+    cols = ["app", "text", "rodata", "dram", "iram", "boot_ms"]
+    base = rows[0]
+    print("| profile | " + " | ".join(cols) + " |")
+    print("|" + "---|" * (len(cols) + 1))
+    for row in rows:
+        cells = [fmt_delta(row[c], base[c]) if row is not base else fmt_delta(row[c], None) for c in cols]
+        print(f"| {row['profile']} | " + " | ".join(cells) + " |")
+
+
+if __name__ == "__main__":
+    main()
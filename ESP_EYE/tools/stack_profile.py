@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+"""Turn task stack high-water marks from a profiling run into a stack header.
+
+Camera node (a CONFIG_TASK_PLAN_STACK_PROFILE build):
+
+  ./tools/stack_profile.py --host 192.168.4.1
+
+runs the standard workload, then reads GET /stacks and writes
+components/task_plan/task_plan_stacks.h. The workload is the loadgen.py
+mix (triggers, an MJPEG viewer, gallery clients at scale 1 and 4) followed
+by one request to every other endpoint in both JSON and CBOR. Use
+--no-workload to read /stacks only.
+
+PIR sensor (a CONFIG_PIR_STACK_PROFILE build, serial log saved to a file):
+
+  ./tools/stack_profile.py --log pir.log --sdkconfig "../IR sensor/sdkconfig"
+
+reads the "stack <name> size <n> free_min <n>" lines the sensor logs and
+writes "../IR sensor/main/task_stacks.h".
+
+A recommended size is the measured use plus --margin percent and --extra
+bytes, rounded up to --align and never below --min. Tasks whose size is an
+sdkconfig option (main, lwIP, event loop, timers, camera driver) are not
+written to the header; the script prints suggested sdkconfig lines for them
+instead.
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import http.client
+import json
+import math
+import os
+import re
+import sys
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import loadgen  # noqa: E402
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+ESP_EYE_HEADER = os.path.join(ROOT, "components", "task_plan", "task_plan_stacks.h")
+SENSOR_HEADER = os.path.join(ROOT, "..", "IR sensor", "main", "task_stacks.h")
+
+# ESP-IDF tasks whose stack is set in sdkconfig
+SDKCONFIG_STACKS = {
+    "main": "CONFIG_ESP_MAIN_TASK_STACK_SIZE",
+    "tiT": "CONFIG_LWIP_TCPIP_TASK_STACK_SIZE",
+    "sys_evt": "CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE",
+    "esp_timer": "CONFIG_ESP_TIMER_TASK_STACK_SIZE",
+    "ipc0": "CONFIG_ESP_IPC_TASK_STACK_SIZE",
+    "ipc1": "CONFIG_ESP_IPC_TASK_STACK_SIZE",
+    "cam_task": "CONFIG_CAMERA_TASK_STACK_SIZE",
+}
+
+# Requests after the mixed load: (method, path, body)
+SWEEP = [
+    ("GET", "/metrics", None),
+    ("GET", "/photos", None),
+    ("GET", "/photos/histogram", None),
+    ("GET", "/memory", None),
+    ("GET", "/settings", None),
+    ("PATCH", "/settings", "{}"),
+    ("GET", "/logs", None),
+    ("GET", "/trace", None),
+    ("GET", "/time", None),
+    ("POST", "/telemetry", '{"fps":10.0,"kbps":800,"age_ms":120,"age_ms_max":300,"frames":100,"dropped":1}'),
+    ("GET", "/", None),
+    ("GET", "/stacks", None),
+]
+
+LOG_LINE = re.compile(r"stack (\S+) size (\d+) free_min (\d+)")
+
+
+def run_workload(args):
+    """loadgen mix for --duration seconds, then one pass over every endpoint."""
+    try:
+        loadgen.sync_time(args)
+    except (OSError, SystemExit) as e:
+        print("time sync failed (%s); continuing" % e, file=sys.stderr)
+    stats = loadgen.Stats()
+    stop = threading.Event()
+    workers = [(loadgen.sensor_worker, args, 0), (loadgen.sensor_worker, args, 1),
+               (loadgen.viewer_worker, args, 0), (loadgen.gallery_worker, args, 0)]
+    scaled = argparse.Namespace(**vars(args))
+    scaled.scale = 4
+    workers.append((loadgen.gallery_worker, scaled, 1))
+    threads = [threading.Thread(target=fn, args=(a, stats, i, stop), daemon=True) for fn, a, i in workers]
+    for t in threads:
+        t.start()
+    stop.wait(args.duration)
+    stop.set()
+    for t in threads:
+        t.join(args.timeout + 1.0)
+    print("load: triggers %s, viewer frames %s, downloads %d" % (
+        stats.trigger_results, [v["frames"] for v in stats.viewers], len(stats.download_latency_ms)),
+        file=sys.stderr)
+
+    names = []
+    photos = loadgen.fetch_json(args, "/photos")
+    if photos:
+        names = [f["name"] for f in photos.get("files", [])]
+    sweep = list(SWEEP)
+    if names:
+        sweep += [("GET", "/photo/%s?scale=%d" % (names[0], s), None) for s in (2, 8)]
+    for method, path, body in sweep:
+        for accept in ("application/json", "application/cbor"):
+            headers = {"Accept": accept}
+            if body is not None:
+                headers["Content-Type"] = "application/json"
+            try:
+                status, _, _ = loadgen.request(args, method, path, body, headers)
+            except (OSError, http.client.HTTPException) as e:
+                status = str(e)
+            print("  %-6s %-40s %-16s %s" % (method, path, accept.split("/")[1], status), file=sys.stderr)
+
+
+def read_device(args):
+    status, data, _ = loadgen.request(args, "GET", "/stacks", None, {"Accept": "application/json"})
+    if status != 200:
+        raise SystemExit("GET /stacks: HTTP %d" % status)
+    doc = json.loads(data)
+    if doc.get("source") != "profiling":
+        print("warning: stack sizes are '%s', not a CONFIG_TASK_PLAN_STACK_PROFILE build; "
+              "only the plan's tasks are listed" % doc.get("source"), file=sys.stderr)
+    return doc["tasks"]
+
+
+def read_log(path):
+    tasks = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = LOG_LINE.search(line)
+            if not m:
+                continue
+            name, size, free = m.group(1), int(m.group(2)), int(m.group(3))
+            t = tasks.setdefault(name, {"name": name, "plan": None, "running": True, "stack": size, "free_min": free})
+            t["free_min"] = min(t["free_min"], free)
+    if not tasks:
+        raise SystemExit("no 'stack <name> size <n> free_min <n>' lines in %s" % path)
+    return list(tasks.values())
+
+
+def read_sdkconfig(path):
+    values = {}
+    if path and os.path.exists(path):
+        with open(path) as f:
+            for line in f:
+                key, sep, value = line.strip().partition("=")
+                if sep and value.isdigit():
+                    values[key] = int(value)
+    return values
+
+
+def recommend(args, used):
+    size = used * (1 + args.margin / 100.0) + args.extra
+    return max(args.min, int(math.ceil(size / args.align) * args.align))
+
+
+def macro(name):
+    return re.sub(r"[^A-Z0-9]", "_", name.upper())
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    p.add_argument("--host", default="192.168.4.1", help="camera node address")
+    p.add_argument("--port", type=int, default=80, help="HTTP port (8080 for the host build)")
+    p.add_argument("--stream-port", type=int, default=8081, help="MJPEG port")
+    p.add_argument("--duration", type=float, default=60.0, help="mixed load length in seconds")
+    p.add_argument("--no-workload", action="store_true", help="only read /stacks")
+    p.add_argument("--log", help="serial log of a PIR sensor profiling build instead of --host")
+    p.add_argument("--sdkconfig", default=os.path.join(ROOT, "sdkconfig"), help="for the sizes of ESP-IDF tasks")
+    p.add_argument("--margin", type=float, default=25.0, help="percent added to the measured use")
+    p.add_argument("--extra", type=int, default=512, help="bytes added on top (ISR and logging spikes)")
+    p.add_argument("--align", type=int, default=256)
+    p.add_argument("--min", type=int, default=2048, help="smallest stack recommended")
+    p.add_argument("--output", help="header to write (default depends on the source)")
+    p.add_argument("--timeout", type=float, default=10.0)
+    args = p.parse_args()
+    # loadgen worker settings
+    args.trigger_interval, args.jitter_ms, args.seed = 2.0, 500, 1
+    args.downloads_per_page, args.gallery_interval, args.scale = 4, 1.0, 1
+
+    if args.log:
+        tasks = read_log(args.log)
+        source = os.path.basename(args.log)
+    else:
+        if not args.no_workload:
+            run_workload(args)
+        tasks = read_device(args)
+        source = "%s:%d" % (args.host, args.port)
+    sdk = read_sdkconfig(args.sdkconfig)
+
+    print("%-16s %-12s %7s %7s %7s %7s" % ("task", "plan", "stack", "used", "free", "recommend"))
+    rows = []
+    suggestions = {}
+    for t in tasks:
+        stack = t["stack"] or sdk.get(SDKCONFIG_STACKS.get(t["name"], ""), 0)
+        if not t["running"] or not stack:
+            print("%-16s %-12s %7s %7s %7s %7s" % (t["name"], t["plan"] or "-", stack or "?", "-", "-",
+                                                   "not run" if not t["running"] else "?"))
+            rows.append((t, 0, 0))
+            continue
+        used = stack - t["free_min"]
+        rec = recommend(args, used)
+        print("%-16s %-12s %7d %7d %7d %7d" % (t["name"], t["plan"] or "-", stack, used, t["free_min"], rec))
+        rows.append((t, used, rec))
+        option = SDKCONFIG_STACKS.get(t["name"])
+        if option and not t["stack"]:
+            suggestions[option] = max(suggestions.get(option, 0), rec)
+
+    stamp = time.strftime("%Y-%m-%d %H:%M")
+    rule = "measured use + %g %% + %d bytes, rounded up to %d, at least %d" % (
+        args.margin, args.extra, args.align, args.min)
+    lines = ["/* Generated by tools/stack_profile.py from %s on %s; do not edit." % (source, stamp),
+             "   Recommended size = %s. */" % rule,
+             "#pragma once", ""]
+    if args.log:
+        # Sensor: own tasks only (those logged with their size); the rest keep main.c's defaults
+        output = args.output or SENSOR_HEADER
+        for t, used, rec in rows:
+            if t["stack"] and rec:
+                lines.append("#define PIR_STACK_%s %d   // used %d of %d" % (macro(t["name"]), rec, used, t["stack"]))
+    else:
+        # Camera node: every plan entry; 0 keeps the Kconfig size for tasks the run did not reach
+        output = args.output or ESP_EYE_HEADER
+        for t, used, rec in rows:
+            if t["plan"] is None:
+                continue
+            note = "used %d of %d" % (used, t["stack"]) if rec else "not exercised, keep the configured size"
+            lines.append("#define TASK_PLAN_MEASURED_%s %d   // %s" % (macro(t["plan"]), rec, note))
+    with open(output, "w") as f:
+        f.write("\n".join(lines) + "\n")
+    print("wrote %s" % os.path.relpath(output), file=sys.stderr)
+
+    if suggestions:
+        print("\nsdkconfig suggestions for ESP-IDF tasks:")
+        for option, rec in sorted(suggestions.items()):
+            print("%s=%d   # now %s" % (option, rec, sdk.get(option, "?")))
+
+
+if __name__ == "__main__":
+    main()
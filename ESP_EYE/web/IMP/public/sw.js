@@ -0,0 +1,65 @@
+// Service worker for the camera console. The app is a single inlined
+// index.html, so the shell is one file: it is served network-first (a new
+// build is picked up on the next visit) and from the cache when the device is
+// out of reach. Photos never change once written, so /photo/<id> is served
+// cache-first. Thumbnails (?scale=) are kept by the page in IndexedDB and,
+// like the /photos listing and the stream on port 8081, go to the network.
+
+const SHELL_CACHE = 'shell-v1'
+const PHOTO_CACHE = 'photos-v1'
+// Full-size photos kept; the oldest entries are dropped beyond this
+const PHOTO_CACHE_MAX = 200
+const SHELL = ['/', '/index.html']
+
+self.addEventListener('install', event => {
+  event.waitUntil(caches.open(SHELL_CACHE).then(cache => cache.addAll(SHELL)).then(() => self.skipWaiting()))
+})
+
+self.addEventListener('activate', event => {
+  event.waitUntil(
+    caches.keys()
+      .then(keys => Promise.all(keys.filter(k => k !== SHELL_CACHE && k !== PHOTO_CACHE).map(k => caches.delete(k))))
+      .then(() => self.clients.claim()),
+  )
+})
+
+async function trimPhotos(cache) {
+  const keys = await cache.keys()
+  for (let i = 0; i < keys.length - PHOTO_CACHE_MAX; i++) await cache.delete(keys[i])
+}
+
+async function photo(request) {
+  const cache = await caches.open(PHOTO_CACHE)
+  const hit = await cache.match(request)
+  if (hit) return hit
+  const res = await fetch(request)
+  if (res.ok) {
+    await cache.put(request, res.clone())
+    void trimPhotos(cache)
+  }
+  return res
+}
+
+async function shell(request) {
+  const cache = await caches.open(SHELL_CACHE)
+  try {
+    const res = await fetch(request)
+    if (res.ok && SHELL.includes(new URL(request.url).pathname)) await cache.put(request, res.clone())
+    return res
+  } catch (err) {
+    const hit = (await cache.match(request)) || (await cache.match('/index.html'))
+    if (hit) return hit
+    throw err
+  }
+}
+
+self.addEventListener('fetch', event => {
+  const req = event.request
+  const url = new URL(req.url)
+  if (req.method !== 'GET' || url.origin !== self.location.origin) return
+  if (url.pathname.startsWith('/photo/') && !url.search) {
+    event.respondWith(photo(req))
+  } else if (req.mode === 'navigate' || SHELL.includes(url.pathname)) {
+    event.respondWith(shell(req))
+  }
+})
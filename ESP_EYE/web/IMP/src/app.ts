@@ -1,4 +1,13 @@
 import './App.css'
+import { PhotoGallery, type PhotoPage } from './gallery.ts'
+import { Header, LivePanel, PhotosPanel, Tabs, type Tab } from './components.ts'
+import { PhotoStore } from './photo_store.ts'
+import { LiveViewer } from './live_viewer.ts'
+import { Timeline, type Histogram, type TimeRange } from './timeline.ts'
+import { CBOR_ACCEPT, readBody } from './cbor.ts'
+
+// Viewer figures are posted to /telemetry this often while the user opted in
+const TELEMETRY_INTERVAL_MS = 10000
 
 function fetchWithTimeout(input: RequestInfo | URL, init?: RequestInit, timeout = 8000) {
   const controller = new AbortController()
@@ -7,49 +16,75 @@ function fetchWithTimeout(input: RequestInfo | URL, init?: RequestInit, timeout
   return fetch(input, finalInit).finally(() => clearTimeout(id))
 }
 
-type MediaItem = { id: string; name: string }
-
 class App {
-  private photos: MediaItem[] = []
-  private currentTab: 'photos' | 'live' = 'live'
-  private loading = false
+  private gallery = new PhotoGallery((since, limit, after, range) => this.fetchPhotosPage(since, limit, after, range),
+                                     new PhotoStore(), () => this.update())
+  private timeline = new Timeline(() => this.fetchHistogram(), range => this.gallery.setRange(range))
+  private galleryStarted = false
+  private currentTab: Tab = 'live'
   private error: string | null = null
   private busy = false
   private statusMessage: string | null = null
   // device_time_ms - local Date.now()
   private clientTimeOffsetMs: number | null = null
 
+  private header = new Header()
+  private tabs = new Tabs(tab => this.selectTab(tab))
+  private live = new LivePanel(new LiveViewer(() => this.clientTimeOffsetMs),
+                               () => { if (!this.busy) void this.takeMedia() })
+  private photosPanel = new PhotosPanel(this.gallery, this.timeline, () => this.loadPhotos())
+
   constructor() {
     this.init()
   }
 
   private async init() {
-    document.getElementById('root')!.innerHTML = this.render()
-    this.attachEventListeners()
+    const page = document.createElement('div')
+    page.className = 'page'
+    page.append(this.header.element, this.tabs.element, this.live.element, this.photosPanel.element)
+    document.getElementById('root')!.replaceChildren(page)
+    this.showTab()
+    this.update()
     // Sync device time and learn device offset on page load so reloads work
     void this.syncTime()
+    window.setInterval(() => void this.postTelemetry(), TELEMETRY_INTERVAL_MS)
     try { await this.fetchDeviceTime() } catch (_) {}
   }
 
-  private attachEventListeners() {
-    document.getElementById('tab-live')?.addEventListener('click', () => {
-      if (this.currentTab === 'live') return
-      this.currentTab = 'live'
+  private async postTelemetry() {
+    // Taken even when not shared so each report covers one interval
+    const report = this.live.takeReport()
+    if (!report || !this.live.sharing) return
+    try {
+      await fetchWithTimeout('/telemetry', { method: 'POST', headers: { 'Content-Type': 'application/json' }, body: JSON.stringify(report) }, 5000)
+    } catch (_) {}
+  }
+
+  private selectTab(tab: Tab) {
+    if (this.currentTab === tab) return
+    this.currentTab = tab
+    this.showTab()
+    this.update()
+    if (tab === 'live') {
       // When switching to Live, ask the device to sync its clock
       void this.syncTime()
-      this.update()
-    })
-    document.getElementById('tab-photos')?.addEventListener('click', () => {
-      if (this.currentTab === 'photos') return
-      this.stopMjpeg()
-      this.currentTab = 'photos'
-      this.update()
-    })
-    document.getElementById('btn-take')?.addEventListener('click', () => { if (!this.busy) void this.takeMedia() })
-    document.getElementById('btn-refresh-photos')?.addEventListener('click', () => { void this.loadPhotos() })
+    } else if (!this.galleryStarted) {
+      this.loadPhotos()
+    }
   }
 
-
+  // The only place the live stream is started or torn down
+  private showTab() {
+    const live = this.currentTab === 'live'
+    this.live.element.hidden = !live
+    this.photosPanel.element.hidden = live
+    if (live) {
+      this.live.start(`http://${location.hostname}:8081/`)
+    } else {
+      this.live.stop()
+      this.photosPanel.shown()
+    }
+  }
 
   private async fetchPhotosList() {
     const res = await fetchWithTimeout('/photos', { method: 'GET', headers: { Accept: 'application/json' } }, 10000)
@@ -66,6 +101,31 @@ class App {
     return list.map((item: any, i: number) => (typeof item === 'string' ? item : String(item.name ?? item.id ?? i)))
   }
 
+  private async fetchPhotosPage(since: number, limit: number, after: string | null, range: TimeRange | null): Promise<PhotoPage> {
+    const cursor = after ? `&after=${encodeURIComponent(after)}` : ''
+    const within = range ? `&from=${range.from}&to=${range.to}` : ''
+    const res = await fetchWithTimeout(`/photos?since=${since}${cursor}${within}&limit=${limit}`, { method: 'GET', headers: { Accept: CBOR_ACCEPT } }, 10000)
+    if (!res.ok) throw new Error(`Failed (${res.status})`)
+    const data = await readBody(res)
+    const files = Array.isArray(data?.files) ? data.files : []
+    return {
+      ids: files.map((item: any) => String(item.name)),
+      next: typeof data?.next === 'number' ? data.next : null,
+      reset: data?.reset === true,
+    }
+  }
+
+  // The last 24 whole hours of the device clock, one bucket per hour
+  private async fetchHistogram(): Promise<Histogram> {
+    const nowS = Math.floor((Date.now() + (this.clientTimeOffsetMs ?? 0)) / 1000)
+    const from = Math.floor(nowS / 3600) * 3600 - 23 * 3600
+    const res = await fetchWithTimeout(`/photos/histogram?from=${from}&to=${from + 24 * 3600}&bucket=3600`, { method: 'GET', headers: { Accept: CBOR_ACCEPT } }, 5000)
+    if (!res.ok) throw new Error(`Failed (${res.status})`)
+    const data = await readBody(res)
+    if (!Array.isArray(data?.counts)) throw new Error('Invalid histogram')
+    return { from: Number(data.from), bucket: Number(data.bucket), counts: data.counts.map(Number) }
+  }
+
   private _photosCache: { ts: number; list: string[] } | null = null
 
   private async syncTime() {
@@ -105,30 +165,16 @@ class App {
     }
   }
 
-  private async loadPhotos() {
-    this.loading = true
+  private loadPhotos() {
     this.error = null
     this.statusMessage = null
-    this.update()
-
-    try {
-      const list = await this.fetchPhotosList()
-      // Map to MediaItem and create human-readable name: replace 'x'->' ' and '_'->':'
-      this.photos = list.map((fname: string) => {
-        const id = String(fname)
-        const base = id.replace(/\.jpg$/i, '')
-        const display = base.replace(/x/g, ' ').replace(/_/g, ':')
-        return { id, name: display }
-      })
-      // Deduplicate entries
-      this.photos = this.photos.filter((p, idx, arr) => arr.findIndex(x => x.id === p.id) === idx)
-    } catch (err) {
-      this.error = err instanceof Error ? err.message : 'Unknown error'
-      this.photos = []
-    } finally {
-      this.loading = false
-      this.update()
+    if (this.galleryStarted) {
+      this.gallery.sync()
+    } else {
+      this.galleryStarted = true
+      void this.gallery.restore()
     }
+    void this.timeline.refresh()
   }
 
   private async takeMedia() {
@@ -155,13 +201,13 @@ class App {
       this.update()
 
       // Send plaintext capture command containing the capture timestamp
-      const postBody = `capture:${deviceTime}`
+      const postBody = `capture:${deviceTime} source:ui`
 
       const contentType = postBody.startsWith('{') ? 'application/json' : 'text/plain'
       const res = await fetchWithTimeout(endpoint, { method: 'POST', headers: { 'Content-Type': contentType }, body: postBody }, 15000)
       const text = await res.text()
       let data: any = null
-      try { data = text ? JSON.parse(text) : null } catch (e) { data = null }
+      try { data = text ? JSON.parse(text) : null } catch (_) { data = null }
 
       if (!res.ok) {
         // server may return 403 with JSON reason
@@ -198,13 +244,13 @@ class App {
         if (found) {
           this.statusMessage = 'Capture completed'
           // Only refresh UI photos if user is viewing the Photos tab
-          if (this.currentTab === 'photos') await this.loadPhotos()
+          if (this.currentTab === 'photos') this.loadPhotos()
         } else {
           this.statusMessage = 'Capture accepted but file not found yet. Refresh to check.'
         }
       } else {
         // no path returned — just refresh
-        if (this.currentTab === 'photos') await this.loadPhotos()
+        if (this.currentTab === 'photos') this.loadPhotos()
       }
       this.busy = false
       this.update()
@@ -239,89 +285,17 @@ class App {
   }
 
   private update() {
-    const root = document.getElementById('root')
-    if (!root) return
-    const currentScroll = window.scrollY
-    root.innerHTML = this.render()
-    this.attachEventListeners()
-    window.scrollTo(0, currentScroll)
-    // Ensure MJPEG starts when showing Live tab
-    if (this.currentTab === 'live') {
-      const img = document.getElementById('mjpeg') as HTMLImageElement | null
-      if (img && !img.src) img.src = `http://${location.hostname}:8081/`
-    }
-  }
-
-  private stopMjpeg() {
-    const img = document.getElementById('mjpeg') as HTMLImageElement | null
-    if (!img) return
-    try {
-      img.src = ''
-      img.remove()
-    } catch (e) {}
-  }
-
-  private render() {
-    const items = this.photos
-
-    return `
-      <div class="page">
-        <header class="hero">
-          <p class="eyebrow">Camera console</p>
-          <div class="hero__row">
-            <div>
-              <h1>Secure System with motion detection</h1>
-              ${this.statusMessage ? `<p class="status">${this.statusMessage}</p>` : ''}
-            </div>
-          </div>
-        </header>
-
-        <nav class="tabs">
-          <button class="tab ${this.currentTab === 'live' ? 'active' : ''}" id="tab-live">Live</button>
-          <button class="tab ${this.currentTab === 'photos' ? 'active' : ''}" id="tab-photos">Photos</button>
-        </nav>
-
-        ${this.currentTab === 'live' ? `
-          <section class="layout">
-            <main class="panel">
-              <div class="panel__header"><h2>Live stream</h2>
-                <div class="hero__actions">
-                  <button class="primary" id="btn-take">Take photo</button>
-                </div>
-              </div>
-              <div class="player__body"><div class="player-grid"><div class="player-preview">
-                <img id="mjpeg" src="http://${location.hostname}:8081/" alt="Live stream" style="max-width:100%;height:auto;"/>
-              </div></div></div>
-            </main>
-          </section>
-        ` : `
-          <section class="layout">
-            <main class="panel">
-              <div class="panel__header">
-                <h2>Available photos</h2>
-                <span class="badge">${items.length}</span>
-                <div style="float:right">
-                  <button class="secondary" id="btn-refresh-photos">Refresh</button>
-                </div>
-              </div>
-              ${this.loading ? '<p class="muted">Loading…</p>' : ''}
-              ${this.error ? `<p class="error">${this.error}</p>` : ''}
-              ${!this.loading && !this.error && items.length === 0 ? '<p class="muted">No items found.</p>' : ''}
-              <ul class="photo-list">
-                ${items
-                  .map((item) => `
-                    <li>
-                      <a class="photo-link" href="/photo/${encodeURIComponent(item.id)}">${item.name}</a>
-                    </li>
-                  `)
-                  .join('')}
-              </ul>
-            </main>
-          </section>
-        `}
-      </div>
-    `
+    this.header.update(this.statusMessage)
+    this.tabs.update(this.currentTab)
+    this.photosPanel.update(this.error)
   }
 }
 
 new App()
+
+// Caches the app shell and viewed photos. Service workers need a secure context
+// (localhost or HTTPS); over plain HTTP on the device IP the IndexedDB copy in
+// PhotoStore still keeps the gallery usable offline.
+if ('serviceWorker' in navigator && window.isSecureContext) {
+  navigator.serviceWorker.register('/sw.js').catch(() => {})
+}
@@ -0,0 +1,131 @@
+// Minimal CBOR (RFC 8949) decoder for the device's list, histogram and metrics
+// responses: integers, text and byte strings, arrays and maps (definite or
+// indefinite length), booleans, null and floats. Tags are skipped.
+
+const BREAK = Symbol('break')
+
+function concat(parts: Uint8Array[]) {
+  const out = new Uint8Array(parts.reduce((n, p) => n + p.length, 0))
+  let off = 0
+  for (const p of parts) {
+    out.set(p, off)
+    off += p.length
+  }
+  return out
+}
+
+class Reader {
+  private view: DataView
+  private bytes: Uint8Array
+  private pos = 0
+  private text = new TextDecoder()
+
+  constructor(buf: ArrayBuffer) {
+    this.view = new DataView(buf)
+    this.bytes = new Uint8Array(buf)
+  }
+
+  get done() { return this.pos >= this.bytes.length }
+
+  private need(n: number) {
+    if (this.pos + n > this.bytes.length) throw new Error('Truncated CBOR')
+  }
+
+  private argument(info: number): number {
+    if (info < 24) return info
+    const sizes: Record<number, number> = { 24: 1, 25: 2, 26: 4, 27: 8 }
+    const n = sizes[info]
+    if (!n) throw new Error(`Unsupported CBOR argument ${info}`)
+    this.need(n)
+    const p = this.pos
+    this.pos += n
+    if (n === 1) return this.view.getUint8(p)
+    if (n === 2) return this.view.getUint16(p)
+    if (n === 4) return this.view.getUint32(p)
+    // Counters fit in 53 bits; larger values lose precision
+    return Number(this.view.getBigUint64(p))
+  }
+
+  private half(bits: number) {
+    const exp = (bits >> 10) & 0x1f
+    const frac = bits & 0x3ff
+    const sign = bits & 0x8000 ? -1 : 1
+    if (exp === 0) return sign * frac * 2 ** -24
+    if (exp === 31) return frac ? NaN : sign * Infinity
+    return sign * (1 + frac / 1024) * 2 ** (exp - 15)
+  }
+
+  item(): unknown {
+    this.need(1)
+    const initial = this.bytes[this.pos++]
+    const major = initial >> 5
+    const info = initial & 0x1f
+    if (initial === 0xff) return BREAK
+    switch (major) {
+      case 0: return this.argument(info)
+      case 1: return -1 - this.argument(info)
+      case 2:
+      case 3: {
+        if (info === 31) {
+          const chunks: unknown[] = []
+          for (let c = this.item(); c !== BREAK; c = this.item()) chunks.push(c)
+          return major === 3 ? chunks.join('') : concat(chunks as Uint8Array[])
+        }
+        const n = this.argument(info)
+        this.need(n)
+        const raw = this.bytes.subarray(this.pos, this.pos + n)
+        this.pos += n
+        return major === 3 ? this.text.decode(raw) : raw.slice()
+      }
+      case 4: {
+        const out: unknown[] = []
+        const n = info === 31 ? Infinity : this.argument(info)
+        for (let i = 0; i < n; i++) {
+          const v = this.item()
+          if (v === BREAK) break
+          out.push(v)
+        }
+        return out
+      }
+      case 5: {
+        const out: Record<string, unknown> = {}
+        const n = info === 31 ? Infinity : this.argument(info)
+        for (let i = 0; i < n; i++) {
+          const key = this.item()
+          if (key === BREAK) break
+          out[String(key)] = this.item()
+        }
+        return out
+      }
+      case 6:
+        this.argument(info)
+        return this.item()
+      default: {
+        if (info === 20) return false
+        if (info === 21) return true
+        if (info === 22 || info === 23) return null
+        if (info === 25) { this.need(2); const v = this.half(this.view.getUint16(this.pos)); this.pos += 2; return v }
+        if (info === 26) { this.need(4); const v = this.view.getFloat32(this.pos); this.pos += 4; return v }
+        if (info === 27) { this.need(8); const v = this.view.getFloat64(this.pos); this.pos += 8; return v }
+        throw new Error(`Unsupported CBOR simple value ${info}`)
+      }
+    }
+  }
+}
+
+export function decodeCbor(buf: ArrayBuffer): unknown {
+  const reader = new Reader(buf)
+  const value = reader.item()
+  if (value === BREAK || !reader.done) throw new Error('Malformed CBOR')
+  return value
+}
+
+// Accept header for endpoints that can answer in CBOR; JSON stays the fallback
+export const CBOR_ACCEPT = 'application/cbor, application/json;q=0.5'
+
+// Body of a response that may be CBOR or JSON, by its Content-Type
+export async function readBody(res: Response): Promise<any> {
+  const type = res.headers.get('Content-Type') ?? ''
+  if (type.includes('application/cbor')) return decodeCbor(await res.arrayBuffer())
+  return res.json()
+}
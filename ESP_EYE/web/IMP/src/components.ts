@@ -0,0 +1,154 @@
+// Page components. Each builds its DOM once and update() only touches the
+// nodes whose value changed, so a status message no longer rebuilds the page
+// (and with it the live stream, which costs the device a new TCP stream on
+// port 8081).
+
+import type { PhotoGallery } from './gallery.ts'
+import type { LiveViewer } from './live_viewer.ts'
+import type { Timeline } from './timeline.ts'
+
+export type Tab = 'photos' | 'live'
+
+const SHARE_KEY = 'esp-eye.share-stats'
+
+function el<K extends keyof HTMLElementTagNameMap>(tag: K, className?: string, text?: string) {
+  const node = document.createElement(tag)
+  if (className) node.className = className
+  if (text !== undefined) node.textContent = text
+  return node
+}
+
+// Text of an element that is hidden while the text is null
+function setMessage(node: HTMLElement, text: string | null) {
+  const hidden = text === null
+  if (node.hidden !== hidden) node.hidden = hidden
+  if (text !== null && node.textContent !== text) node.textContent = text
+}
+
+export class Header {
+  readonly element = el('header', 'hero')
+  private status = el('p', 'status')
+
+  constructor() {
+    const row = el('div', 'hero__row')
+    const title = el('div')
+    title.append(el('h1', undefined, 'Secure System with motion detection'), this.status)
+    row.append(title)
+    this.element.append(el('p', 'eyebrow', 'Camera console'), row)
+    this.status.hidden = true
+  }
+
+  update(statusMessage: string | null) {
+    setMessage(this.status, statusMessage)
+  }
+}
+
+export class Tabs {
+  readonly element = el('nav', 'tabs')
+  private buttons: Record<Tab, HTMLButtonElement>
+
+  constructor(onSelect: (tab: Tab) => void) {
+    this.buttons = {
+      live: el('button', 'tab', 'Live'),
+      photos: el('button', 'tab', 'Photos'),
+    }
+    for (const tab of ['live', 'photos'] as Tab[]) {
+      this.buttons[tab].id = `tab-${tab}`
+      this.buttons[tab].addEventListener('click', () => onSelect(tab))
+      this.element.append(this.buttons[tab])
+    }
+  }
+
+  update(current: Tab) {
+    for (const tab of ['live', 'photos'] as Tab[]) {
+      this.buttons[tab].classList.toggle('active', tab === current)
+    }
+  }
+}
+
+// Hosts the canvas viewer; the stream is opened in start() and only closed by stop()
+export class LivePanel {
+  readonly element = el('section', 'layout')
+  private viewer: LiveViewer
+  private share = el('input')
+
+  constructor(viewer: LiveViewer, onTake: () => void) {
+    this.viewer = viewer
+    const panel = el('main', 'panel')
+    const header = el('div', 'panel__header')
+    const actions = el('div', 'hero__actions')
+    const take = el('button', 'primary', 'Take photo')
+    take.id = 'btn-take'
+    take.addEventListener('click', onTake)
+    actions.append(take)
+    header.append(el('h2', undefined, 'Live stream'), actions)
+    const body = el('div', 'player__body')
+    const grid = el('div', 'player-grid')
+    const preview = el('div', 'player-preview')
+    preview.append(viewer.element)
+    grid.append(preview)
+    // Opt-in: viewer fps/latency figures are sent to the device's /metrics
+    const label = el('label', 'muted')
+    this.share.type = 'checkbox'
+    this.share.checked = localStorage.getItem(SHARE_KEY) === '1'
+    this.share.addEventListener('change', () => localStorage.setItem(SHARE_KEY, this.share.checked ? '1' : '0'))
+    label.append(this.share, ' Share stream stats with the device')
+    body.append(grid, label)
+    panel.append(header, body)
+    this.element.append(panel)
+  }
+
+  get sharing() { return this.share.checked }
+
+  takeReport() {
+    return this.viewer.takeReport()
+  }
+
+  start(src: string) {
+    this.viewer.start(src)
+  }
+
+  stop() {
+    this.viewer.stop()
+  }
+}
+
+export class PhotosPanel {
+  readonly element = el('section', 'layout layout--wide')
+  private badge = el('span', 'badge')
+  private loading = el('p', 'muted', 'Loading…')
+  private error = el('p', 'error')
+  private empty = el('p', 'muted', 'No items found.')
+  private galleryHost = el('div')
+  private gallery: PhotoGallery
+
+  constructor(gallery: PhotoGallery, timeline: Timeline, onRefresh: () => void) {
+    this.gallery = gallery
+    const panel = el('main', 'panel')
+    const header = el('div', 'panel__header')
+    const right = el('div')
+    right.style.float = 'right'
+    const refresh = el('button', 'secondary', 'Refresh')
+    refresh.id = 'btn-refresh-photos'
+    refresh.addEventListener('click', onRefresh)
+    right.append(refresh)
+    header.append(el('h2', undefined, 'Available photos'), this.badge, right)
+    panel.append(header, timeline.element, this.loading, this.error, this.empty, this.galleryHost)
+    this.element.append(panel)
+    gallery.mount(this.galleryHost)
+  }
+
+  update(error: string | null) {
+    const g = this.gallery
+    const err = error ?? g.lastError
+    setMessage(this.badge, `${g.count}${g.complete ? '' : '+'}`)
+    setMessage(this.loading, g.loading && g.count === 0 ? 'Loading…' : null)
+    setMessage(this.error, err)
+    setMessage(this.empty, !g.loading && !err && g.complete && g.count === 0 ? 'No items found.' : null)
+  }
+
+  // The grid measures itself, so it re-lays out once its section is visible
+  shown() {
+    this.gallery.mount(this.galleryHost)
+  }
+}
@@ -0,0 +1,316 @@
+// Virtualised photo grid: only the rows in (or near) the viewport exist in the
+// DOM, the list is synced from /photos?since=&after=&limit= as the user scrolls,
+// and thumbnails (/photo/<id>?scale=8) load lazily through a small request pool
+// so browsing never ties up the device's few HTTP sockets. The timeline can
+// narrow the listing to a time range (from=&to=). The full list and the
+// thumbnails are kept in a PhotoStore, so a revisit only fetches new photos
+// and the grid still works when the device is out of reach.
+
+import type { PhotoStore } from './photo_store.ts'
+import type { TimeRange } from './timeline.ts'
+
+export type MediaItem = { id: string; name: string }
+
+const PAGE_SIZE = 60
+const TILE_WIDTH = 168
+const ROW_HEIGHT = 150
+// Rows kept rendered above and below the viewport
+const OVERSCAN_ROWS = 2
+// Start fetching the next page this many rows before the loaded end
+const PREFETCH_ROWS = 3
+// Concurrent thumbnail requests; the device serves a handful of sockets in total
+const THUMB_CONCURRENCY = 2
+// Decoded thumbnails kept as object URLs; older ones are revoked
+const THUMB_CACHE_MAX = 300
+const THUMB_SCALE = 8
+
+export function displayName(id: string) {
+  // Filenames encode the capture time: 'x' -> ' ' and '_' -> ':'
+  return id.replace(/\.jpg$/i, '').replace(/x/g, ' ').replace(/_/g, ':')
+}
+
+// Runs at most `limit` tasks at once; queued tasks can be withdrawn before they start
+class RequestPool {
+  private active = 0
+  private queue: { key: string; run: () => Promise<void> }[] = []
+  private limit: number
+
+  constructor(limit: number) {
+    this.limit = limit
+  }
+
+  push(key: string, run: () => Promise<void>) {
+    this.queue.push({ key, run })
+    this.pump()
+  }
+
+  // True if the task was still queued
+  cancel(key: string) {
+    const before = this.queue.length
+    this.queue = this.queue.filter(t => t.key !== key)
+    return this.queue.length !== before
+  }
+
+  clear() {
+    this.queue = []
+  }
+
+  private pump() {
+    while (this.active < this.limit && this.queue.length > 0) {
+      const task = this.queue.shift()!
+      this.active++
+      task.run().finally(() => {
+        this.active--
+        this.pump()
+      })
+    }
+  }
+}
+
+// One page of the listing; `reset` means the cursor was stale and the page starts at 0
+export type PhotoPage = { ids: string[]; next: number | null; reset: boolean }
+export type PageFetcher = (since: number, limit: number, after: string | null, range: TimeRange | null) => Promise<PhotoPage>
+
+export class PhotoGallery {
+  readonly element: HTMLDivElement
+  private spacer: HTMLDivElement
+  private items: MediaItem[] = []
+  private synced = false
+  private pageLoading = false
+  private error: string | null = null
+  private tiles = new Map<string, HTMLElement>()
+  private thumbs = new Map<string, string>()
+  private pending = new Set<string>()
+  private failed = new Set<string>()
+  private pool = new RequestPool(THUMB_CONCURRENCY)
+  private observer: IntersectionObserver
+  private frame = 0
+  // Only photos taken in this range are listed; the saved list is left alone meanwhile
+  private range: TimeRange | null = null
+  private fetchPage: PageFetcher
+  private store: PhotoStore
+  private onChange: () => void
+
+  constructor(fetchPage: PageFetcher, store: PhotoStore, onChange: () => void) {
+    this.fetchPage = fetchPage
+    this.store = store
+    this.onChange = onChange
+    this.element = document.createElement('div')
+    this.element.className = 'gallery'
+    this.spacer = document.createElement('div')
+    this.spacer.className = 'gallery__spacer'
+    this.element.appendChild(this.spacer)
+    this.observer = new IntersectionObserver(entries => this.onIntersect(entries), { rootMargin: '200px 0px' })
+    window.addEventListener('scroll', () => this.schedule(), { passive: true })
+    window.addEventListener('resize', () => this.schedule())
+  }
+
+  get count() { return this.items.length }
+  get loading() { return this.pageLoading }
+  get lastError() { return this.error }
+  get complete() { return this.synced }
+
+  // Put the grid into `host` and lay it out again (call after the host becomes visible)
+  mount(host: HTMLElement | null) {
+    if (!host) return
+    host.appendChild(this.element)
+    this.schedule()
+  }
+
+  // Show the list saved by an earlier visit, then fetch what was added since
+  async restore() {
+    const ids = await this.store.loadList()
+    if (this.items.length === 0 && ids.length > 0) {
+      this.items = ids.map(id => ({ id, name: displayName(id) }))
+      this.onChange()
+      this.schedule()
+    }
+    this.sync()
+  }
+
+  // Narrow the grid to a time range (null for all photos) and list it from the start
+  setRange(range: TimeRange | null) {
+    this.range = range
+    this.clear()
+    this.onChange()
+    this.schedule()
+    if (range) this.sync()
+    else void this.restore()
+  }
+
+  // Fetch photos added since the last sync; thumbnails that failed get another try
+  sync() {
+    this.synced = false
+    this.error = null
+    this.failed.clear()
+    for (const tile of this.tiles.values()) tile.classList.remove('gallery__tile--nothumb')
+    void this.loadMore()
+  }
+
+  private clear() {
+    for (const tile of this.tiles.values()) this.observer.unobserve(tile)
+    this.tiles.clear()
+    this.pool.clear()
+    this.pending.clear()
+    this.spacer.replaceChildren()
+    this.items = []
+  }
+
+  private schedule() {
+    if (this.frame) return
+    this.frame = requestAnimationFrame(() => {
+      this.frame = 0
+      this.renderWindow()
+    })
+  }
+
+  private columns() {
+    return Math.max(1, Math.floor(this.element.clientWidth / TILE_WIDTH))
+  }
+
+  private async loadMore() {
+    if (this.pageLoading || this.synced) return
+    this.pageLoading = true
+    this.onChange()
+    try {
+      // The cursor is the number of photos known and the name of the last one
+      const last = this.items.length ? this.items[this.items.length - 1].id : null
+      const range = this.range
+      const page = await this.fetchPage(this.items.length, PAGE_SIZE, last, range)
+      // The range changed while this page was on its way
+      if (range !== this.range) return
+      if (page.reset) this.clear()
+      const known = new Set(this.items.map(item => item.id))
+      for (const id of page.ids) {
+        if (!known.has(id)) this.items.push({ id, name: displayName(id) })
+      }
+      this.synced = page.next === null
+      this.error = null
+      if (!range && (page.reset || page.ids.length > 0)) void this.store.saveList(this.items.map(item => item.id))
+    } catch (err) {
+      const reason = err instanceof Error ? err.message : 'Unknown error'
+      this.error = this.items.length ? `Device unreachable (${reason}); showing saved photos` : reason
+    } finally {
+      this.pageLoading = false
+      this.onChange()
+      this.schedule()
+    }
+  }
+
+  private renderWindow() {
+    // Detached or in a hidden tab: nothing to measure, and no paging in the background
+    if (!this.element.isConnected || this.element.offsetParent === null) return
+    const cols = this.columns()
+    const rows = Math.ceil(this.items.length / cols)
+    this.spacer.style.height = `${rows * ROW_HEIGHT}px`
+
+    const top = this.element.getBoundingClientRect().top
+    const firstRow = Math.max(0, Math.floor(-top / ROW_HEIGHT) - OVERSCAN_ROWS)
+    const lastRow = Math.min(rows, Math.ceil((window.innerHeight - top) / ROW_HEIGHT) + OVERSCAN_ROWS)
+    const first = firstRow * cols
+    const last = Math.min(this.items.length, lastRow * cols)
+
+    // Keyed reuse: tiles still in range stay, others are dropped
+    const wanted = new Set<string>()
+    for (let i = first; i < last; i++) wanted.add(this.items[i].id)
+    for (const [id, tile] of this.tiles) {
+      if (wanted.has(id)) continue
+      this.observer.unobserve(tile)
+      if (this.pool.cancel(id)) this.pending.delete(id)
+      tile.remove()
+      this.tiles.delete(id)
+    }
+    for (let i = first; i < last; i++) {
+      const item = this.items[i]
+      let tile = this.tiles.get(item.id)
+      if (!tile) {
+        tile = this.createTile(item)
+        this.tiles.set(item.id, tile)
+        this.spacer.appendChild(tile)
+        this.observer.observe(tile)
+      }
+      tile.style.transform = `translate(${(i % cols) * TILE_WIDTH}px, ${Math.floor(i / cols) * ROW_HEIGHT}px)`
+    }
+
+    if (lastRow + PREFETCH_ROWS >= rows && !this.error) void this.loadMore()
+  }
+
+  private createTile(item: MediaItem) {
+    const tile = document.createElement('a')
+    tile.className = 'gallery__tile'
+    tile.href = `/photo/${encodeURIComponent(item.id)}`
+    tile.dataset.id = item.id
+    const img = document.createElement('img')
+    img.alt = item.name
+    img.decoding = 'async'
+    const cached = this.thumbs.get(item.id)
+    if (cached) img.src = cached
+    const caption = document.createElement('span')
+    caption.className = 'gallery__caption'
+    caption.textContent = item.name
+    tile.append(img, caption)
+    if (this.failed.has(item.id)) tile.classList.add('gallery__tile--nothumb')
+    return tile
+  }
+
+  private onIntersect(entries: IntersectionObserverEntry[]) {
+    for (const entry of entries) {
+      const id = (entry.target as HTMLElement).dataset.id
+      if (!id) continue
+      if (!entry.isIntersecting) {
+        // Scrolled past before its turn came: do not spend a request on it
+        if (this.pool.cancel(id)) this.pending.delete(id)
+        continue
+      }
+      if (this.thumbs.has(id) || this.pending.has(id) || this.failed.has(id)) continue
+      this.pending.add(id)
+      void this.loadThumb(id)
+    }
+  }
+
+  // Saved thumbnails show at once; only missing ones queue for the device
+  private async loadThumb(id: string) {
+    const blob = await this.store.getThumb(id)
+    if (blob) {
+      this.showThumb(id, blob)
+      this.pending.delete(id)
+    } else if (this.pending.has(id)) {
+      this.pool.push(id, () => this.fetchThumb(id))
+    }
+  }
+
+  private async fetchThumb(id: string) {
+    try {
+      const res = await fetch(`/photo/${encodeURIComponent(id)}?scale=${THUMB_SCALE}`)
+      if (!res.ok) throw new Error(`Failed (${res.status})`)
+      const blob = await res.blob()
+      void this.store.putThumb(id, blob)
+      this.showThumb(id, blob)
+    } catch (_) {
+      // No thumbnail (e.g. no encoder on the host build): keep the text tile
+      this.failed.add(id)
+      this.tiles.get(id)?.classList.add('gallery__tile--nothumb')
+    } finally {
+      this.pending.delete(id)
+    }
+  }
+
+  private showThumb(id: string, blob: Blob) {
+    const url = URL.createObjectURL(blob)
+    this.remember(id, url)
+    const img = this.tiles.get(id)?.querySelector('img')
+    if (img) img.src = url
+  }
+
+  private remember(id: string, url: string) {
+    this.thumbs.set(id, url)
+    if (this.thumbs.size <= THUMB_CACHE_MAX) return
+    // Map keeps insertion order: evict the oldest thumbnail not on screen
+    for (const [old, oldUrl] of this.thumbs) {
+      if (this.tiles.has(old)) continue
+      URL.revokeObjectURL(oldUrl)
+      this.thumbs.delete(old)
+      break
+    }
+  }
+}
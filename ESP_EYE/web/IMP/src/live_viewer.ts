@@ -0,0 +1,273 @@
+// Live view drawn on a canvas from the MJPEG stream on port 8081. The stream is
+// read with fetch() so the page sees every part: frames are decoded with
+// createImageBitmap, fps, bitrate and frame age are measured here, and pausing
+// simply stops reading. TCP back-pressure then holds the device's streamer
+// until the viewer resumes, without tearing the connection down.
+
+// One telemetry interval, the body of POST /telemetry
+export type ViewerReport = {
+  fps: number
+  kbps: number
+  age_ms: number
+  age_ms_max: number
+  frames: number
+  dropped: number
+}
+
+// Figures shown on the overlay are recomputed this often
+const STATS_WINDOW_MS = 1000
+// Wait before reconnecting after the stream ends or fails
+const RECONNECT_MS = 2000
+// A part header longer than this means the stream is not what we expect
+const PART_HEADER_MAX = 512
+
+const decoder = new TextDecoder('ascii')
+
+// Counters over one interval; frame age needs the device clock offset and may be missing
+class Tally {
+  started = performance.now()
+  frames = 0
+  bytes = 0
+  dropped = 0
+  private ageSum = 0
+  private ageCount = 0
+  private ageMax = 0
+
+  addFrame(bytes: number, ageMs: number | null) {
+    this.frames++
+    this.bytes += bytes
+    if (ageMs === null) return
+    this.ageSum += ageMs
+    this.ageCount++
+    this.ageMax = Math.max(this.ageMax, ageMs)
+  }
+
+  report(now: number): ViewerReport {
+    const secs = Math.max((now - this.started) / 1000, 0.001)
+    return {
+      fps: Math.round((this.frames / secs) * 10) / 10,
+      kbps: Math.round((this.bytes * 8) / secs / 1000),
+      age_ms: this.ageCount ? Math.round(this.ageSum / this.ageCount) : 0,
+      age_ms_max: Math.round(this.ageMax),
+      frames: this.frames,
+      dropped: this.dropped,
+    }
+  }
+}
+
+// Splits a multipart/x-mixed-replace body into JPEG parts as bytes arrive
+class PartParser {
+  private buf = new Uint8Array(64 * 1024)
+  private start = 0
+  private end = 0
+  // Body length of the part whose header was read, -1 while reading a header
+  private need = -1
+  private stamp: number | null = null
+
+  push(chunk: Uint8Array, onPart: (jpeg: Uint8Array<ArrayBuffer>, stamp: number | null) => void) {
+    this.append(chunk)
+    for (;;) {
+      if (this.need < 0) {
+        const headEnd = this.findHeaderEnd()
+        if (headEnd < 0) {
+          if (this.end - this.start > PART_HEADER_MAX) throw new Error('Malformed stream')
+          return
+        }
+        const head = decoder.decode(this.buf.subarray(this.start, headEnd))
+        this.start = headEnd + 4
+        const length = /content-length:\s*(\d+)/i.exec(head)
+        if (!length) throw new Error('Stream part without Content-Length')
+        this.need = Number(length[1])
+        const stamp = /x-timestamp:\s*(\d+)/i.exec(head)
+        this.stamp = stamp ? Number(stamp[1]) : null
+      }
+      if (this.end - this.start < this.need) return
+      onPart(this.buf.slice(this.start, this.start + this.need), this.stamp)
+      this.start += this.need
+      this.need = -1
+    }
+  }
+
+  private append(chunk: Uint8Array) {
+    if (this.end + chunk.length > this.buf.length) {
+      const used = this.end - this.start
+      if (used + chunk.length > this.buf.length) {
+        let size = this.buf.length * 2
+        while (size < used + chunk.length) size *= 2
+        const grown = new Uint8Array(size)
+        grown.set(this.buf.subarray(this.start, this.end))
+        this.buf = grown
+      } else {
+        this.buf.copyWithin(0, this.start, this.end)
+      }
+      this.start = 0
+      this.end = used
+    }
+    this.buf.set(chunk, this.end)
+    this.end += chunk.length
+  }
+
+  // Index of the blank line ending the part header, or -1
+  private findHeaderEnd() {
+    const b = this.buf
+    for (let i = this.start; i + 3 < this.end; i++) {
+      if (b[i] === 13 && b[i + 1] === 10 && b[i + 2] === 13 && b[i + 3] === 10) return i
+    }
+    return -1
+  }
+}
+
+export class LiveViewer {
+  readonly element: HTMLDivElement
+  private canvas: HTMLCanvasElement
+  private ctx: CanvasRenderingContext2D
+  private overlay: HTMLSpanElement
+  private pauseButton: HTMLButtonElement
+  private url: string | null = null
+  // Bumped by every connect and by stop(); a read loop from an older session exits
+  private session = 0
+  private abort: AbortController | null = null
+  private reconnectTimer = 0
+  private paused = false
+  private resume: (() => void) | null = null
+  // Newest undecoded frame; it replaces an older one still waiting
+  private next: { jpeg: Uint8Array<ArrayBuffer>; stamp: number | null } | null = null
+  private decoding = false
+  private shown = new Tally()
+  private interval = new Tally()
+  private clockOffset: () => number | null
+
+  // clockOffset: device time minus Date.now(), null until known
+  constructor(clockOffset: () => number | null) {
+    this.clockOffset = clockOffset
+    this.element = document.createElement('div')
+    this.element.className = 'viewer'
+    this.canvas = document.createElement('canvas')
+    this.canvas.id = 'mjpeg'
+    this.canvas.className = 'viewer__canvas'
+    this.ctx = this.canvas.getContext('2d')!
+    const bar = document.createElement('div')
+    bar.className = 'viewer__bar'
+    this.overlay = document.createElement('span')
+    this.overlay.className = 'viewer__stats'
+    this.pauseButton = document.createElement('button')
+    this.pauseButton.className = 'secondary'
+    this.pauseButton.textContent = 'Pause'
+    this.pauseButton.addEventListener('click', () => this.setPaused(!this.paused))
+    bar.append(this.overlay, this.pauseButton)
+    this.element.append(this.canvas, bar)
+  }
+
+  start(url: string) {
+    if (this.url) return
+    this.url = url
+    this.setPaused(false)
+    void this.connect()
+  }
+
+  stop() {
+    if (!this.url) return
+    this.url = null
+    this.session++
+    clearTimeout(this.reconnectTimer)
+    this.abort?.abort()
+    this.abort = null
+    this.next = null
+    this.resume?.()
+    this.overlay.textContent = ''
+  }
+
+  // Figures since the previous call, for POST /telemetry; null if nothing was drawn
+  takeReport(): ViewerReport | null {
+    const report = this.interval.report(performance.now())
+    this.interval = new Tally()
+    return report.frames > 0 ? report : null
+  }
+
+  private setPaused(paused: boolean) {
+    this.paused = paused
+    this.pauseButton.textContent = paused ? 'Resume' : 'Pause'
+    if (paused) {
+      this.overlay.textContent = 'Paused'
+    } else {
+      this.resume?.()
+      this.shown = new Tally()
+    }
+  }
+
+  private async connect() {
+    const url = this.url
+    if (!url) return
+    const session = ++this.session
+    const abort = new AbortController()
+    this.abort = abort
+    const parser = new PartParser()
+    try {
+      const res = await fetch(url, { signal: abort.signal, cache: 'no-store' })
+      if (!res.ok || !res.body) throw new Error(`Stream failed (${res.status})`)
+      const reader = res.body.getReader()
+      for (;;) {
+        // Paused: stop reading and let the device wait on a full TCP window
+        while (this.paused && this.session === session) {
+          await new Promise<void>(resolve => { this.resume = resolve })
+          this.resume = null
+        }
+        if (this.session !== session) break
+        const { value, done } = await reader.read()
+        if (done) break
+        parser.push(value, (jpeg, stamp) => this.queue(jpeg, stamp))
+      }
+      await reader.cancel().catch(() => {})
+    } catch (err) {
+      if (abort.signal.aborted) return
+      this.overlay.textContent = err instanceof Error ? err.message : 'Stream failed'
+    }
+    if (this.abort === abort) this.abort = null
+    // Ended or failed while still wanted (a paused viewer reconnects on resume)
+    if (this.session === session) this.reconnectTimer = window.setTimeout(() => void this.connect(), RECONNECT_MS)
+  }
+
+  private queue(jpeg: Uint8Array<ArrayBuffer>, stamp: number | null) {
+    if (this.next) {
+      this.shown.dropped++
+      this.interval.dropped++
+    }
+    this.next = { jpeg, stamp }
+    if (!this.decoding) void this.drain()
+  }
+
+  // Decode frames one at a time; while one decodes only the newest waits
+  private async drain() {
+    this.decoding = true
+    while (this.next) {
+      const { jpeg, stamp } = this.next
+      this.next = null
+      try {
+        const bitmap = await createImageBitmap(new Blob([jpeg], { type: 'image/jpeg' }))
+        if (this.canvas.width !== bitmap.width) this.canvas.width = bitmap.width
+        if (this.canvas.height !== bitmap.height) this.canvas.height = bitmap.height
+        this.ctx.drawImage(bitmap, 0, 0)
+        bitmap.close()
+      } catch (_) {
+        // A corrupt frame is skipped; the next one replaces it
+        continue
+      }
+      const offset = this.clockOffset()
+      const age = stamp !== null && offset !== null ? Math.max(0, Date.now() + offset - stamp) : null
+      this.shown.addFrame(jpeg.length, age)
+      this.interval.addFrame(jpeg.length, age)
+      this.showStats()
+    }
+    this.decoding = false
+  }
+
+  private showStats() {
+    const now = performance.now()
+    if (this.paused || now - this.shown.started < STATS_WINDOW_MS) return
+    const r = this.shown.report(now)
+    const age = this.clockOffset() === null ? 'age n/a' : `${r.age_ms} ms old`
+    this.overlay.textContent = `${r.fps.toFixed(1)} fps · ${r.kbps} kbps · ${age}` +
+      (r.dropped ? ` · ${r.dropped} skipped` : '')
+    this.shown = new Tally()
+  }
+}
@@ -0,0 +1,100 @@
+// IndexedDB copy of the photo list and of downloaded thumbnails. Unlike Cache
+// Storage and service workers it also works when the UI is opened over plain
+// HTTP on the device's IP, which is not a secure context.
+
+const DB_NAME = 'esp-eye'
+const DB_VERSION = 1
+const META = 'meta'
+const THUMBS = 'thumbs'
+// Thumbnails kept; the oldest are dropped beyond this
+const THUMB_STORE_MAX = 2000
+// Check the thumbnail count every this many writes
+const THUMB_TRIM_EVERY = 50
+
+type ThumbRecord = { id: string; blob: Blob; ts: number }
+
+function request<T>(req: IDBRequest<T>) {
+  return new Promise<T>((resolve, reject) => {
+    req.onsuccess = () => resolve(req.result)
+    req.onerror = () => reject(req.error)
+  })
+}
+
+export class PhotoStore {
+  private db: Promise<IDBDatabase | null>
+  private writes = 0
+
+  constructor() {
+    this.db = new Promise<IDBDatabase | null>(resolve => {
+      if (!('indexedDB' in window)) return resolve(null)
+      const open = indexedDB.open(DB_NAME, DB_VERSION)
+      open.onupgradeneeded = () => {
+        const db = open.result
+        db.createObjectStore(META)
+        db.createObjectStore(THUMBS, { keyPath: 'id' }).createIndex('ts', 'ts')
+      }
+      open.onsuccess = () => resolve(open.result)
+      // Private mode or storage disabled: run without a local copy
+      open.onerror = () => resolve(null)
+    })
+  }
+
+  private async store(name: string, mode: IDBTransactionMode) {
+    const db = await this.db
+    return db ? db.transaction(name, mode).objectStore(name) : null
+  }
+
+  // Photo ids in directory order as of the last sync
+  async loadList(): Promise<string[]> {
+    try {
+      const store = await this.store(META, 'readonly')
+      const ids = store ? await request(store.get('photos')) : null
+      return Array.isArray(ids) ? ids : []
+    } catch (_) {
+      return []
+    }
+  }
+
+  async saveList(ids: string[]) {
+    try {
+      const store = await this.store(META, 'readwrite')
+      if (store) await request(store.put(ids, 'photos'))
+    } catch (_) {}
+  }
+
+  async getThumb(id: string): Promise<Blob | null> {
+    try {
+      const store = await this.store(THUMBS, 'readonly')
+      const rec = store ? await request(store.get(id) as IDBRequest<ThumbRecord | undefined>) : undefined
+      return rec?.blob ?? null
+    } catch (_) {
+      return null
+    }
+  }
+
+  async putThumb(id: string, blob: Blob) {
+    try {
+      const store = await this.store(THUMBS, 'readwrite')
+      if (!store) return
+      await request(store.put({ id, blob, ts: Date.now() } satisfies ThumbRecord))
+      if (++this.writes % THUMB_TRIM_EVERY === 0) await this.trimThumbs()
+    } catch (_) {}
+  }
+
+  private async trimThumbs() {
+    const store = await this.store(THUMBS, 'readwrite')
+    if (!store) return
+    let excess = (await request(store.count())) - THUMB_STORE_MAX
+    if (excess <= 0) return
+    await new Promise<void>(resolve => {
+      const cursor = store.index('ts').openCursor()
+      cursor.onsuccess = () => {
+        const c = cursor.result
+        if (!c || excess-- <= 0) return resolve()
+        c.delete()
+        c.continue()
+      }
+      cursor.onerror = () => resolve()
+    })
+  }
+}
@@ -0,0 +1,94 @@
+// Capture activity over the last 24 h as one bar per hour. The counts come from
+// /photos/histogram, which the device keeps up to date as it records, so the
+// chart costs one small request instead of the whole file list. Clicking a bar
+// narrows the gallery to that hour.
+
+// Counts per bucket; times are epoch seconds
+export type Histogram = { from: number; bucket: number; counts: number[] }
+export type TimeRange = { from: number; to: number }
+export type HistogramFetcher = () => Promise<Histogram>
+
+function hour(epochS: number) {
+  return new Date(epochS * 1000).toLocaleTimeString([], { hour: '2-digit', minute: '2-digit' })
+}
+
+export class Timeline {
+  readonly element: HTMLDivElement
+  private bars: HTMLDivElement
+  private label: HTMLSpanElement
+  private clearButton: HTMLButtonElement
+  private data: Histogram | null = null
+  // Start of the selected bucket, null when showing everything
+  private selected: number | null = null
+  private fetchHistogram: HistogramFetcher
+  private onSelect: (range: TimeRange | null) => void
+
+  constructor(fetchHistogram: HistogramFetcher, onSelect: (range: TimeRange | null) => void) {
+    this.fetchHistogram = fetchHistogram
+    this.onSelect = onSelect
+    this.element = document.createElement('div')
+    this.element.className = 'timeline'
+    this.element.hidden = true
+    this.bars = document.createElement('div')
+    this.bars.className = 'timeline__bars'
+    const footer = document.createElement('div')
+    footer.className = 'timeline__footer'
+    this.label = document.createElement('span')
+    this.label.className = 'muted'
+    this.clearButton = document.createElement('button')
+    this.clearButton.className = 'secondary'
+    this.clearButton.textContent = 'Show all'
+    this.clearButton.hidden = true
+    this.clearButton.addEventListener('click', () => this.select(null))
+    footer.append(this.label, this.clearButton)
+    this.element.append(this.bars, footer)
+  }
+
+  async refresh() {
+    try {
+      this.data = await this.fetchHistogram()
+      this.render()
+    } catch (_) {
+      // Older firmware or device away: the gallery works without the chart
+      this.element.hidden = this.data === null
+    }
+  }
+
+  private render() {
+    const data = this.data
+    if (!data) return
+    const max = Math.max(1, ...data.counts)
+    const total = data.counts.reduce((a, b) => a + b, 0)
+    this.bars.replaceChildren(...data.counts.map((count, i) => {
+      const start = data.from + i * data.bucket
+      const bar = document.createElement('button')
+      bar.className = 'timeline__bar'
+      bar.classList.toggle('active', start === this.selected)
+      bar.style.height = `${Math.max(4, (count / max) * 100)}%`
+      bar.title = `${hour(start)}–${hour(start + data.bucket)}: ${count} photo${count === 1 ? '' : 's'}`
+      bar.disabled = count === 0 && start !== this.selected
+      bar.addEventListener('click', () => this.select(start === this.selected ? null : start))
+      return bar
+    }))
+    this.updateLabel(total)
+    this.element.hidden = false
+  }
+
+  private select(from: number | null) {
+    const data = this.data
+    if (!data) return
+    this.selected = from
+    this.render()
+    this.onSelect(from === null ? null : { from, to: from + data.bucket })
+  }
+
+  private updateLabel(total: number) {
+    const data = this.data!
+    if (this.selected === null) {
+      this.label.textContent = `${total} photo${total === 1 ? '' : 's'} in the last 24 h`
+    } else {
+      this.label.textContent = `Showing ${hour(this.selected)}–${hour(this.selected + data.bucket)}`
+    }
+    this.clearButton.hidden = this.selected === null
+  }
+}
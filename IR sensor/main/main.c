@@ -47,6 +47,25 @@ static volatile bool g_wifi_connected = false;
 
 #define PIR_GPIO     GPIO_NUM_4 // GPIO pin connected to PIR sensor
 
+/* Task stacks. A CONFIG_PIR_STACK_PROFILE build logs their high-water marks;
+   ESP_EYE/tools/stack_profile.py turns that log into task_stacks.h, which
+   ordinary builds pick up here. */
+#if !CONFIG_PIR_STACK_PROFILE && __has_include("task_stacks.h")
+#include "task_stacks.h"
+#endif
+#ifndef PIR_STACK_GPIO_POLL_TASK
+#define PIR_STACK_GPIO_POLL_TASK 2048
+#endif
+#ifndef PIR_STACK_PUBLISHER_TASK
+#define PIR_STACK_PUBLISHER_TASK 8192
+#endif
+#ifndef PIR_STACK_TIME_SYNC
+#define PIR_STACK_TIME_SYNC 4096
+#endif
+#ifndef PIR_STACK_TIME_SYNC_LOOP
+#define PIR_STACK_TIME_SYNC_LOOP 4096
+#endif
+
 static QueueHandle_t gpio_evt_queue = NULL; // Queue for GPIO events
 static QueueHandle_t pub_queue = NULL; // Queue for publish events
 
@@ -167,6 +186,19 @@ static esp_err_t sync_time_with_server(void){
     return ESP_FAIL;
 }
 
+#if CONFIG_PIR_STACK_PROFILE
+/**
+ * @brief Log one stack in the format tools/stack_profile.py reads
+ *
+ * @param name Task name
+ * @param size Stack size in bytes, 0 for tasks not created here
+ * @param free_min High-water mark in bytes
+ */
+static void log_stack(const char *name, uint32_t size, uint32_t free_min){
+    ESP_LOGI(TAG, "stack %s size %u free_min %u", name, (unsigned)size, (unsigned)free_min);
+}
+#endif
+
 /**
  * @brief Time synchronization task.
  * 
@@ -175,6 +207,10 @@ static esp_err_t sync_time_with_server(void){
 static void time_sync_task(void *pv) {
     (void)pv;
     sync_time_with_server();
+#if CONFIG_PIR_STACK_PROFILE
+    // One-shot task: report before the stack is freed
+    log_stack("time_sync", PIR_STACK_TIME_SYNC, uxTaskGetStackHighWaterMark(NULL));
+#endif
     vTaskDelete(NULL);
 }
 
@@ -238,7 +274,7 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
             ESP_LOGI(TAG, "Got IP: %s", ip_str);
             g_wifi_connected = true;
             // Start time sync task
-            xTaskCreate(time_sync_task, "time_sync", 4096, NULL, 5, NULL);
+            xTaskCreate(time_sync_task, "time_sync", PIR_STACK_TIME_SYNC, NULL, 5, NULL);
         }
     }
 }
@@ -293,8 +329,21 @@ static void wifi_init_sta(void){
 static void gpio_poll_task(void* arg){
     int last_level = 0;
     const uint32_t picture_interval_ms = 10000; // 10s between pictures
+#if CONFIG_PIR_STACK_PROFILE
+    int64_t next_fake_us = 0;
+#endif
     for (;;) {
         int level = gpio_get_level(PIR_GPIO);
+#if CONFIG_PIR_STACK_PROFILE
+        // Profiling workload: a synthetic detection every few seconds drives
+        // the publisher, its retries and the time sync like a real one
+        int64_t now_us = esp_timer_get_time();
+        if (g_wifi_connected && now_us >= next_fake_us) {
+            next_fake_us = now_us + (int64_t)CONFIG_PIR_STACK_PROFILE_TRIGGER_S * 1000000;
+            uint64_t ts_ms = now_us / 1000ULL;
+            if (pub_queue) xQueueSend(pub_queue, &ts_ms, 0);
+        }
+#endif
 
         if (level == 1) {
             vTaskDelay(pdMS_TO_TICKS(100)); // Debounce delay
@@ -340,7 +389,7 @@ static void publisher_task(void* arg){
 
             // Prepare HTTP POST payload
             char payload[64];
-            int len = snprintf(payload, sizeof(payload), "capture:%llu", (unsigned long long)server_now);
+            int len = snprintf(payload, sizeof(payload), "capture:%llu source:pir", (unsigned long long)server_now);
 
             // Configure HTTP client for capture request
             char url[128];
@@ -394,7 +443,7 @@ static void publisher_task(void* arg){
                 if (attempt < MAX_CAPTURE_RETRIES && sync_time_with_server() == ESP_OK) {
                     uint64_t now_ms_rel2 = (uint64_t)(esp_timer_get_time() / 1000ULL);
                     uint64_t server_now2 = now_ms_rel2 + (uint64_t)g_time_offset_ms + 50;
-                    len = snprintf(payload, sizeof(payload), "capture:%llu", (unsigned long long)server_now2);
+                    len = snprintf(payload, sizeof(payload), "capture:%llu source:pir", (unsigned long long)server_now2);
                 } else {
                     break;
                 }
@@ -404,6 +453,37 @@ static void publisher_task(void* arg){
     }
 }
 
+#if CONFIG_PIR_STACK_PROFILE
+/**
+ * @brief Log the high-water mark of every task every 10 s
+ *
+ * @param arg Argument pointer
+ */
+static void stack_report_task(void *arg){
+    static const struct { const char *name; uint32_t size; } own[] = {
+        { "gpio_poll_task", PIR_STACK_GPIO_POLL_TASK },
+        { "publisher_task", PIR_STACK_PUBLISHER_TASK },
+        { "time_sync", PIR_STACK_TIME_SYNC },
+        { "time_sync_loop", PIR_STACK_TIME_SYNC_LOOP },
+    };
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(10000));
+        UBaseType_t count = uxTaskGetNumberOfTasks() + 4;
+        TaskStatus_t *tasks = malloc(count * sizeof(*tasks));
+        if (!tasks) continue;
+        count = uxTaskGetSystemState(tasks, count, NULL);
+        for (UBaseType_t i = 0; i < count; i++) {
+            uint32_t size = 0;
+            for (size_t k = 0; k < sizeof(own) / sizeof(own[0]); k++) {
+                if (strcmp(own[k].name, tasks[i].pcTaskName) == 0) size = own[k].size;
+            }
+            log_stack(tasks[i].pcTaskName, size, tasks[i].usStackHighWaterMark);
+        }
+        free(tasks);
+    }
+}
+#endif
+
 /**
  * @brief Main application entry point.
  * 
@@ -427,13 +507,18 @@ void app_main(void){
     pub_queue = xQueueCreate(10, sizeof(uint64_t));
 
     // Start polling gpio task
-    xTaskCreate(gpio_poll_task, "gpio_poll_task", 2048, NULL, 5, NULL);
+    xTaskCreate(gpio_poll_task, "gpio_poll_task", PIR_STACK_GPIO_POLL_TASK, NULL, 5, NULL);
 
     // Start publisher task with large stack for HTTP/TLS work
-    xTaskCreate(publisher_task, "publisher_task", 8192, NULL, 5, NULL);
+    xTaskCreate(publisher_task, "publisher_task", PIR_STACK_PUBLISHER_TASK, NULL, 5, NULL);
 
     // Start periodic time sync task to ensure re-syncs happen reliably
-    xTaskCreate(time_sync_periodic_task, "time_sync_loop", 4096, NULL, 5, NULL);
+    xTaskCreate(time_sync_periodic_task, "time_sync_loop", PIR_STACK_TIME_SYNC_LOOP, NULL, 5, NULL);
+
+#if CONFIG_PIR_STACK_PROFILE
+    // Stack profiling: high-water marks to the console for tools/stack_profile.py
+    xTaskCreate(stack_report_task, "stack_report", 4096, NULL, 1, NULL);
+#endif
 
     // Main loop does nothing, all work is done in tasks
     while (1) {